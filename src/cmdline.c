@@ -20,10 +20,10 @@ void usage(char *progname, int num_options, CLINEPARA *options)
      fprintf(stderr,"\t---------------------------------------------------------------\n");
      for (j=0;j<num_options;j++) {
          if (*options[j].parameter!=NULL) 
-             fprintf(stderr,"\t%-8s%-42s%-s\n",options[j].sname,&options[j].name[1],
+             fprintf(stderr,"\t%-7s %-42s%-s\n",options[j].sname,&options[j].name[1],
 	 	                                 *options[j].parameter);
          else
-             fprintf(stderr,"\t%-8s%-42s%-s\n",options[j].sname,&options[j].name[1],
+             fprintf(stderr,"\t%-7s %-42s%-s\n",options[j].sname,&options[j].name[1],
 	 	                                 "NULL");
      }
      fprintf(stderr,"\n");
@@ -84,3 +84,25 @@ float string_to_float(char *str, int pos)
 
       return((float)atof(buf));
 }
+
+/*
+    Input
+       str: time in seconds ("1800.5"), or in [hh:]mm:ss format ("30:00",
+            "1:05:30.5")
+    Ouput
+       return the time in seconds
+*/
+double string_to_time(char *str)
+{
+      double t = 0.0;
+      char *p = str;
+
+      /* Each ':' multiplies the fields before it by 60 */
+      for (;;) {
+	   t = 60.0*t + strtod(p,&p);
+	   if (*p!=':')
+	       break;
+	   p++;
+      }
+      return(t);
+}
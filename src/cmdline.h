@@ -20,5 +20,6 @@ typedef struct {
 void usage(char *progname, int num_options, CLINEPARA *options); 
 void get_cmdline(int argc, char *argv[],int num_options, CLINEPARA *option);
 float string_to_float(char *str, int pos);
+double string_to_time(char *str);
 
 #endif
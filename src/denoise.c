@@ -8,20 +8,28 @@
 //
 //  Notes       : The parameter 'alpha' is an overestimation factor and 'beta' is
 //                the noise floor controlling the musical noise. See labsheets for details 
+//  Modified    : (Oct 26) denoise_ex() takes the peak of the signal from its
+//                signal_summary() instead of scanning it again. Frames of
+//                zeros are output as zeros without FFT. estimate_snr() added
+//                for sph2phn -dn A. denoise_sel() denoises selected frames
+//                only, for sph2phn -dn S
 ////////////////////////////////////////////////////////////////////////
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
 #include "fft.h"
 #include "denoise.h"
 #include "veclib.h"
+#include "mmalloc.h"
 #include "window.h"
+#include "qsortfunc.h"
 
 #define FS 512
 #define PI 3.141592654
 
-short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
+short* denoise_sel(const short* noisySpeech,	// Input wave file, noisy.wav
 	       const unsigned long num_smps,	// Number of samples in the input wave file
 	       const unsigned long frameSize,	// No. of samples per frame
 	       const unsigned long frameAdv,	// No. of samples for frame shift
@@ -30,7 +38,9 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 	       const vec_t alphaMax,		// Parameters for spectral subtraction (see lab sheets for details)
 	       const vec_t alphaMin,		
 	       const vec_t betaMax, 
-	       const vec_t betaMin)
+	       const vec_t betaMin,
+	       const SIGNAL_SUMMARY *sum,	// signal_summary() of noisySpeech[], or NULL
+	       const unsigned char *sel)	// Frames to denoise [0..numFrames-1], or NULL for all
 {
         unsigned long t,k;			// Index variable
 	unsigned long frame;			// Index to the current frame
@@ -66,29 +76,29 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 	numFrames = num_smps/frameAdv-((frameSize/frameAdv)-1);
 
 	// Allocate array for storing the current frame of noisy speech, y[]
-	y = (vec_t *)calloc(frameSize,sizeof(vec_t));
-	s = (short *)calloc(frameSize,sizeof(short));
+	y = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
+	s = (short *)vector(0,frameSize-1,sizeof(short));
 
 	// Allocate array for storing the current reconstructed signal, xhat[]
-	xhat = (vec_t*)calloc(frameSize,sizeof(vec_t));
+	xhat = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
 
 	// Allocate array for storing the background spectrum of the current frame, Y[]
-	Y = (vec_t*)calloc(frameSize*2,sizeof(vec_t));
+	Y = (vec_t *)vector(0,frameSize*2-1,sizeof(vec_t));
 
 	// Allocate array for storing the reconstructed spectrum of the current frame, Xhat[] 
-	Xhat = (vec_t*)calloc(frameSize*2,sizeof(vec_t));
+	Xhat = (vec_t *)vector(0,frameSize*2-1,sizeof(vec_t));
 
 	// Allocate array for storing the magnitude of noise spectrum, magY[]
-	magY = (vec_t*)calloc(frameSize,sizeof(vec_t));
+	magY = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
 
 	// Allocate array for storing the phase angle of noise spectrum, phaseY[]
-	phaseY = (vec_t*)calloc(frameSize,sizeof(vec_t));
+	phaseY = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
 
 	offset = frameSize/2 - frameAdv/2;
 	*nOutSmps = numFrames*frameAdv+offset;
 
 	// Allocate temporary output signal, tempOut[]
-	tempOut = (vec_t*)calloc(*nOutSmps,sizeof(vec_t));
+	tempOut = (vec_t *)vector(0,*nOutSmps-1,sizeof(vec_t));
 
 	//******************************************************
 	/*
@@ -136,6 +146,24 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 	    frameStart = frame*frameAdv;
 	    frameEnd=frameStart+frameSize-1;
 
+#ifndef REFERENCE_IMPL
+	    /* Digital silence stays silent: a frame of zeros is neither sent through the
+	       FFT nor given the noise floor beta*noise[] */
+	    if (VECnzposs(frameSize, (short *)&noisySpeech[frameStart]) == frameSize) {
+		VECfillf(frameAdv, 0.0, &tempOut[frame*frameAdv+offset]);
+		*nOutSmps += frameAdv;
+		continue;
+	    }
+#endif
+
+	    /* Frames not selected are passed through, aligned with the denoised ones */
+	    if (sel != NULL && !sel[frame]) {
+		for (k=0; k<frameAdv; k++)
+		    tempOut[frame*frameAdv+k+offset] = noisySpeech[frameStart+k+offset];
+		*nOutSmps += frameAdv;
+		continue;
+	    }
+
 	    // Get one frame
 	    for (k=0; k<frameSize; k++)
 		s[k] = noisySpeech[frameStart+k];
@@ -145,7 +173,8 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 
 	    // Compute FFT-based spectrum
 	    if (!(FFT(y, Y, frameSize))) {
-		return NULL;
+		_16bitData = NULL;
+		goto cleanup;
 	    }
 
 	    // Compute magnitude and phase
@@ -251,7 +280,8 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 
 	    // carrying out IFFT
 	    if (!(IFFT(Xhat, xhat, frameSize))) {
-		return NULL;
+		_16bitData = NULL;
+		goto cleanup;
 	    }
 
 	    // Dehamming
@@ -281,7 +311,13 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 		- Use the function "free()" in "stdlib.h" or the operator "delete" 
 		  to deallocate the requested memory.
 	*/
-	/* Determine the peak value of noisy speech */
+	/* Determine the peak value of noisy speech. A sample of -32768 overflows the
+	   short sig_peak, so the loop is kept for it to give the same result */
+#ifndef REFERENCE_IMPL
+	if (sum != NULL && sum->num_samples == num_smps && sum->peak <= SHRT_MAX)
+	    sig_peak = sum->peak;
+	else
+#endif
 	for (sig_peak=0,t=0; t<num_smps; t++) {
 	    if (abs(noisySpeech[t])>sig_peak) {
 		sig_peak=abs(noisySpeech[t]);
@@ -291,19 +327,80 @@ short* denoise(const short* noisySpeech,	// Input wave file, noisy.wav
 	norm = sig_peak/VECamaxf((int)*nOutSmps,tempOut);
 
 	// allocating the array for 16-bit wave data
-	_16bitData = (short*)calloc(*nOutSmps, sizeof(short));
+	_16bitData = (short *)vector(0,*nOutSmps-1,sizeof(short));
 
 	// casting all vec_ts to short for writing 16-bit wave file
 	for (k=0; k<(*nOutSmps); k++)
 		_16bitData[k] = (short)(tempOut[k]*norm);
 
-	free(y);
-	free(s);
-	free(xhat);
-	free(Y);
-	free(Xhat);
-	free(magY);
-	free(phaseY);
-	free(tempOut);
+cleanup:				// Also reached when FFT() or IFFT() fails
+	free_vector((char *)y,0,sizeof(vec_t));
+	free_vector((char *)s,0,sizeof(short));
+	free_vector((char *)xhat,0,sizeof(vec_t));
+	free_vector((char *)Y,0,sizeof(vec_t));
+	free_vector((char *)Xhat,0,sizeof(vec_t));
+	free_vector((char *)magY,0,sizeof(vec_t));
+	free_vector((char *)phaseY,0,sizeof(vec_t));
+	free_vector((char *)tempOut,0,sizeof(vec_t));
 	return _16bitData;
 }
+
+
+short* denoise_ex(const short* noisySpeech, const unsigned long num_smps, const unsigned long frameSize,
+		  const unsigned long frameAdv, unsigned long* nOutSmps, const vec_t* noise,
+		  const vec_t alphaMax, const vec_t alphaMin, const vec_t betaMax, const vec_t betaMin,
+		  const SIGNAL_SUMMARY *sum)
+{
+	return denoise_sel(noisySpeech, num_smps, frameSize, frameAdv, nOutSmps, noise,
+			   alphaMax, alphaMin, betaMax, betaMin, sum, NULL);
+}
+
+
+short* denoise(const short* noisySpeech, const unsigned long num_smps, const unsigned long frameSize,
+	       const unsigned long frameAdv, unsigned long* nOutSmps, const vec_t* noise,
+	       const vec_t alphaMax, const vec_t alphaMin, const vec_t betaMax, const vec_t betaMin)
+{
+	return denoise_ex(noisySpeech, num_smps, frameSize, frameAdv, nOutSmps, noise,
+			  alphaMax, alphaMin, betaMax, betaMin, NULL);
+}
+
+
+static int cmp_energy(const void *a, const void *b)
+{
+	vec_t d = *(const vec_t *)a - *(const vec_t *)b;
+	return (d > 0) - (d < 0);
+}
+
+
+/* Quick SNR (in dB) of noisySpeech[] for deciding whether it needs denoise(): the ratio
+   of the SNR_LOUD_PCT and SNR_QUIET_PCT percentiles of the energy of at most
+   SNR_MAX_FRAMES frames spread evenly over the signal. Frames of zeros are left out.
+   Returns 0 if fewer than 2 frames are not zeros */
+vec_t estimate_snr(const short* noisySpeech, const unsigned long num_smps,
+		   const unsigned long frameSize)
+{
+	unsigned long i,n;
+	unsigned long numFrames = num_smps/frameSize;
+	unsigned long step;			// Take every step-th frame
+	vec_t *e;				// Energy of the frames taken [0..n-1]
+	vec_t loud, quiet;
+
+	if (numFrames < 2)
+	    return 0.0;
+	step = (numFrames+SNR_MAX_FRAMES-1)/SNR_MAX_FRAMES;
+	e = (vec_t *)vector(0,numFrames/step,sizeof(vec_t));
+	for (n=0,i=0; i<numFrames; i+=step) {
+	    e[n] = VECL2norms((int)frameSize, (short *)&noisySpeech[i*frameSize]);
+	    if (e[n] > 0.0)
+		n++;
+	}
+	if (n < 2) {
+	    free_vector((char *)e,0,sizeof(vec_t));
+	    return 0.0;
+	}
+	heap_sort(e, n, sizeof(vec_t), cmp_energy);	// qsort() would malloc a copy of e[]
+	loud = e[(n-1)*SNR_LOUD_PCT/100];
+	quiet = e[(n-1)*SNR_QUIET_PCT/100];
+	free_vector((char *)e,0,sizeof(vec_t));
+	return 10.0*log10(loud/quiet);
+}
@@ -13,6 +13,8 @@
 #ifndef __DENOISE_H__
 #define __DENOISE_H__
 
+#include "silence.h"			/* SIGNAL_SUMMARY */
+
 #ifndef  SQR
    #define SQR(a) ((a) * (a))
 #endif
@@ -24,5 +26,21 @@ short* denoise(const short* nspeech, const unsigned long num_smps, const unsigne
 			   const unsigned long frameAdv, unsigned long* nOutSmps, const double* noise,
 			   const double alphaMax, const double alphaMin,
 			   const double betaMax, const double betaMin);
+short* denoise_ex(const short* nspeech, const unsigned long num_smps, const unsigned long frameSize,
+		  const unsigned long frameAdv, unsigned long* nOutSmps, const double* noise,
+		  const double alphaMax, const double alphaMin,
+		  const double betaMax, const double betaMin, const SIGNAL_SUMMARY *sum);
+short* denoise_sel(const short* nspeech, const unsigned long num_smps, const unsigned long frameSize,
+		   const unsigned long frameAdv, unsigned long* nOutSmps, const double* noise,
+		   const double alphaMax, const double alphaMin,
+		   const double betaMax, const double betaMin, const SIGNAL_SUMMARY *sum,
+		   const unsigned char *sel);
+
+/* Quick SNR estimate of sph2phn -dn A, see denoise.c */
+#define SNR_MAX_FRAMES 256		/* Frames taken by estimate_snr() */
+#define SNR_QUIET_PCT 10		/* Percentile of the background energy */
+#define SNR_LOUD_PCT 90			/* Percentile of the speech energy */
+#define SNR_THRESHOLD 35.0		/* Default -snr (dB): no denoising above it */
+vec_t estimate_snr(const short* nspeech, const unsigned long num_smps, const unsigned long frameSize);
 
 #endif	//__DENOISE_H__
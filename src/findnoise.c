@@ -5,6 +5,7 @@
 //	Date: 21/09/2000
 //	Purpose:	Finding the average noise spectrum in frequency domain
 //				The program processes wave files of 16-bit mono window_PCM wave file format.
+//	Modified(Oct 26): findnoise_ex() can leave frames of zeros out of the background
 //
 ////////////////////////////////////////////////////////////////////////
 
@@ -16,6 +17,7 @@
 #include "findnoise.h"
 #include "fft.h"
 #include "veclib.h"
+#include "mmalloc.h"
 #include "window.h"
 
 
@@ -23,6 +25,16 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 		 unsigned long num_smps,	// Number of samples in the input wave file
 		 const unsigned long frameSize, // Size of speech frame
 		 const vec_t bkg_frac)          // Fraction of background frames w.r.t. the whole utt
+{
+	return findnoise_ex(inpwave, num_smps, frameSize, bkg_frac, 0);
+}
+
+
+vec_t* findnoise_ex(const short* inpwave,	// Input wave file, noise.wav
+		    unsigned long num_smps,	// Number of samples in the input wave file
+		    const unsigned long frameSize, // Size of speech frame
+		    const vec_t bkg_frac,	// Fraction of background frames w.r.t. the whole utt
+		    const int skip_zero_frms)	// 1 if frames of zeros are not background
 {
         unsigned long i,k,t,j;			// Index variable
 	unsigned long numFrames;		// Number of frames in the noisy speech file
@@ -36,6 +48,9 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 	vec_t *a;
 	vec_t minamp;
 	int minpos;
+#ifndef REFERENCE_IMPL
+	unsigned long nz;			// Number of frames that are not all zeros
+#endif
 
 	/* Find the background frames by looking for nonspeech frames (no frame overlapping).
 	   Making sure the no. of bkg frames will not be larger than half the no. of frames */
@@ -50,11 +65,30 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 	a = (vec_t *)vector(0,numFrames-1,sizeof(vec_t));
 	for (i=0; i<numFrames; i++) {
 	    j = i*frameSize;
+#ifdef REFERENCE_IMPL
 	    a[i] = 0.0;
 	    for (t=0; t<frameSize; t++)
 		a[i] += (vec_t)abs(inpwave[j+t]);
 	    a[i] = a[i]/frameSize;
+#else
+	    a[i] = VECasums(frameSize, (short *)&inpwave[j])/frameSize;
+#endif
+	}
+#ifndef REFERENCE_IMPL
+	/* Frames of digital silence (a[i] = 0) in a recording tell nothing about its
+	   background noise. Leave them out of the selection unless all frames are zeros.
+	   Not for denoised speech, whose quiet parts may be rounded to zeros */
+	for (nz=0,i=0; skip_zero_frms && i<numFrames; i++)
+	    nz += (a[i] != 0.0);
+	if (nz > 0) {
+	    for (i=0; i<numFrames; i++) {
+		if (a[i] == 0.0)
+		    a[i] = 1e38;
+	    }
+	    if (num_bkg_frms > nz)
+		num_bkg_frms = nz;
 	}
+#endif
 	for (i=0; i<num_bkg_frms; i++) {
 	    minamp = VECminposf(numFrames, a, &minpos);
 	    for (t=0; t<frameSize; t++) {
@@ -80,14 +114,14 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 		- Cast all the memory pointers to the correct types.
 	*/
 	// Allocate background noise array, y[]
-	y = (vec_t*)calloc(frameSize,sizeof(vec_t));
-	s = (short *)calloc(frameSize,sizeof(short));
+	y = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
+	s = (short *)vector(0,frameSize-1,sizeof(short));
 
 	// Allocate background spectrum array, Y[]
-	Y = (vec_t*)calloc(frameSize*2,sizeof(vec_t));
+	Y = (vec_t *)vector(0,frameSize*2-1,sizeof(vec_t));
 
 	// Allocate array for averaged magnitude of noise spectrum, aveMagY[]
-	aveMagY = (vec_t*)calloc(frameSize,sizeof(vec_t));
+	aveMagY = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
 
 	//**********************************************************
 	/*
@@ -132,6 +166,11 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 
 	    // Compute FFT-based spectrum
 	    if (!(FFT(y, Y, frameSize))) {
+		free_vector((char *)bkgwav,0,sizeof(short));
+		free_vector((char *)s,0,sizeof(short));
+		free_vector((char *)y,0,sizeof(vec_t));
+		free_vector((char *)Y,0,sizeof(vec_t));
+		free_vector((char *)aveMagY,0,sizeof(vec_t));
 		return 0;
 	    }
 
@@ -145,8 +184,10 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 	    //printf("%f\n",aveMagY[k]);
 	}
 
-	free(y);
-	free(Y);
+	free_vector((char *)bkgwav,0,sizeof(short));
+	free_vector((char *)s,0,sizeof(short));
+	free_vector((char *)y,0,sizeof(vec_t));
+	free_vector((char *)Y,0,sizeof(vec_t));
 	return aveMagY;
 
 }
@@ -164,14 +205,14 @@ vec_t* findnoise_from_file_start(const short* inpwave,		// Input wave file, nois
 	unsigned long num_bkg_frms = 25;
 
 	// Allocate background noise array, y[]
-	y = (vec_t*)calloc(frameSize,sizeof(vec_t));
-	s = (short *)calloc(frameSize,sizeof(short));
+	y = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
+	s = (short *)vector(0,frameSize-1,sizeof(short));
 
 	// Allocate background spectrum array, Y[]
-	Y = (vec_t*)calloc(frameSize*2,sizeof(vec_t));
+	Y = (vec_t *)vector(0,frameSize*2-1,sizeof(vec_t));
 
 	// Allocate array for averaged magnitude of noise spectrum, aveMagY[]
-	aveMagY = (vec_t*)calloc(frameSize,sizeof(vec_t));
+	aveMagY = (vec_t *)vector(0,frameSize-1,sizeof(vec_t));
 
 	for (i=0; i<num_bkg_frms; i++)
 	{
@@ -184,6 +225,10 @@ vec_t* findnoise_from_file_start(const short* inpwave,		// Input wave file, nois
 
 	    // Compute FFT-based spectrum
 	    if (!(FFT(y, Y, frameSize))) {
+		free_vector((char *)s,0,sizeof(short));
+		free_vector((char *)y,0,sizeof(vec_t));
+		free_vector((char *)Y,0,sizeof(vec_t));
+		free_vector((char *)aveMagY,0,sizeof(vec_t));
 		return 0;
 	    }
 
@@ -197,8 +242,9 @@ vec_t* findnoise_from_file_start(const short* inpwave,		// Input wave file, nois
 	    printf("%f\n",aveMagY[k]);
 	}
 
-	free(y);
-	free(Y);
+	free_vector((char *)s,0,sizeof(short));
+	free_vector((char *)y,0,sizeof(vec_t));
+	free_vector((char *)Y,0,sizeof(vec_t));
 	return aveMagY;
 
 }
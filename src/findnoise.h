@@ -26,6 +26,10 @@ vec_t* findnoise(const short* inpwave,		// Input wave file, noise.wav
 		 const unsigned long frameSize, // Size of speech frame
 		 const vec_t bkg_frac);         // Fraction of background frames w.r.t. the whole utt
 
+/* As findnoise(); if skip_zero_frms is 1, frames of zeros are not taken as background
+   unless all frames are zeros (the reference implementation ignores it) */
+vec_t* findnoise_ex(const short* inpwave, unsigned long num_smps, const unsigned long frameSize,
+		    const vec_t bkg_frac, const int skip_zero_frms);
 
 vec_t* findnoise_from_file_start(const short* inpwave,unsigned long num_smps,const unsigned long frameSize); 
 
@@ -0,0 +1,727 @@
+/*
+   Filename	:flac.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description  :Decoder for native FLAC (.flac) files, as distributed with the
+                 recent NIST SRE and VoxCeleb corpora. The files can be read
+		 directly instead of being transcoded to SPHERE first.
+
+		 The decoder reads the stream one frame at a time and writes the
+		 samples of every channel straight into the per-channel buffers
+		 used by the VAD pipeline, converted to 16-bit PCM in the same way
+		 as .wav files (winwav.c). All channels are decoded in a single
+		 pass, so sph2phn_2ch can use it as well.
+
+		 All subframe types (CONSTANT, VERBATIM, FIXED, LPC), both
+		 residual coding methods, wasted bits and the left/side,
+		 side/right and mid/side stereo modes are supported, for 4 to 32
+		 bits per sample and up to 8 channels. Frame header CRC-8 is
+		 checked; the frame CRC-16 is not. Ogg-encapsulated FLAC is not
+		 supported.
+
+		 The bitstream format follows the FLAC format specification
+		 (https://xiph.org/flac/format.html).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mmalloc.h"
+#include "flac.h"
+
+#define FLAC_MAGIC      "fLaC"
+#define FLAC_INIT_LEN   (1L << 20)     /* Initial buffer length if the number of samples is unknown */
+
+/* Metadata block types */
+#define META_STREAMINFO 0
+#define META_INVALID    127
+
+/* Channel assignments */
+#define CH_LEFT_SIDE    8
+#define CH_SIDE_RIGHT   9
+#define CH_MID_SIDE     10
+
+/* Subframe types */
+#define SUBFR_CONSTANT  0
+#define SUBFR_VERBATIM  1
+#define SUBFR_FIXED     8              /* 8..12, order = type-8 */
+#define SUBFR_LPC       32             /* 32..63, order = type-31 */
+#define MAX_FIXED_ORDER 4
+#define MAX_LPC_ORDER   32
+
+
+/***************************************************************************
+  Bit reader. Bits are consumed MSB first from a 64-bit reservoir that is
+  refilled a byte at a time from a large fread() buffer.
+*******************************************************************************/
+static void flac_refill(FLAC_DECODER *flac)
+{
+     while (flac->bitcnt <= 56) {
+	 if (flac->bytepos >= flac->nbytes) {
+	     flac->nbytes = fread(flac->bytes, 1, FLAC_BUFSIZE, flac->fp);
+	     flac->bytepos = 0;
+	     if (flac->nbytes <= 0) {
+		 flac->nbytes = 0;
+		 flac->eof = 1;
+		 return;
+	     }
+	 }
+	 flac->bitbuf |= (unsigned long long)flac->bytes[flac->bytepos++] << (56 - flac->bitcnt);
+	 flac->bitcnt += 8;
+     }
+}
+
+/* Read nbit (<= 56) bits */
+static unsigned long flac_getbits(FLAC_DECODER *flac, int nbit)
+{
+     unsigned long val;
+
+     if (nbit == 0)
+	 return 0;
+     if (flac->bitcnt < nbit)
+	 flac_refill(flac);
+     val = (unsigned long)(flac->bitbuf >> (64 - nbit));
+     flac->bitbuf <<= nbit;
+     flac->bitcnt -= nbit;
+     if (flac->bitcnt < 0)
+	 flac->bitcnt = 0;                 /* Reading past EOF, caller checks flac->eof */
+     return val;
+}
+
+/* Read a two's complement number of nbit bits */
+static long flac_getsigned(FLAC_DECODER *flac, int nbit)
+{
+     if (nbit == 0)
+	 return 0;
+     return (long)(flac_getbits(flac, nbit) << (64 - nbit)) >> (64 - nbit);
+}
+
+/* Unary code: number of zeros before the next one. The one is consumed. */
+static unsigned long flac_unary(FLAC_DECODER *flac)
+{
+     unsigned long result = 0;
+     int zeros;
+
+     for (;;) {
+	 if (flac->bitcnt == 0)
+	     flac_refill(flac);
+	 if (flac->bitbuf != 0)
+	     break;
+	 if (flac->eof && flac->bitcnt == 0)
+	     return 0;
+	 result += flac->bitcnt;           /* All valid bits are zero */
+	 flac->bitcnt = 0;
+     }
+     zeros = __builtin_clzll(flac->bitbuf);
+     result += zeros;
+     flac->bitbuf <<= zeros + 1;
+     flac->bitcnt -= zeros + 1;
+     return result;
+}
+
+/* Signed Rice code with parameter k, zigzag mapped */
+static long flac_rice(FLAC_DECODER *flac, int k)
+{
+     unsigned long u = (flac_unary(flac) << k) | flac_getbits(flac, k);
+     return (long)(u >> 1) ^ -(long)(u & 1);
+}
+
+/* Drop the bits up to the next byte boundary */
+static void flac_align(FLAC_DECODER *flac)
+{
+     flac_getbits(flac, flac->bitcnt & 7);
+}
+
+/* Skip nbyte bytes on a byte boundary, e.g. a large PICTURE block */
+static void flac_skip(FLAC_DECODER *flac, unsigned long nbyte)
+{
+     unsigned long avail;
+
+     while (nbyte > 0 && flac->bitcnt > 0) {
+	 flac_getbits(flac, 8);
+	 nbyte--;
+     }
+     avail = flac->nbytes - flac->bytepos;
+     if (nbyte <= avail) {
+	 flac->bytepos += nbyte;
+	 return;
+     }
+     nbyte -= avail;
+     flac->bytepos = flac->nbytes;
+     if (fseek(flac->fp, nbyte, SEEK_CUR) != 0) {
+	 while (nbyte > 0 && !flac->eof) {   /* Not seekable, e.g. a pipe */
+	     flac_getbits(flac, 8);
+	     nbyte--;
+	 }
+     }
+}
+
+static long flac_tell(FLAC_DECODER *flac);
+
+/* Read one byte and update the CRC-8 (polynomial x^8+x^2+x+1) of the frame header */
+static unsigned flac_getbyte_crc8(FLAC_DECODER *flac, unsigned *crc)
+{
+     unsigned b = (unsigned)flac_getbits(flac, 8);
+     int i;
+
+     *crc ^= b;
+     for (i=0; i<8; i++)
+	 *crc = (*crc & 0x80) ? ((*crc << 1) ^ 0x07) & 0xFF : (*crc << 1) & 0xFF;
+     return b;
+}
+
+
+/***************************************************************************
+  flac_open(): Read the FLAC signature and metadata blocks from fp
+  Input:
+        fp: stream positioned at the start of the file. A leading ID3v2
+	    tag is skipped.
+  Return:
+        A decoder positioned at the first frame on success; NULL if the
+	stream is not FLAC or STREAMINFO is missing or invalid
+*******************************************************************************/
+FLAC_DECODER *flac_open(FILE *fp)
+{
+     FLAC_DECODER *flac;
+     unsigned char magic[10];
+     unsigned long len, id3len;
+     int last, type, c, have_streaminfo = 0;
+
+     if (fread(magic, 1, 4, fp) != 4)
+	 return((FLAC_DECODER *)NULL);
+     if (memcmp(magic, "ID3", 3) == 0) {
+	 if (fread(magic+4, 1, 6, fp) != 6)
+	     return((FLAC_DECODER *)NULL);
+	 id3len = ((unsigned long)(magic[6] & 0x7F) << 21) | ((magic[7] & 0x7F) << 14) |
+	          ((magic[8] & 0x7F) << 7) | (magic[9] & 0x7F);
+	 if (magic[5] & 0x10)
+	     id3len += 10;                 /* Footer present */
+	 if (fseek(fp, id3len, SEEK_CUR) != 0 || fread(magic, 1, 4, fp) != 4)
+	     return((FLAC_DECODER *)NULL);
+     }
+     if (memcmp(magic, FLAC_MAGIC, 4) != 0)
+	 return((FLAC_DECODER *)NULL);
+
+     flac = (FLAC_DECODER *)calloc(1, sizeof(FLAC_DECODER));
+     flac->fp = fp;
+     flac->bytes = (unsigned char *)malloc(FLAC_BUFSIZE);
+
+     do {
+	 last = (int)flac_getbits(flac, 1);
+	 type = (int)flac_getbits(flac, 7);
+	 len = flac_getbits(flac, 24);
+	 if (flac->eof && flac->bitcnt == 0)
+	     break;
+	 if (type == META_STREAMINFO && len >= 34) {
+	     flac->min_blocksize = (int)flac_getbits(flac, 16);
+	     flac->max_blocksize = (int)flac_getbits(flac, 16);
+	     flac_getbits(flac, 24);        /* Minimum frame size */
+	     flac_getbits(flac, 24);        /* Maximum frame size */
+	     flac->sample_rate = flac_getbits(flac, 20);
+	     flac->nchan = (int)flac_getbits(flac, 3) + 1;
+	     flac->bps = (int)flac_getbits(flac, 5) + 1;
+	     flac->total_samples = (unsigned long long)flac_getbits(flac, 4) << 32;
+	     flac->total_samples |= flac_getbits(flac, 32);
+	     flac_skip(flac, len - 18);     /* MD5 signature and padding */
+	     have_streaminfo = 1;
+	 } else if (type == META_INVALID) {
+	     break;
+	 } else {
+	     flac_skip(flac, len);
+	 }
+     } while (!last);
+
+     if (!have_streaminfo || (flac->eof && flac->bitcnt == 0) || flac->sample_rate == 0 ||
+	 flac->bps < 4 || flac->nchan > FLAC_MAX_CHANNELS) {
+	 fprintf(stderr,"Error: Corrupted FLAC metadata\n");
+	 flac_close(flac);
+	 return((FLAC_DECODER *)NULL);
+     }
+     if (flac->max_blocksize < 16)
+	 flac->max_blocksize = FLAC_MAX_BLOCKSIZE;  /* Not given in the stream */
+
+     flac->first_frame = flac_tell(flac);
+     flac->buffer = (long **)calloc(flac->nchan, sizeof(long *));
+     for (c=0; c<flac->nchan; c++)
+	 flac->buffer[c] = (long *)calloc(flac->max_blocksize, sizeof(long));
+     return(flac);
+}
+
+
+/***************************************************************************
+  flac_decode_residual(): Decode the Rice-coded residual of a subframe into
+                          res[order..blocksize-1]. Return 0, or -1 on error.
+*******************************************************************************/
+static int flac_decode_residual(FLAC_DECODER *flac, long *res, int blocksize, int order)
+{
+     int method, parambits, escape, porder, psize, p, k, nbit, n, i = order;
+
+     method = (int)flac_getbits(flac, 2);
+     if (method > 1)
+	 return -1;
+     parambits = (method == 0) ? 4 : 5;
+     escape = (1 << parambits) - 1;
+     porder = (int)flac_getbits(flac, 4);
+     psize = blocksize >> porder;
+     if ((psize << porder) != blocksize || psize < order)
+	 return -1;
+
+     for (p=0; p<(1 << porder); p++) {
+	 n = (p == 0) ? psize - order : psize;
+	 k = (int)flac_getbits(flac, parambits);
+	 if (k == escape) {
+	     nbit = (int)flac_getbits(flac, 5);   /* Unencoded partition */
+	     for (; n>0; n--)
+		 res[i++] = flac_getsigned(flac, nbit);
+	 } else {
+	     for (; n>0; n--)
+		 res[i++] = flac_rice(flac, k);
+	 }
+     }
+     return 0;
+}
+
+
+/***************************************************************************
+  flac_decode_subframe(): Decode one channel of a frame
+  Input:
+        blocksize : number of samples in the frame
+	bps       : bits per sample of this channel (one more for a side channel)
+  Output:
+        out[0..blocksize-1]: decoded samples
+  Return:
+        0 on success, -1 if the subframe is corrupted
+*******************************************************************************/
+static int flac_decode_subframe(FLAC_DECODER *flac, long *out, int blocksize, int bps)
+{
+     int type, wasted = 0, order, precision, shift, i, j;
+     long coef[MAX_LPC_ORDER], v;
+     long long sum;
+
+     if (flac_getbits(flac, 1) != 0)
+	 return -1;                        /* Zero padding bit */
+     type = (int)flac_getbits(flac, 6);
+     if (flac_getbits(flac, 1)) {
+	 wasted = (int)flac_unary(flac) + 1;
+	 if (wasted >= bps)
+	     return -1;
+	 bps -= wasted;
+     }
+
+     if (type == SUBFR_CONSTANT) {
+	 v = flac_getsigned(flac, bps);
+	 for (i=0; i<blocksize; i++)
+	     out[i] = v;
+     } else if (type == SUBFR_VERBATIM) {
+	 for (i=0; i<blocksize; i++)
+	     out[i] = flac_getsigned(flac, bps);
+     } else if (type >= SUBFR_FIXED && type <= SUBFR_FIXED + MAX_FIXED_ORDER) {
+	 order = type - SUBFR_FIXED;
+	 if (order > blocksize)
+	     return -1;
+	 for (i=0; i<order; i++)
+	     out[i] = flac_getsigned(flac, bps);
+	 if (flac_decode_residual(flac, out, blocksize, order) != 0)
+	     return -1;
+	 switch (order) {
+	 case 1:
+	     for (i=1; i<blocksize; i++)
+		 out[i] += out[i-1];
+	     break;
+	 case 2:
+	     for (i=2; i<blocksize; i++)
+		 out[i] += 2*out[i-1] - out[i-2];
+	     break;
+	 case 3:
+	     for (i=3; i<blocksize; i++)
+		 out[i] += 3*(out[i-1] - out[i-2]) + out[i-3];
+	     break;
+	 case 4:
+	     for (i=4; i<blocksize; i++)
+		 out[i] += 4*(out[i-1] + out[i-3]) - 6*out[i-2] - out[i-4];
+	     break;
+	 }
+     } else if (type >= SUBFR_LPC) {
+	 order = type - SUBFR_LPC + 1;
+	 if (order > blocksize)
+	     return -1;
+	 for (i=0; i<order; i++)
+	     out[i] = flac_getsigned(flac, bps);
+	 precision = (int)flac_getbits(flac, 4) + 1;
+	 shift = (int)flac_getsigned(flac, 5);
+	 if (precision == 16 || shift < 0)
+	     return -1;
+	 for (j=0; j<order; j++)
+	     coef[j] = flac_getsigned(flac, precision);
+	 if (flac_decode_residual(flac, out, blocksize, order) != 0)
+	     return -1;
+	 for (i=order; i<blocksize; i++) {
+	     sum = 0;
+	     for (j=0; j<order; j++)
+		 sum += (long long)coef[j] * out[i-j-1];
+	     out[i] += (long)(sum >> shift);
+	 }
+     } else {
+	 return -1;                        /* Reserved subframe type */
+     }
+
+     if (wasted > 0)
+	 for (i=0; i<blocksize; i++)
+	     out[i] <<= wasted;
+     return (flac->eof && flac->bitcnt == 0) ? -1 : 0;
+}
+
+
+/* Convert a decoded sample to 16-bit linear PCM, keeping the 16 most significant bits */
+static short flac_to_pcm16(long v, int bps)
+{
+     if (bps > 16)
+	 v >>= bps - 16;
+     else if (bps < 16)
+	 v <<= 16 - bps;
+     if (v > 32767) v = 32767;
+     if (v < -32768) v = -32768;
+     return (short)v;
+}
+
+
+/* Frame header fields */
+typedef struct {
+     long	offset;			/* File offset of the frame, -1 if unknown */
+     unsigned long long sample;		/* Index of the first sample in the frame */
+     int	blocksize;		/* Number of samples per channel */
+     int	bps;			/* Bits per sample */
+     unsigned	ch_code;		/* Channel assignment */
+} FLAC_FRAME;
+
+
+/* File offset of the next unread byte; only valid on a byte boundary */
+static long flac_tell(FLAC_DECODER *flac)
+{
+     long pos = ftell(flac->fp);
+
+     if (pos < 0)
+	 return -1;
+     return pos - (flac->nbytes - flac->bytepos) - flac->bitcnt/8;
+}
+
+/* Move to file offset pos and empty the bit reservoir */
+static int flac_reset(FLAC_DECODER *flac, long pos)
+{
+     flac->nbytes = flac->bytepos = 0;
+     flac->bitbuf = 0;
+     flac->bitcnt = 0;
+     flac->eof = 0;
+     return fseek(flac->fp, pos, SEEK_SET);
+}
+
+
+/***************************************************************************
+  flac_next_header(): Find and read the next frame header. Candidates with
+                      a reserved field, a bad CRC-8 or a channel count that
+		      differs from STREAMINFO are skipped.
+  Return:
+        1 if a header is found, 0 at the end of the stream
+*******************************************************************************/
+static int flac_next_header(FLAC_DECODER *flac, FLAC_FRAME *fr)
+{
+     static const int bps_code[8] = { 0, 8, 12, -1, 16, 20, 24, 32 };
+     unsigned crc, b, bs_code, sr_code, ss_code, variable;
+     unsigned long long num;
+     int n, i;
+
+     for (;;) {
+	 /* Find the frame sync code, 14 ones and a reserved zero bit */
+	 flac_align(flac);
+	 for (;;) {
+	     if (flac->bitcnt < 16)
+		 flac_refill(flac);
+	     if (flac->bitcnt < 16)
+		 return 0;                 /* End of stream, possibly after a trailing tag */
+	     if ((flac->bitbuf >> 49) == 0x7FFC)
+		 break;
+	     flac_getbits(flac, 8);
+	 }
+	 fr->offset = flac_tell(flac);
+
+	 crc = 0;
+	 flac_getbyte_crc8(flac, &crc);
+	 variable = flac_getbyte_crc8(flac, &crc) & 1;
+	 b = flac_getbyte_crc8(flac, &crc);
+	 bs_code = b >> 4;
+	 sr_code = b & 0x0F;
+	 b = flac_getbyte_crc8(flac, &crc);
+	 fr->ch_code = b >> 4;
+	 ss_code = (b >> 1) & 0x07;
+	 if (bs_code == 0 || sr_code == 15 || fr->ch_code > CH_MID_SIDE || bps_code[ss_code] < 0 || (b & 1))
+	     continue;                     /* Not a frame header, keep searching */
+
+	 /* UTF-8 coded frame number (fixed block size) or sample number */
+	 b = flac_getbyte_crc8(flac, &crc);
+	 for (n=0; n<7 && (b & (0x80 >> n)); n++)
+	     ;
+	 if (n == 1 || n == 7)
+	     continue;
+	 num = b & (0x7F >> n);
+	 for (i=1; i<n; i++) {
+	     b = flac_getbyte_crc8(flac, &crc);
+	     num = (num << 6) | (b & 0x3F);
+	 }
+
+	 if (bs_code == 1)
+	     fr->blocksize = 192;
+	 else if (bs_code <= 5)
+	     fr->blocksize = 576 << (bs_code - 2);
+	 else if (bs_code == 6)
+	     fr->blocksize = (int)flac_getbyte_crc8(flac, &crc) + 1;
+	 else if (bs_code == 7) {
+	     fr->blocksize = (int)flac_getbyte_crc8(flac, &crc) << 8;
+	     fr->blocksize = (fr->blocksize | (int)flac_getbyte_crc8(flac, &crc)) + 1;
+	 } else
+	     fr->blocksize = 256 << (bs_code - 8);
+
+	 if (sr_code == 12)
+	     flac_getbyte_crc8(flac, &crc);
+	 else if (sr_code == 13 || sr_code == 14) {
+	     flac_getbyte_crc8(flac, &crc);
+	     flac_getbyte_crc8(flac, &crc);
+	 }
+
+	 if (flac_getbits(flac, 8) != crc)
+	     continue;                     /* Header CRC mismatch */
+	 if (((fr->ch_code < CH_LEFT_SIDE) ? (int)fr->ch_code + 1 : 2) != flac->nchan)
+	     continue;
+
+	 fr->bps = (ss_code == 0) ? flac->bps : bps_code[ss_code];
+	 fr->sample = variable ? num : num * flac->min_blocksize;
+	 return 1;
+     }
+}
+
+
+/***************************************************************************
+  flac_decode_frame(): Decode the next frame of all channels
+  Input:
+        flac        : decoder returned by flac_open()
+	pos         : index in chan_buf[c][] at which the frame is written. It
+	              may be negative; samples before index 0 are dropped.
+	max_samples : length of chan_buf[c][]; samples beyond it are dropped
+  Output:
+        chan_buf[c] : decoded samples of channel c. Channels whose buffer is
+	              NULL are decoded (they may be needed for stereo
+		      decorrelation) but not stored.
+  Return:
+        Number of samples per channel in the frame, 0 at the end of stream
+	and -1 if the stream is corrupted
+*******************************************************************************/
+int flac_decode_frame(FLAC_DECODER *flac, short **chan_buf, long pos, unsigned long max_samples)
+{
+     FLAC_FRAME fr;
+     int blocksize, sbps, c, i;
+     long *b0, *b1, mid, side;
+
+     if (!flac_next_header(flac, &fr))
+	 return 0;
+     blocksize = fr.blocksize;
+     if (blocksize > flac->max_blocksize) {
+	 for (c=0; c<flac->nchan; c++) {
+	     free(flac->buffer[c]);
+	     flac->buffer[c] = (long *)calloc(blocksize, sizeof(long));
+	 }
+	 flac->max_blocksize = blocksize;
+     }
+
+     for (c=0; c<flac->nchan; c++) {
+	 sbps = fr.bps;
+	 if ((fr.ch_code == CH_LEFT_SIDE && c == 1) || (fr.ch_code == CH_SIDE_RIGHT && c == 0) ||
+	     (fr.ch_code == CH_MID_SIDE && c == 1))
+	     sbps++;                       /* Side channel */
+	 if (flac_decode_subframe(flac, flac->buffer[c], blocksize, sbps) != 0)
+	     return -1;
+     }
+
+     /* Stereo decorrelation */
+     b0 = flac->buffer[0];
+     b1 = (flac->nchan > 1) ? flac->buffer[1] : NULL;
+     switch (fr.ch_code) {
+     case CH_LEFT_SIDE:
+	 for (i=0; i<blocksize; i++)
+	     b1[i] = b0[i] - b1[i];
+	 break;
+     case CH_SIDE_RIGHT:
+	 for (i=0; i<blocksize; i++)
+	     b0[i] += b1[i];
+	 break;
+     case CH_MID_SIDE:
+	 for (i=0; i<blocksize; i++) {
+	     side = b1[i];
+	     mid = (b0[i] << 1) | (side & 1);
+	     b0[i] = (mid + side) >> 1;
+	     b1[i] = (mid - side) >> 1;
+	 }
+	 break;
+     }
+
+     flac_align(flac);
+     flac_getbits(flac, 16);                /* Frame CRC-16 */
+
+     if (pos + blocksize <= 0)
+	 return blocksize;
+     for (c=0; c<flac->nchan; c++) {
+	 if (chan_buf[c] == NULL)
+	     continue;
+	 for (i=(pos<0) ? -pos : 0; i<blocksize && pos+i<(long)max_samples; i++)
+	     chan_buf[c][pos+i] = flac_to_pcm16(flac->buffer[c][i], fr.bps);
+     }
+     return blocksize;
+}
+
+
+/***************************************************************************
+  flac_seek(): Move to a frame at or before sample target, so that target
+               is reached after decoding a few frames. The frame is found by
+	       bisection on the file offset, using the sample numbers in the
+	       frame headers; no SEEKTABLE is needed.
+  Return:
+        Index of the first sample of the next frame to be decoded, or -1
+	(without moving) if the stream is not seekable, e.g. a pipe
+*******************************************************************************/
+long long flac_seek(FLAC_DECODER *flac, unsigned long long target)
+{
+     FLAC_FRAME fr;
+     long lo, hi, mid, best_pos;
+     unsigned long long best = 0;
+
+     if (flac->first_frame < 0 || fseek(flac->fp, 0, SEEK_END) != 0 || (hi = ftell(flac->fp)) < 0)
+	 return -1;
+     lo = best_pos = flac->first_frame;
+     while (hi - lo > FLAC_SEEK_SPAN) {
+	 mid = lo + (hi - lo)/2;
+	 flac_reset(flac, mid);
+	 if (flac_next_header(flac, &fr) && fr.offset >= 0 && fr.sample <= target) {
+	     best = fr.sample;
+	     best_pos = fr.offset;
+	     lo = mid;
+	 } else {
+	     hi = mid;
+	 }
+     }
+     flac_reset(flac, best_pos);
+     return (long long)best;
+}
+
+
+void flac_close(FLAC_DECODER *flac)
+{
+     int c;
+
+     if (flac == NULL)
+	 return;
+     if (flac->buffer != NULL) {
+	 for (c=0; c<flac->nchan; c++)
+	     free(flac->buffer[c]);
+	 free(flac->buffer);
+     }
+     free(flac->bytes);
+     free(flac);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* FlacReadChannels(): Read a FLAC file and convert the channel chan (or   */
+/*     all channels if chan<0) to 16-bit PCM in one pass. Only the samples */
+/*     in [start,end) sec are returned; end<=0 means the end of the file.  */
+/*     The decoder seeks to a frame close to start. info is filled in as   */
+/*     by WavReadChannels(), with data_offset set to 0.                    */
+/*     Return an array of info->channel sample arrays, NULL for channels   */
+/*     that are not kept, or NULL on error.                                */
+/* ------------------------------------------------------------------------ */
+INT16 **FlacReadChannels(char *FlacFileName, WAV_INFO *info, int chan, double start, double end,
+			 unsigned long *num_smps)
+{
+     FILE *fp;
+     FLAC_DECODER *flac;
+     INT16 **sample;
+     unsigned long first, len;
+     long long at = 0;
+     long pos;
+     int c, n = 0, known, bounded;
+
+     memset(info,0,sizeof(WAV_INFO));
+     if ((fp=fopen(FlacFileName,"rb"))==NULL) {
+	 fprintf(stderr,"%s not found\n",FlacFileName);
+	 return((INT16 **)NULL);
+     }
+     if ((flac=flac_open(fp))==NULL) {
+	 fprintf(stderr,"%s is not a FLAC file\n",FlacFileName);
+	 fclose(fp);
+	 return((INT16 **)NULL);
+     }
+     if (chan>=flac->nchan) {
+	 fprintf(stderr,"%s has only %d channel(s)\n",FlacFileName,flac->nchan);
+	 flac_close(flac);
+	 fclose(fp);
+	 return((INT16 **)NULL);
+     }
+     info->fmtag = WAVE_FORMAT_PCM;
+     info->channel = flac->nchan;
+     info->srate = (INT32)flac->sample_rate;
+     info->bps = flac->bps;
+     info->align = flac->nchan*((flac->bps+7)/8);
+     info->num_frames = (unsigned long)flac->total_samples;
+
+     /* Number of samples to be returned; unknown if neither STREAMINFO nor end gives it */
+     known = (flac->total_samples>0);
+     first = SEC2SMP(start,flac->sample_rate);
+     len = known ? (unsigned long)flac->total_samples : 0;
+     if (end>0.0 && (!known || SEC2SMP(end,flac->sample_rate)<len))
+	 len = SEC2SMP(end,flac->sample_rate);
+     bounded = (len>0);
+     if (bounded && first>=len) {
+	 fprintf(stderr,"%s: no samples between %.2f and %.2f sec\n",FlacFileName,start,end);
+	 flac_close(flac);
+	 fclose(fp);
+	 return((INT16 **)NULL);
+     }
+     len = bounded ? len-first : FLAC_INIT_LEN;
+
+     if (first>0 && (at=flac_seek(flac,first))<0)
+	 at = 0;                           /* Not seekable, decode from the start */
+     pos = (long)at-(long)first;
+
+     sample = (INT16 **)calloc(flac->nchan,sizeof(INT16 *));
+     for (c=0; c<flac->nchan; c++) {
+	 if (chan<0 || c==chan)
+	     sample[c] = (INT16 *)vector(0,len,sizeof(INT16));
+     }
+
+     while (!bounded || pos<(long)len) {
+	 /* The number of samples is optional in STREAMINFO; grow the buffers if needed.
+	    A frame may be larger than the STREAMINFO maximum (flac_decode_frame()
+	    only learns its size from the frame header), so keep room for the
+	    largest block a frame header can code. */
+	 if (!bounded && pos+FLAC_MAX_BLOCKSIZE+1>(long)len) {
+	     len *= 2;
+	     for (c=0; c<flac->nchan; c++)
+		 if (sample[c]!=NULL)
+		     sample[c] = (INT16 *)resize_vector((char *)sample[c],0,len,sizeof(INT16));
+	 }
+	 if ((n=flac_decode_frame(flac,sample,pos,len))<=0)
+	     break;
+	 pos += n;
+     }
+     flac_close(flac);
+     fclose(fp);
+
+     if (n<0 || pos<=0 || (known && pos<(long)len)) {
+	 fprintf(stderr,"Error: Corrupted or truncated FLAC data in %s\n",FlacFileName);
+	 for (c=0; c<info->channel; c++)
+	     if (sample[c]!=NULL)
+		 free_vector((char *)sample[c],0,sizeof(INT16));
+	 free(sample);
+	 return((INT16 **)NULL);
+     }
+     *num_smps = (pos<(long)len) ? (unsigned long)pos : len;
+     return(sample);
+}
@@ -0,0 +1,45 @@
+/*
+   Filename	:flac.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Function prototypes for flac.c, an in-tree decoder for native
+                 FLAC (.flac) files
+*/
+
+#ifndef __FLAC_INCLUDE__
+#define __FLAC_INCLUDE__
+
+#include <stdio.h>
+#include "winwav.h"
+
+#define FLAC_BUFSIZE 65536             /* Size of the byte buffer for fread() */
+#define FLAC_MAX_CHANNELS 8
+#define FLAC_MAX_BLOCKSIZE 65535
+#define FLAC_SEEK_SPAN 65536           /* Bisection in flac_seek() stops within this many bytes */
+
+typedef struct {
+	FILE	*fp;			/* Stream positioned at the first frame */
+	unsigned long sample_rate;	/* Sampling rate in Hz (STREAMINFO) */
+	int	nchan;			/* Number of channels (STREAMINFO) */
+	int	bps;			/* Bits per sample (STREAMINFO) */
+	int	min_blocksize;		/* Block size of fixed-blocksize streams */
+	int	max_blocksize;		/* Largest block size in the stream */
+	unsigned long long total_samples; /* Samples per channel, 0 if unknown */
+	long	first_frame;		/* File offset of the first frame, -1 if unknown */
+	long	**buffer;		/* Decoded samples of the current frame, buffer[c][0..max_blocksize-1] */
+	unsigned long long bitbuf;	/* Left-aligned bit reservoir */
+	int	bitcnt;			/* Number of valid bits in bitbuf */
+	unsigned char *bytes;		/* Byte buffer filled by fread() */
+	int	nbytes, bytepos;	/* Number of bytes in bytes[] and read position */
+	int	eof;			/* Set when fread() returns no more data */
+} FLAC_DECODER;
+
+FLAC_DECODER *flac_open(FILE *fp);
+int flac_decode_frame(FLAC_DECODER *flac, short **chan_buf, long pos, unsigned long max_samples);
+long long flac_seek(FLAC_DECODER *flac, unsigned long long target);
+void flac_close(FLAC_DECODER *flac);
+INT16 **FlacReadChannels(char *FlacFileName, WAV_INFO *info, int chan, double start, double end,
+			 unsigned long *num_smps);
+
+#endif
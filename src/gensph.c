@@ -0,0 +1,365 @@
+/* Filename	:gensph.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :Generate synthetic test audio of any length and number of
+                 channels, together with the ground-truth .phn file of each
+		 channel. Each channel alternates between pauses and speech-like
+		 bursts (a glottal pulse train through two formant resonators,
+		 with syllable envelopes and some unvoiced syllables) over white
+		 or pink noise. The bursts are scaled to -snr dB above the noise,
+		 and leak into the other channels at -xt dB (crosstalk, which is
+		 not speech in the .phn files). Channels in -zero are all zero,
+		 as channel B of some SRE08 files, and -pulse adds impulsive
+		 clicks. The output is a NIST SPHERE file (16-bit PCM) or, if
+		 its name ends with .wav, a MS .wav file. It is written block by
+		 block, so hours of audio need little memory.
+
+		 The .phn files are <base>_A.phn, <base>_B.phn, ... where <base>
+		 is -phn or the output file without its extension.
+
+   Example      :gensph -out synth.sph -dur 3:00:00 -nch 2 -snr 10 -xt -25 -pulse 2
+                 sph2phn_2ch -sph synth.sph -phn out_A.phn -ch A
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mmalloc.h"
+#include "veclib.h"
+#include "cmdline.h"
+#include "winwav.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_OutFile="synth.sph",		/* .sph, or .wav if the name ends with .wav */
+     *CL_PhnBase=(char *)NULL,		/* Base name of the .phn files, default from -out */
+     *CL_Duration="60",			/* Length in sec or [hh:]mm:ss */
+     *CL_SampleRate="8000",
+     *CL_NumChannels="2",
+     *CL_NoiseLevel="100",		/* RMS of the noise in sample units */
+     *CL_NoiseType="white",		/* white or pink */
+     *CL_SNR="15",			/* Speech to noise ratio of the bursts in dB */
+     *CL_Crosstalk="-20",		/* Leakage of each channel into the others in dB, -100 for none */
+     *CL_ZeroChannels="",		/* Channels that are all zero, e.g. "B" */
+     *CL_PulseRate="0",			/* Impulsive clicks per minute in each channel */
+     *CL_TalkTime="1.5",		/* Mean length of the bursts in sec */
+     *CL_PauseTime="1.0",		/* Mean length of the pauses in sec */
+     *CL_Seed="1";
+
+CLINEPARA options[]=
+{
+    {"-OutFile", "-out", &CL_OutFile},
+    {"-PhnBase", "-phn", &CL_PhnBase},
+    {"-Duration", "-dur", &CL_Duration},
+    {"-SampleRate", "-sr", &CL_SampleRate},
+    {"-NumChannels", "-nch", &CL_NumChannels},
+    {"-NoiseLevel", "-nl", &CL_NoiseLevel},
+    {"-NoiseType", "-nt", &CL_NoiseType},
+    {"-SNR", "-snr", &CL_SNR},
+    {"-Crosstalk", "-xt", &CL_Crosstalk},
+    {"-ZeroChannels", "-zero", &CL_ZeroChannels},
+    {"-PulseRate", "-pulse", &CL_PulseRate},
+    {"-TalkTime", "-talk", &CL_TalkTime},
+    {"-PauseTime", "-pause", &CL_PauseTime},
+    {"-Seed", "-seed", &CL_Seed}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define MAX_CHANNELS 26
+#define MIN_TALK     0.3		/* Shortest burst in sec */
+#define MAX_TALK     10.0		/* Longest burst in sec */
+#define MIN_PAUSE    0.2		/* Shortest pause in sec */
+#define SYLLABLE     0.2		/* Mean length of a syllable in sec */
+#define PULSE_AMP    12000.0		/* Peak of the clicks */
+#define PULSE_LEN    0.002		/* Decay time of the clicks in sec */
+#define SPH_HDR_SIZE 1024
+
+/* State of one channel */
+typedef struct {
+	int	zero;			/* All-zero channel */
+	FILE	*phn;			/* Ground truth */
+	unsigned long seg_begin;	/* First sample of the current segment */
+	unsigned long seg_end;		/* One past its last sample */
+	int	speech;			/* Current segment is a burst */
+	vec_t	*burst;			/* Samples of the current burst */
+	vec_t	pink[3];		/* Filter state of the pink noise */
+	double	pulse;			/* Current click amplitude */
+	unsigned long num_bursts;
+	double	speech_time;
+} CHANNEL;
+
+static unsigned long long rng_state;
+static long srate;
+static double noise_rms, speech_rms;
+
+
+/* xorshift64*, so that a seed gives the same files on every platform */
+static double uniform(void)
+{
+     rng_state ^= rng_state >> 12;
+     rng_state ^= rng_state << 25;
+     rng_state ^= rng_state >> 27;
+     return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0/9007199254740992.0);
+}
+
+static double gaussian(void)
+{
+     double u = uniform();
+
+     if (u < 1e-300) u = 1e-300;
+     return sqrt(-2.0*log(u)) * cos(2.0*M_PI*uniform());
+}
+
+static double exponential(double mean, double min, double max)
+{
+     double x = min - mean*log(1.0-uniform());
+
+     return (x > max) ? max : x;
+}
+
+
+/* Two-pole resonator at freq Hz with bandwidth bw Hz; y[0..1] is its state */
+static double resonate(double x, double freq, double bw, double *y)
+{
+     double r = exp(-M_PI*bw/srate);
+     double out = (1.0-r)*x + 2.0*r*cos(2.0*M_PI*freq/srate)*y[0] - r*r*y[1];
+
+     y[1] = y[0];
+     y[0] = out;
+     return out;
+}
+
+/* Fill burst[0..n-1] with a speech-like signal of RMS speech_rms */
+static void make_burst(vec_t *burst, unsigned long n)
+{
+     unsigned long i, syl_begin = 0, syl_len = 1;
+     double f0, phase = 0.0, f1 = 500, f2 = 1500, y1[2] = {0,0}, y2[2] = {0,0};
+     double env, x, energy = 0.0, gain, fmax = 0.45*srate;
+     int voiced = 1;
+
+     f0 = 90.0 + 130.0*uniform();
+     for (i=0; i<n; i++) {
+	 if (i == syl_begin + syl_len) {	/* Next syllable */
+	     syl_begin = i;
+	     syl_len = (unsigned long)(exponential(SYLLABLE, 0.08, 0.5)*srate);
+	     voiced = (uniform() > 0.15);
+	     f1 = voiced ? 300.0 + 500.0*uniform() : 2500.0 + 1500.0*uniform();
+	     f2 = voiced ? 900.0 + 1300.0*uniform() : f1 + 800.0;
+	     f0 *= 0.9 + 0.2*uniform();
+	     if (f0 < 80.0 || f0 > 250.0) f0 = 90.0 + 130.0*uniform();
+	 }
+	 if (i == 0)
+	     syl_len = (unsigned long)(exponential(SYLLABLE, 0.08, 0.5)*srate);
+	 env = sin(M_PI*(i-syl_begin)/syl_len);
+	 if (voiced) {
+	     phase += f0/srate;
+	     x = (phase >= 1.0) ? 1.0 : 0.0;
+	     if (phase >= 1.0) phase -= 1.0;
+	     x += 0.02*gaussian();
+	 }
+	 else
+	     x = 0.3*gaussian();
+	 x = resonate(x, (f1 < fmax) ? f1 : fmax, 80.0, y1);
+	 x = resonate(x, (f2 < fmax) ? f2 : fmax, 120.0, y2);
+	 burst[i] = (vec_t)(env*x);
+	 energy += burst[i]*burst[i];
+     }
+     gain = (energy > 0.0) ? speech_rms/sqrt(energy/n) : 0.0;
+     for (i=0; i<n; i++)
+	 burst[i] *= gain;
+}
+
+/* Start the next segment of channel ch at sample pos, and write the previous one */
+static void next_segment(CHANNEL *ch, unsigned long pos, unsigned long num_samples, double talk, double pause)
+{
+     unsigned long len;
+
+     if (pos > 0)
+	 fprintf(ch->phn, "%lu %lu %s\n", ch->seg_begin, ch->seg_end, ch->speech ? "S" : "h#");
+     ch->speech = (pos == 0) ? 0 : !ch->speech;
+     if (ch->speech) {
+	 len = (unsigned long)(exponential(talk, MIN_TALK, MAX_TALK)*srate);
+	 ch->num_bursts++;
+     }
+     else
+	 len = (unsigned long)(exponential(pause, MIN_PAUSE, 10.0*pause+MIN_PAUSE)*srate);
+     if (pos+len > num_samples)
+	 len = num_samples-pos;
+     ch->seg_begin = pos;
+     ch->seg_end = pos+len;
+     if (ch->speech) {
+	 make_burst(ch->burst, len);
+	 ch->speech_time += (double)len/srate;
+     }
+}
+
+static double noise_sample(CHANNEL *ch, int pink)
+{
+     double w = gaussian();
+
+     if (!pink)
+	 return noise_rms*w;
+     /* Paul Kellet's economy filter, about -3 dB/octave */
+     ch->pink[0] = 0.99765*ch->pink[0] + w*0.0990460;
+     ch->pink[1] = 0.96300*ch->pink[1] + w*0.2965164;
+     ch->pink[2] = 0.57000*ch->pink[2] + w*1.0526913;
+     return noise_rms*(ch->pink[0] + ch->pink[1] + ch->pink[2] + w*0.1848)/3.2;
+}
+
+static void write_sph_header(FILE *fp, unsigned long num_samples, int num_channels)
+{
+     char hdr[SPH_HDR_SIZE];
+     int len;
+
+     len = sprintf(hdr, "NIST_1A\n   %d\nsample_count -i %lu\nsample_n_bytes -i 2\n"
+		   "channel_count -i %d\nsample_byte_format -s2 01\nsample_rate -i %ld\n"
+		   "sample_coding -s3 pcm\nend_head\n", SPH_HDR_SIZE, num_samples, num_channels, srate);
+     memset(hdr+len, ' ', SPH_HDR_SIZE-len);
+     fwrite(hdr, 1, SPH_HDR_SIZE, fp);
+}
+
+static void write_wav_header(FILE *fp, unsigned long num_samples, int num_channels)
+{
+     WAV_HDR wh;
+
+     memcpy(wh.riff,"RIFF",4);
+     memcpy(wh.type,"WAVE",4);
+     memcpy(wh.fmt,"fmt ",4);
+     wh.format = 16;
+     wh.fmtag = WAVE_FORMAT_PCM;
+     wh.channel = num_channels;
+     wh.srate = srate;
+     wh.drate = srate*num_channels*2;
+     wh.align = num_channels*2;
+     wh.bps = 16;
+     memcpy(wh.data,"data",4);
+     wh.dsize = num_samples*num_channels*2;
+     wh.filesize = wh.dsize + sizeof(WAV_HDR) - 8;
+     fwrite(&wh, sizeof(WAV_HDR), 1, fp);
+}
+
+
+int main(int argc, char *argv[])
+{
+     FILE *fp;
+     CHANNEL ch[MAX_CHANNELS];
+     char base[1024], phnfile[1100], *p;
+     unsigned long num_samples, pos, i, block, block_len;
+     int num_channels, c, d, pink, wav;
+     double talk, pause, leak, pulse_prob, x, **clean;
+     short *out;
+
+     if (argc==1)
+	 usage(argv[0],num_options,options);
+     get_cmdline(argc, argv, num_options, options);
+     srate = (long)atof(CL_SampleRate);
+     num_channels = atoi(CL_NumChannels);
+     num_samples = (unsigned long)(string_to_time(CL_Duration)*srate);
+     noise_rms = atof(CL_NoiseLevel);
+     speech_rms = noise_rms*pow(10.0, atof(CL_SNR)/20.0);
+     leak = pow(10.0, atof(CL_Crosstalk)/20.0);
+     pulse_prob = atof(CL_PulseRate)/60.0/srate;
+     talk = atof(CL_TalkTime);
+     pause = atof(CL_PauseTime);
+     pink = (strcmp(CL_NoiseType, "pink") == 0);
+     rng_state = 0x9E3779B97F4A7C15ULL ^ (unsigned long long)atol(CL_Seed);
+     if (num_channels < 1 || num_channels > MAX_CHANNELS || srate <= 0 || num_samples == 0) {
+	 fprintf(stderr,"Need 1 to %d channels, a positive sampling rate and duration\n",MAX_CHANNELS);
+	 exit(EXIT_FAILURE);
+     }
+     p = strrchr(CL_OutFile, '.');
+     wav = (p != NULL && strcmp(p, ".wav") == 0);
+     if (wav && num_samples*num_channels*2 > 0x7fffffffUL - sizeof(WAV_HDR)) {
+	 fprintf(stderr,"%s would exceed the 2 GB limit of .wav files, use .sph\n",CL_OutFile);
+	 exit(EXIT_FAILURE);
+     }
+     if (CL_PhnBase != NULL)
+	 strncpy(base, CL_PhnBase, sizeof(base)-1);
+     else {
+	 strncpy(base, CL_OutFile, sizeof(base)-1);
+	 if ((p=strrchr(base, '.')) != NULL && strchr(p, '/') == NULL)
+	     *p = '\0';
+     }
+     base[sizeof(base)-1] = '\0';
+
+     if ((fp=fopen(CL_OutFile, "wb")) == NULL) {
+	 fprintf(stderr,"Unable to open %s for write\n",CL_OutFile);
+	 exit(EXIT_FAILURE);
+     }
+     if (wav)
+	 write_wav_header(fp, num_samples, num_channels);
+     else
+	 write_sph_header(fp, num_samples, num_channels);
+
+     memset(ch, 0, sizeof(ch));
+     for (c=0; c<num_channels; c++) {
+	 ch[c].zero = (strchr(CL_ZeroChannels, 'A'+c) != NULL);
+	 sprintf(phnfile, "%s_%c.phn", base, 'A'+c);
+	 if ((ch[c].phn=fopen(phnfile, "w")) == NULL) {
+	     fprintf(stderr,"Unable to open %s for write\n",phnfile);
+	     exit(EXIT_FAILURE);
+	 }
+	 ch[c].burst = (vec_t *)vector(0, (long)(MAX_TALK*srate), sizeof(vec_t));
+     }
+
+     /* One second per block: the clean bursts of all channels are needed for the crosstalk */
+     block = srate;
+     clean = (double **)matrix(0, num_channels-1, 0, block-1, sizeof(double), sizeof(double *));
+     out = (short *)vector(0, block*num_channels-1, sizeof(short));
+     for (pos=0; pos<num_samples; pos+=block_len) {
+	 block_len = (num_samples-pos < block) ? num_samples-pos : block;
+	 for (c=0; c<num_channels; c++)
+	     for (i=0; i<block_len; i++) {
+		 if (pos+i == ch[c].seg_end || pos+i == 0)
+		     next_segment(&ch[c], pos+i, num_samples, talk, pause);
+		 clean[c][i] = (ch[c].speech && !ch[c].zero) ? ch[c].burst[pos+i-ch[c].seg_begin] : 0.0;
+	     }
+	 for (c=0; c<num_channels; c++)
+	     for (i=0; i<block_len; i++) {
+		 if (ch[c].zero) {
+		     out[i*num_channels+c] = 0;
+		     continue;
+		 }
+		 x = clean[c][i] + noise_sample(&ch[c], pink);
+		 for (d=0; d<num_channels; d++)
+		     if (d != c)
+			 x += leak*clean[d][i];
+		 if (pulse_prob > 0.0 && uniform() < pulse_prob)
+		     ch[c].pulse = (uniform() < 0.5) ? -PULSE_AMP : PULSE_AMP;
+		 if (ch[c].pulse != 0.0) {
+		     x += ch[c].pulse*gaussian();
+		     ch[c].pulse *= exp(-1.0/(PULSE_LEN*srate));
+		     if (fabs(ch[c].pulse) < 1.0)
+			 ch[c].pulse = 0.0;
+		 }
+		 out[i*num_channels+c] = (x > 32767.0) ? 32767 : (x < -32768.0) ? -32768 : (short)x;
+	     }
+	 fwrite(out, sizeof(short), block_len*num_channels, fp);
+     }
+     fclose(fp);
+
+     for (c=0; c<num_channels; c++) {
+	 if (ch[c].zero) {	/* An all-zero channel has no speech at all */
+	     fclose(ch[c].phn);
+	     sprintf(phnfile, "%s_%c.phn", base, 'A'+c);
+	     ch[c].phn = fopen(phnfile, "w");
+	     fprintf(ch[c].phn, "0 %lu h#\n", num_samples);
+	     ch[c].num_bursts = 0;
+	     ch[c].speech_time = 0.0;
+	 }
+	 else
+	     fprintf(ch[c].phn, "%lu %lu %s\n", ch[c].seg_begin, ch[c].seg_end, ch[c].speech ? "S" : "h#");
+	 fclose(ch[c].phn);
+	 printf("Channel %c: %lu bursts, %.1f%% speech\n", 'A'+c, ch[c].num_bursts,
+		100.0*ch[c].speech_time*srate/num_samples);
+	 free_vector((char *)ch[c].burst, 0, sizeof(vec_t));
+     }
+     printf("%s: %lu samples x %d channels at %ld Hz (%.1f sec)\n", CL_OutFile, num_samples,
+	    num_channels, srate, (double)num_samples/srate);
+     free_matrix((char **)clean, 0, num_channels-1, 0);
+     free_vector((char *)out, 0, sizeof(short));
+     return(0);
+}
@@ -16,16 +16,46 @@
                     than unsigned long so that matrix can start and
                     end with negative index
  Modified(22/11/92): Heap check in free_vector()
+ Modified(Oct 26): Count the bytes allocated by x_malloc()/x_calloc()
+                   and freed by free_vector()/free_matrix(), see mem_get_stat()
+ Modified(Oct 26): Update the counters atomically so that the library
+                   can be called from several threads (libssvad)
+ Modified(Oct 26): Arena of scratch memory, see mem_arena_new()
+ Modified(Oct 26): Keep the counters per thread, as the arena, so that
+                   the profile of one thread is not mixed with others
 ************************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "mmalloc.h"
 
 #ifdef   _BORLANDC_
 #include <alloc.h> 			/* Borlandc support far data */
+#else
+#include <malloc.h>			/* malloc_usable_size() */
 #endif
 
+static __thread MEM_STAT mem_stat;	/* Usage of the blocks of x_malloc() and x_calloc() by the calling thread */
+
+/* A chunk of an arena, followed by its data at CHUNK_HDR bytes from the start */
+typedef struct MEM_CHUNK {
+	struct MEM_CHUNK *next;		/* Chunk filled before this one */
+	unsigned long size;		/* Bytes of data */
+	unsigned long used;		/* Bytes of data given out */
+} MEM_CHUNK;
+
+struct MEM_ARENA {
+	MEM_CHUNK *chunk;		/* Chunk being filled, NULL before the first allocation */
+};
+
+#define ARENA_ROUND(n)	(((n)+MEM_ARENA_ALIGN-1) & ~(unsigned long)(MEM_ARENA_ALIGN-1))
+#define CHUNK_HDR	ARENA_ROUND(sizeof(MEM_CHUNK))
+#define CHUNK_DATA(c)	((char *)(c)+CHUNK_HDR)
+#define ARENA_MIN_CHUNK	(256*1024L)	/* Size of the first chunk of mem_arena_new(0) */
+
+static __thread MEM_ARENA *cur_arena;	/* Arena of the calling thread, see mem_arena_use() */
+
 /**************** Start of Library Routines ***********************/
 
 /*****************************************************************
@@ -70,6 +100,191 @@ long start_index,end_index,obj_size;
 }
 
 
+/*****************************************************************
+ Add (sign=1) or remove (sign=-1) block p in the memory usage.
+ The size of the block is taken from the C library, so that blocks
+ freed by free_vector() need not remember their size.
+ The counters belong to the calling thread. A block freed by another
+ thread than the one that allocated it is taken from the usage of
+ the freeing thread, which does not go below 0.
+*******************************************************************/
+static void mem_count(char *p, int sign)
+{
+#ifndef _BORLANDC_
+	unsigned long size = (unsigned long)malloc_usable_size(p);
+
+	if (sign > 0) {
+	    mem_stat.cur_bytes += size;
+	    mem_stat.num_allocs++;
+	    if (mem_stat.cur_bytes > mem_stat.peak_bytes)
+		mem_stat.peak_bytes = mem_stat.cur_bytes;
+	} else {
+	    mem_stat.cur_bytes -= (size < mem_stat.cur_bytes) ? size : mem_stat.cur_bytes;
+	    mem_stat.num_frees++;
+	}
+#endif
+}
+
+/*****************************************************************
+ Return the memory usage of the blocks allocated by vector(), matrix(),
+ x_malloc() and x_calloc() in the calling thread
+*******************************************************************/
+void mem_get_stat(MEM_STAT *stat)
+{
+	*stat = mem_stat;
+}
+
+/*****************************************************************
+ Restart the peak of the calling thread from its current usage,
+ e.g. at the start of a processing stage
+*******************************************************************/
+void mem_reset_peak(void)
+{
+	mem_stat.peak_bytes = mem_stat.cur_bytes;
+}
+
+
+
+/*****************************************************************
+ Arena of scratch memory. Blocks are taken from the current chunk
+ by moving a pointer; when it is full, a chunk twice as large is
+ added. mem_arena_reset() merges the chunks into one, so that once
+ the arena has grown to the largest file, later files are
+ processed without calling malloc() or free().
+*******************************************************************/
+static MEM_CHUNK *new_chunk(unsigned long size, MEM_CHUNK *next)
+{
+	void *p;
+	MEM_CHUNK *c;
+
+	if (posix_memalign(&p, MEM_ARENA_ALIGN, CHUNK_HDR+size) != 0)
+	    return (MEM_CHUNK *)NULL;
+	mem_count((char *)p, 1);
+	c = (MEM_CHUNK *)p;
+	c->next = next;
+	c->size = size;
+	c->used = 0;
+	return c;
+}
+
+static void free_chunks(MEM_CHUNK *c)
+{
+	MEM_CHUNK *next;
+
+	for (; c != NULL; c = next) {
+	    next = c->next;
+	    mem_count((char *)c, -1);
+	    free(c);
+	}
+}
+
+/* Take size bytes from the arena, NULL if out of memory */
+static char *arena_alloc(MEM_ARENA *arena, unsigned long size)
+{
+	MEM_CHUNK *c = arena->chunk;
+	unsigned long n;
+	char *p;
+
+	size = ARENA_ROUND(size > 0 ? size : 1);
+	if (c == NULL || c->used+size > c->size) {
+	    n = (c != NULL) ? 2*c->size : ARENA_MIN_CHUNK;
+	    if (n < size)
+		n = size;
+	    if ((c = new_chunk(n, arena->chunk)) == NULL)
+		return (char *)NULL;
+	    arena->chunk = c;
+	}
+	p = CHUNK_DATA(c)+c->used;
+	c->used += size;
+	return p;
+}
+
+/* Chunk of the current arena holding block p, NULL if p is not in the arena */
+static MEM_CHUNK *arena_owner(char *p)
+{
+	MEM_CHUNK *c;
+
+	if (cur_arena == NULL)
+	    return (MEM_CHUNK *)NULL;
+	for (c = cur_arena->chunk; c != NULL; c = c->next) {
+	    if (p >= CHUNK_DATA(c) && p < CHUNK_DATA(c)+c->size)
+		return c;
+	}
+	return (MEM_CHUNK *)NULL;
+}
+
+/*****************************************************************
+ Create an arena with size bytes (0 to allocate on first use)
+*******************************************************************/
+MEM_ARENA *mem_arena_new(unsigned long size)
+{
+	MEM_ARENA *arena;
+
+	if ((arena = (MEM_ARENA *)calloc(1, sizeof(MEM_ARENA))) == NULL)
+	    return (MEM_ARENA *)NULL;
+	if (size > 0 && (arena->chunk = new_chunk(ARENA_ROUND(size), NULL)) == NULL) {
+	    free(arena);
+	    return (MEM_ARENA *)NULL;
+	}
+	return arena;
+}
+
+void mem_arena_free(MEM_ARENA *arena)
+{
+	if (arena == NULL)
+	    return;
+	if (cur_arena == arena)
+	    cur_arena = (MEM_ARENA *)NULL;
+	free_chunks(arena->chunk);
+	free(arena);
+}
+
+/*****************************************************************
+ Make the calling thread allocate from arena (NULL: from the heap)
+ and return the arena used before. A block of the arena must not be
+ passed to free_vector() or free_matrix() after the arena is no
+ longer in use.
+*******************************************************************/
+MEM_ARENA *mem_arena_use(MEM_ARENA *arena)
+{
+	MEM_ARENA *prev = cur_arena;
+
+	cur_arena = arena;
+	return prev;
+}
+
+/*****************************************************************
+ Release all blocks of the arena, keeping its memory
+*******************************************************************/
+void mem_arena_reset(MEM_ARENA *arena)
+{
+	unsigned long size;
+
+	if (arena == NULL || arena->chunk == NULL)
+	    return;
+	if (arena->chunk->next != NULL) {
+	    size = mem_arena_size(arena);
+	    free_chunks(arena->chunk);
+	    arena->chunk = new_chunk(size, NULL);	/* If NULL, grow again on demand */
+	} else {
+	    arena->chunk->used = 0;
+	}
+}
+
+/* Bytes held by the arena */
+unsigned long mem_arena_size(const MEM_ARENA *arena)
+{
+	const MEM_CHUNK *c;
+	unsigned long size = 0;
+
+	if (arena != NULL) {
+	    for (c = arena->chunk; c != NULL; c = c->next)
+		size += c->size;
+	}
+	return size;
+}
+
+
 /************************************************************/
 /*	FREE_MATRIX					    */
 /*  free memory allocated by matrix()			    */
@@ -81,8 +296,17 @@ int   rs,cs,obj_size;
 #ifdef _BORLANDC_
       free_farmatrix(matrix,rs,cs,obj_size);
 #else
-      free((char huge *) (&matrix[rs][cs*obj_size]));
-      free((char huge *) (&matrix[rs]));
+      char *p = (char huge *) (&matrix[rs][cs*obj_size]);
+
+      if (arena_owner(p) == NULL) {
+	  mem_count(p, -1);
+	  free(p);
+      }
+      p = (char huge *) (&matrix[rs]);
+      if (arena_owner(p) == NULL) {
+	  mem_count(p, -1);
+	  free(p);
+      }
 #endif
 }
 
@@ -98,10 +322,46 @@ long nl,obj_size;
 	if (farheapcheck()==_HEAPCORRUPT || heapcheck()==_HEAPCORRUPT)
 	    put_error("\nHeap is corrupted");
 #else
+	if (arena_owner((char*) (v+nl*obj_size)) != NULL)
+	    return;			/* Released by mem_arena_reset() */
+	mem_count((char*) (v+nl*obj_size), -1);
 	free((char*) (v+nl*obj_size));
 #endif
 }
 
+/***************************************************************
+ Change the size of a vector allocated by vector(nl,...) to
+ [nl..nh]. The new elements are not initialized.
+****************************************************************/
+char huge *resize_vector(v,nl,nh,obj_size)
+char huge *v;
+long nl,nh,obj_size;
+{
+	char *p, *old = (char*) (v+nl*obj_size);
+	MEM_CHUNK *c;
+	unsigned long size = (unsigned long)(nh-nl+1)*obj_size;
+
+	if ((c = arena_owner(old)) != NULL) {
+	    /* The old block ends before the end of the used part of its chunk */
+	    unsigned long avail = (unsigned long)(CHUNK_DATA(c)+c->used-old);
+
+	    if ((p = arena_alloc(cur_arena, size)) == (char *)NULL) {
+		printf("Insufficient memory in resize_vector\n");
+		exit(1);
+	    }
+	    memcpy(p, old, (avail < size) ? avail : size);
+	    return ((char huge *)p-nl*obj_size);
+	}
+	mem_count(old, -1);
+	p = (char *)realloc(old, (size_t)size);
+	if (p==(char *)NULL) {
+	    printf("Insufficient memory in resize_vector\n");
+	    exit(1);
+	}
+	mem_count(p, 1);
+	return ((char huge *)p-nl*obj_size);
+}
+
 
 
 #ifdef _BORLANDC_
@@ -237,11 +497,19 @@ char    *x_malloc(size)
 unsigned int size;
 {
       char  *p;
+      if (cur_arena != NULL) {
+	  if ((p = arena_alloc(cur_arena, size)) == (char *)NULL) {
+	      printf("\nInsufficient memory in x_malloc");
+	      exit(1);
+	  }
+	  return(p);
+      }
       p = (char *)malloc((unsigned)size);
       if (p==(char *)NULL) {
 	  printf("\nInsufficient memory in x_malloc");
 	  exit(1);
       }
+      mem_count(p, 1);
       return(p);
 }
 
@@ -254,11 +522,20 @@ char    *x_calloc(size)
 unsigned int size;
 {
       char  *p;
+      if (cur_arena != NULL) {
+	  if ((p = arena_alloc(cur_arena, size)) == (char *)NULL) {
+	      printf("Insufficient memory in x_calloc\n");
+	      exit(1);
+	  }
+	  memset(p, 0, size);
+	  return(p);
+      }
       p = (char *)calloc((size_t)size,sizeof(char));
       if (p==(char *)NULL) {
 	  printf("Insufficient memory in x_calloc\n");
 	  exit(1);
       }
+      mem_count(p, 1);
       return(p);
 }
 
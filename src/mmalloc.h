@@ -37,12 +37,36 @@
   #endif			/* end if _BORLANDC_ */
 
 
+/* Bytes and number of blocks allocated through this library by one thread */
+typedef struct {
+	unsigned long cur_bytes;	/* Bytes currently allocated */
+	unsigned long peak_bytes;	/* Largest cur_bytes since the last mem_reset_peak() */
+	unsigned long num_allocs;	/* Number of allocations since the start */
+	unsigned long num_frees;	/* Number of blocks freed since the start */
+} MEM_STAT;
+
+/* Bump allocator for the scratch memory of one file. While an arena is in use
+   by a thread (mem_arena_use()), vector(), matrix(), x_malloc() and x_calloc()
+   of that thread return 64-byte aligned blocks of the arena, free_vector() and
+   free_matrix() of these blocks do nothing, and mem_arena_reset() releases
+   all of them at once. */
+typedef struct MEM_ARENA MEM_ARENA;
+#define MEM_ARENA_ALIGN 64
+
 #if defined _ANSI_ || defined _BORLANDC_
 float **fmatrix(int,int,int,int);
 char huge **matrix(int,int,int,int,int,int);
 char huge *vector(long, long, long);
 void free_matrix(char huge **, int,int,int);
 void free_vector(char huge *,long,long);
+char huge *resize_vector(char huge *, long, long, long);
+void mem_get_stat(MEM_STAT *stat);
+void mem_reset_peak(void);
+MEM_ARENA *mem_arena_new(unsigned long size);
+void mem_arena_free(MEM_ARENA *arena);
+MEM_ARENA *mem_arena_use(MEM_ARENA *arena);
+void mem_arena_reset(MEM_ARENA *arena);
+unsigned long mem_arena_size(const MEM_ARENA *arena);
 float huge **convert_matrix(float huge *a, int nrl, int nrh, int ncl, int nch);
 float huge **submatrix(float huge **a, int oldrl,int oldrh,int oldcl, int oldch,int newrl, int newcl);
 void free_submatrix(float huge **m, int nrl, int nrh, int ncl, int nch);
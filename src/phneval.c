@@ -0,0 +1,477 @@
+/* Filename	:phneval.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :Speed and accuracy of variants of sph2phn and sph2phn_2ch.
+                 Every variant is run on every file of a list, -j at a time,
+		 and each .phn file is scored against the reference .phn file
+		 of the list (read with PhnFileRead):
+
+		 miss	 Speech samples of the reference labelled h# (% of speech)
+		 fa	 h# samples of the reference labelled speech (% of non-speech)
+		 bnd(ms) Mean distance from each boundary of the reference to the
+			 nearest boundary of the output
+		 dratio	 Speech ratio of the output minus that of the reference
+
+		 The table gives these for each variant, with the real-time
+		 factors of the CPU time and of the wall time, sorted by RTF.
+		 Variants marked * are on the Pareto front: no other variant is
+		 both faster and more accurate (miss+fa). With -tol, the fastest
+		 variant with miss+fa <= tol is reported.
+
+		 File list, one file per line ('#' for comments):
+		     <audio file> <channel> <reference .phn>
+		 Variant file, one variant per line:
+		     <name> <program> <options>
+		 The input option (-sph, -wav, -flac or -raw) follows the file
+		 extension; -phn and -ch are added to the options.
+
+   Example      :phneval -list files.lst -var variants.lst -j 8 -tol 5
+		 where variants.lst contains
+		     default	sph2phn
+		     nodenoise	sph2phn -dn N
+		     autodn	sph2phn -dn A -snr 30
+		     2ch	sph2phn_2ch
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "mmalloc.h"
+#include "cmdline.h"
+#include "segment.h"
+#include "sph_io.h"
+#include "winwav.h"
+#include "flac.h"
+#include "profile.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_ListFile=(char *)NULL,		/* Audio files, channels and reference .phn files */
+     *CL_VariantFile=(char *)NULL,	/* Variants to compare, default "default sph2phn" */
+     *CL_BinDir="../bin",		/* Directory of the programs */
+     *CL_TmpDir="/tmp",			/* Directory of the output .phn files */
+     *CL_NumJobs="0",			/* Number of programs run in parallel, 0 for one per CPU */
+     *CL_Tolerance=(char *)NULL,	/* Largest acceptable miss+fa in % */
+     *CL_JsonFile=(char *)NULL;		/* Append the results of each variant as JSON lines */
+
+CLINEPARA options[]=
+{
+    {"-ListFile", "-list", &CL_ListFile},
+    {"-VariantFile", "-var", &CL_VariantFile},
+    {"-BinDir", "-bin", &CL_BinDir},
+    {"-TmpDir", "-tmp", &CL_TmpDir},
+    {"-NumJobs", "-j", &CL_NumJobs},
+    {"-Tolerance", "-tol", &CL_Tolerance},
+    {"-JsonFile", "-json", &CL_JsonFile}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define MAX_LINE    1024
+#define MAX_ARGS    64
+#define MAX_VARIANT 64
+#define NON_SPEECH  "h#"
+
+typedef struct {
+	char	audio[MAX_LINE];
+	char	channel[4];
+	char	ref[MAX_LINE];
+	double	srate;
+	double	duration;		/* In sec */
+} TEST_FILE;
+
+typedef struct {
+	char	name[64];
+	char	line[MAX_LINE];		/* Program and options */
+	double	cpu, wall, audio;
+	double	miss, fa;		/* Samples */
+	double	speech, nonspeech;	/* Samples of the references */
+	double	bnd_err;		/* Sum of boundary errors in sec */
+	long	num_bnd;
+	double	dratio;			/* Sum of speech ratio differences */
+	int	num_scored, num_failed;
+} VARIANT;
+
+typedef struct {
+	int	variant, file;
+	pid_t	pid;
+	double	start;
+	char	phn[MAX_LINE];
+} JOB;
+
+
+/* Sampling rate and duration of an audio file from its header */
+static int audio_info(char *file, double *srate, double *duration)
+{
+     SPH_HEADER hdr;
+     WAV_INFO info;
+     INT16 **buf = NULL;
+     unsigned long n;
+     FILE *fp;
+     char *ext = strrchr(file, '.');
+     int c;
+
+     *srate = *duration = 0.0;
+     if (ext != NULL && (strcmp(ext, ".wav") == 0 || strcmp(ext, ".flac") == 0)) {
+	 if (strcmp(ext, ".wav") == 0)
+	     buf = WavReadChannels(file, &info, 0, 0.0, 0.01, &n);
+	 else
+	     buf = FlacReadChannels(file, &info, 0, 0.0, 0.01, &n);
+	 if (buf == NULL)
+	     return -1;
+	 for (c=0; c<info.channel; c++)
+	     if (buf[c] != NULL)
+		 free_vector((char *)buf[c], 0, sizeof(INT16));
+	 free(buf);
+	 *srate = info.srate;
+	 *duration = (double)info.num_frames/info.srate;
+	 return 0;
+     }
+     if ((fp=fopen(file, "r")) == NULL)
+	 return -1;
+     if (read_sph_header(fp, &hdr) == 0 && hdr.sample_rate > 0) {
+	 *srate = hdr.sample_rate;
+	 *duration = (double)hdr.sample_count/hdr.sample_rate;
+     }
+     fclose(fp);
+     return (*srate > 0.0) ? 0 : -1;
+}
+
+static int read_list(char *file, TEST_FILE **list)
+{
+     FILE *fp;
+     char line[3*MAX_LINE];
+     int n = 0, size = 0;
+
+     if ((fp=fopen(file, "r")) == NULL) {
+	 fprintf(stderr,"Unable to open %s\n",file);
+	 exit(EXIT_FAILURE);
+     }
+     *list = NULL;
+     while (fgets(line, sizeof(line), fp) != NULL) {
+	 if (line[0] == '#')
+	     continue;
+	 if (n == size) {
+	     size = (size > 0) ? 2*size : 64;
+	     *list = (TEST_FILE *)realloc(*list, size*sizeof(TEST_FILE));
+	 }
+	 if (sscanf(line, "%1023s %3s %1023s", (*list)[n].audio, (*list)[n].channel, (*list)[n].ref) != 3)
+	     continue;
+	 if (access((*list)[n].ref, R_OK) != 0) {
+	     fprintf(stderr,"Unable to open %s, skipped\n",(*list)[n].ref);
+	     continue;
+	 }
+	 if (audio_info((*list)[n].audio, &(*list)[n].srate, &(*list)[n].duration) < 0) {
+	     fprintf(stderr,"Unable to read the header of %s, skipped\n",(*list)[n].audio);
+	     continue;
+	 }
+	 n++;
+     }
+     fclose(fp);
+     return n;
+}
+
+static int read_variants(char *file, VARIANT *var)
+{
+     FILE *fp;
+     char line[MAX_LINE];
+     int n = 0, len;
+
+     memset(var, 0, MAX_VARIANT*sizeof(VARIANT));
+     if (file == NULL) {
+	 strcpy(var[0].name, "default");
+	 strcpy(var[0].line, "sph2phn");
+	 return 1;
+     }
+     if ((fp=fopen(file, "r")) == NULL) {
+	 fprintf(stderr,"Unable to open %s\n",file);
+	 exit(EXIT_FAILURE);
+     }
+     while (n < MAX_VARIANT && fgets(line, MAX_LINE, fp) != NULL) {
+	 if (line[0] == '#' || sscanf(line, "%63s %n", var[n].name, &len) != 1 || line[len] == '\0')
+	     continue;
+	 strcpy(var[n].line, line+len);
+	 var[n].line[strcspn(var[n].line, "\r\n")] = '\0';
+	 n++;
+     }
+     fclose(fp);
+     return n;
+}
+
+
+/* Start variant v on file f, with stdout and stderr to /dev/null */
+static pid_t start_job(VARIANT *v, TEST_FILE *f, char *phnfile)
+{
+     char line[MAX_LINE], path[MAX_LINE], *argv[MAX_ARGS], *ext;
+     int argc = 0, fd;
+     pid_t pid;
+
+     strcpy(line, v->line);
+     for (argv[argc]=strtok(line, " \t"); argv[argc] != NULL && argc < MAX_ARGS-7; )
+	 argv[++argc] = strtok(NULL, " \t");
+     ext = strrchr(f->audio, '.');
+     if (ext != NULL && strcmp(ext, ".wav") == 0)
+	 argv[argc++] = "-wav";
+     else if (ext != NULL && strcmp(ext, ".flac") == 0)
+	 argv[argc++] = "-flac";
+     else if (ext != NULL && strcmp(ext, ".raw") == 0)
+	 argv[argc++] = "-raw";
+     else
+	 argv[argc++] = "-sph";
+     argv[argc++] = f->audio;
+     argv[argc++] = "-phn";
+     argv[argc++] = phnfile;
+     argv[argc++] = "-ch";
+     argv[argc++] = f->channel;
+     argv[argc] = NULL;
+     sprintf(path, "%s/%s", CL_BinDir, argv[0]);
+
+     if ((pid=fork()) == 0) {
+	 fd = open("/dev/null", O_WRONLY);
+	 dup2(fd, STDOUT_FILENO);
+	 dup2(fd, STDERR_FILENO);
+	 execv(path, argv);
+	 _exit(127);
+     }
+     return pid;
+}
+
+
+/* Speech (non-h#) intervals of a .phn file, [begin,end) in samples */
+static int speech_intervals(char *file, long **iv)
+{
+     SEGMENT *seg = PhnFileRead(file);
+     int s, n = 0;
+
+     *iv = NULL;
+     if (seg == NULL)
+	 return 0;
+     *iv = (long *)vector(0, 2*seg[0].num_segs, sizeof(long));
+     for (s=0; s<seg[0].num_segs; s++) {
+	 if (strcmp(seg[s].phoneme, NON_SPEECH) == 0)
+	     continue;
+	 if (n > 0 && (*iv)[2*n-1] == seg[s].begin)	/* Merge adjacent speech segments */
+	     (*iv)[2*n-1] = seg[s].end+1;
+	 else {
+	     (*iv)[2*n] = seg[s].begin;
+	     (*iv)[2*n+1] = seg[s].end+1;
+	     n++;
+	 }
+     }
+     free_vector((char *)seg, 0, sizeof(SEGMENT));
+     return n;
+}
+
+/* Number of samples of [0,len) in the intervals a but not in b */
+static long difference(long *a, int na, long *b, int nb, long len)
+{
+     long diff = 0, pos, end;
+     int i, j = 0;
+
+     for (i=0; i<na; i++) {
+	 pos = a[2*i];
+	 end = (a[2*i+1] < len) ? a[2*i+1] : len;
+	 while (pos < end) {
+	     while (j < nb && b[2*j+1] <= pos)
+		 j++;
+	     if (j == nb || b[2*j] >= end) {
+		 diff += end-pos;
+		 break;
+	     }
+	     if (b[2*j] > pos)
+		 diff += b[2*j]-pos;
+	     pos = b[2*j+1];
+	 }
+     }
+     return diff;
+}
+
+static long length(long *a, int n, long len)
+{
+     long sum = 0;
+     int i;
+
+     for (i=0; i<n; i++)
+	 sum += ((a[2*i+1] < len) ? a[2*i+1] : len) - a[2*i];
+     return sum;
+}
+
+/* Score the output phnfile of variant v against the reference of file f */
+static void score(VARIANT *v, TEST_FILE *f, char *phnfile)
+{
+     long *ref, *hyp, len, b, d, best;
+     int nr, nh, i, j;
+     double rs, hs;
+
+     if (access(phnfile, R_OK) != 0) {
+	 v->num_failed++;
+	 return;
+     }
+     nr = speech_intervals(f->ref, &ref);
+     nh = speech_intervals(phnfile, &hyp);
+     len = (long)(f->duration*f->srate+0.5);
+     rs = length(ref, nr, len);
+     hs = length(hyp, nh, len);
+     v->miss += difference(ref, nr, hyp, nh, len);
+     v->fa += difference(hyp, nh, ref, nr, len);
+     v->speech += rs;
+     v->nonspeech += len-rs;
+     v->dratio += (hs-rs)/len;
+     for (i=0; i<2*nr; i++) {
+	 b = ref[i];
+	 if (b <= 0 || b >= len)
+	     continue;
+	 for (best=(b < len-b) ? b : len-b, j=0; j<2*nh; j++) {
+	     d = labs(hyp[j]-b);
+	     if (d < best)
+		 best = d;
+	 }
+	 v->bnd_err += best/f->srate;
+	 v->num_bnd++;
+     }
+     v->num_scored++;
+     if (ref != NULL)
+	 free_vector((char *)ref, 0, sizeof(long));
+     if (hyp != NULL)
+	 free_vector((char *)hyp, 0, sizeof(long));
+}
+
+
+static double error(VARIANT *v)
+{
+     return 100.0*(v->miss/(v->speech > 0 ? v->speech : 1) + v->fa/(v->nonspeech > 0 ? v->nonspeech : 1));
+}
+
+static double rtf(VARIANT *v)
+{
+     return (v->audio > 0.0) ? v->cpu/v->audio : 0.0;
+}
+
+static int compare_rtf(const void *a, const void *b)
+{
+     double d = rtf((VARIANT *)a) - rtf((VARIANT *)b);
+
+     return (d > 0) - (d < 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+     TEST_FILE *file;
+     VARIANT var[MAX_VARIANT];
+     JOB *job;
+     struct rusage ru;
+     FILE *json = NULL;
+     int num_files, num_vars, num_jobs, max_jobs, running = 0, next = 0, done, status, v, k, pareto;
+     double tol = -1.0;
+     VARIANT *best = NULL;
+     pid_t pid;
+
+     if (argc>1)
+	 get_cmdline(argc, argv, num_options, options);
+     if (CL_ListFile == NULL) {
+	 fprintf(stderr,"No file list, use -list\n");
+	 usage(argv[0], num_options, options);
+	 exit(EXIT_FAILURE);
+     }
+     num_files = read_list(CL_ListFile, &file);
+     num_vars = read_variants(CL_VariantFile, var);
+     if (num_files == 0 || num_vars == 0) {
+	 fprintf(stderr,"Nothing to evaluate\n");
+	 exit(EXIT_FAILURE);
+     }
+     if ((max_jobs=atoi(CL_NumJobs)) < 1 && (max_jobs=(int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+	 max_jobs = 1;
+     if (CL_Tolerance != NULL)
+	 tol = atof(CL_Tolerance);
+
+     /* Run all variants on all files, max_jobs at a time */
+     num_jobs = num_vars*num_files;
+     job = (JOB *)vector(0, num_jobs-1, sizeof(JOB));
+     for (k=0; k<num_jobs; k++) {
+	 job[k].variant = k/num_files;
+	 job[k].file = k%num_files;
+	 job[k].pid = 0;
+	 sprintf(job[k].phn, "%s/phneval_%d_%d.phn", CL_TmpDir, (int)getpid(), k);
+     }
+     for (done=0; done<num_jobs; ) {
+	 while (running < max_jobs && next < num_jobs) {
+	     job[next].start = prof_wall_time();
+	     job[next].pid = start_job(&var[job[next].variant], &file[job[next].file], job[next].phn);
+	     if (job[next].pid < 0) {
+		 fprintf(stderr,"Unable to start a job\n");
+		 exit(EXIT_FAILURE);
+	     }
+	     running++;
+	     next++;
+	 }
+	 if ((pid=wait4(-1, &status, 0, &ru)) < 0)
+	     break;
+	 for (k=0; k<next && job[k].pid != pid; k++)
+	     ;
+	 if (k == next)
+	     continue;
+	 running--;
+	 done++;
+	 v = job[k].variant;
+	 var[v].wall += prof_wall_time() - job[k].start;
+	 var[v].cpu += ru.ru_utime.tv_sec + 1e-6*ru.ru_utime.tv_usec + ru.ru_stime.tv_sec + 1e-6*ru.ru_stime.tv_usec;
+	 var[v].audio += file[job[k].file].duration;
+	 if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	     score(&var[v], &file[job[k].file], job[k].phn);
+	 else
+	     var[v].num_failed++;
+	 unlink(job[k].phn);
+	 fprintf(stderr,"\r%d/%d", done, num_jobs);
+     }
+     fprintf(stderr,"\n");
+
+     /* Table sorted by RTF; a variant is on the Pareto front if all faster ones are less accurate */
+     qsort(var, num_vars, sizeof(VARIANT), compare_rtf);
+     if (CL_JsonFile != NULL && (json=fopen(CL_JsonFile, "a")) == NULL)
+	 fprintf(stderr,"Unable to open %s for write\n",CL_JsonFile);
+     printf("%d files, %d jobs in parallel\n", num_files, max_jobs);
+     printf("  %-16s %9s %9s %8s %8s %8s %8s %8s  %s\n", "variant", "RTF", "wallRTF", "miss(%)",
+	    "fa(%)", "bnd(ms)", "dratio", "failed", "command");
+     for (v=0; v<num_vars; v++) {
+	 VARIANT *p = &var[v];
+	 double dratio = (p->num_scored > 0) ? 100.0*p->dratio/p->num_scored : 0.0;
+
+	 for (pareto=(p->num_scored > 0), k=0; k<v; k++)
+	     if (var[k].num_scored > 0 && error(&var[k]) <= error(p))
+		 pareto = 0;
+	 if (p->num_scored > 0 && error(p) <= tol && best == NULL)
+	     best = p;
+	 printf("%c %-16s %9.5f %9.5f %8.2f %8.2f %8.1f %+8.2f %8d  %s\n", pareto ? '*' : ' ', p->name,
+		rtf(p), (p->audio > 0.0) ? p->wall/p->audio : 0.0,
+		100.0*p->miss/(p->speech > 0 ? p->speech : 1), 100.0*p->fa/(p->nonspeech > 0 ? p->nonspeech : 1),
+		(p->num_bnd > 0) ? 1000.0*p->bnd_err/p->num_bnd : 0.0, dratio, p->num_failed, p->line);
+	 if (json != NULL)
+	     fprintf(json, "{\"variant\":\"%s\",\"command\":\"%s\",\"rtf\":%.6g,\"wall_rtf\":%.6g,"
+		     "\"miss\":%.4f,\"fa\":%.4f,\"boundary_ms\":%.2f,\"speech_ratio_delta\":%.4f,"
+		     "\"files\":%d,\"failed\":%d,\"pareto\":%d}\n", p->name, p->line, rtf(p),
+		     (p->audio > 0.0) ? p->wall/p->audio : 0.0,
+		     100.0*p->miss/(p->speech > 0 ? p->speech : 1), 100.0*p->fa/(p->nonspeech > 0 ? p->nonspeech : 1),
+		     (p->num_bnd > 0) ? 1000.0*p->bnd_err/p->num_bnd : 0.0, dratio,
+		     p->num_scored, p->num_failed, pareto);
+     }
+     if (json != NULL)
+	 fclose(json);
+     if (tol >= 0.0) {
+	 if (best != NULL)
+	     printf("Fastest variant with miss+fa <= %g%%: %s (RTF %.5f)\n", tol, best->name, rtf(best));
+	 else
+	     printf("No variant with miss+fa <= %g%%\n", tol);
+     }
+     free_vector((char *)job, 0, sizeof(JOB));
+     free(file);
+     return(0);
+}
@@ -51,6 +51,8 @@ int main(int argc, char *argv[])
 
      /* Read .phn or .mrk file to define speech/nonspeech segments */
      seg = (SEGMENT *)PhnFileRead(CL_PhnFile);
+     if (seg == NULL)
+	 exit(EXIT_FAILURE);
 
      /* Print segment information in <#frames #segments #samples %speech> */
      num_samples = 0;
@@ -0,0 +1,42 @@
+/*
+   Filename	:probes.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Static tracepoints (USDT) of the VAD pipeline, provider "ssvad".
+                 Each probe is a single nop in the code until a tracer such as
+		 bpftrace or perf attaches to it. Without <sys/sdt.h> (package
+		 systemtap-sdt-dev), or with -DNO_USDT, the probes compile to
+		 nothing.
+
+		 file__start(file, channel)		Before reading the input file
+		 file__end(file, num_samples, num_segs)	After writing the .phn file
+		 stage__start(file, stage)		At prof_begin()
+		 stage__end(file, stage, wall_ns)	At prof_end()
+		 silence__segment(begin, end, speech)	Each segment of detect_silence()
+		 silence__segments(num_samples, num_segs) At the end of detect_silence()
+		 crosstalk__segments(num_samples, num_segs) At the end of remove_crosstalk_SRE10/12()
+
+		 Example: latency of each stage in microseconds
+		 bpftrace -e 'usdt:./sph2phn:ssvad:stage__end { @[str(arg1)] = hist(arg2/1000); }'
+*/
+
+#ifndef __PROBES_INCLUDE__
+#define __PROBES_INCLUDE__
+
+#if !defined(NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SSVAD_USDT
+#endif
+#endif
+
+#ifdef SSVAD_USDT
+#define SSVAD_PROBE2(name,a1,a2)	DTRACE_PROBE2(ssvad,name,a1,a2)
+#define SSVAD_PROBE3(name,a1,a2,a3)	DTRACE_PROBE3(ssvad,name,a1,a2,a3)
+#else
+#define SSVAD_PROBE2(name,a1,a2)	do { (void)(a1); (void)(a2); } while (0)
+#define SSVAD_PROBE3(name,a1,a2,a3)	do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,399 @@
+/*
+   Filename	:profile.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description  :Per-stage timing of the VAD pipeline. Each stage is enclosed in
+                 prof_begin()/prof_end(); stages with the same name (e.g. the
+		 denoising of channels A and B) are accumulated. Wall time is
+		 taken from the monotonic clock and CPU time from the process
+		 CPU clock. prof_write() appends one JSON line per file:
+
+		 {"program":"sph2phn","file":"x.sph","channel":"A","audio_sec":30.0,
+		  "wall":0.52,"cpu":0.51,"rtf":0.0173,"peak_bytes":5242880,
+		  "stages":{"read":{"calls":1,"wall":0.002,"cpu":0.002,"rtf":0.00007,
+		  "allocs":2,"peak_bytes":480000,"cur_bytes":480000},...}}
+
+		 The real-time factor (rtf) is wall time divided by audio_sec.
+		 The memory usage is that of the blocks allocated by mmalloc
+		 (vector(), matrix(), ...): each stage has the number of
+		 allocations, the peak and the usage at its end in bytes, and
+		 peak_bytes of the line is the largest peak of all stages.
+		 Use profinfo to print percentiles over many files.
+
+		 After prof_open_counters(), the stages also have the cycles,
+		 instructions, cache misses and branch misses of the process
+		 (user space only), read from perf_event_open(). Where the
+		 counters are not available (e.g. VMs, or perf_event_paranoid
+		 too high), only the times are reported. Stages given a frame
+		 count with prof_add_frames() have their cost per frame.
+
+		 prof_write_trace() appends the same stages as Chrome trace
+		 events ("ph":"X") to a JSON array shared by all runs, one
+		 span per call with the file name, channel, process and thread
+		 id. The array is left open, as allowed by the trace event
+		 format, and can be loaded into chrome://tracing or
+		 ui.perfetto.dev as it is.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include "mmalloc.h"
+#include "profile.h"
+#include "probes.h"
+
+
+static char *counter_name[PROF_NUM_COUNTERS] = {
+     "cycles", "instructions", "cache_misses", "branch_misses"
+};
+static unsigned long long counter_config[PROF_NUM_COUNTERS] = {
+     PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+     PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+
+double prof_wall_time(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+double prof_cpu_time(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+     return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+
+void prof_init(PROFILE *prof, char *program, char *file, char channel)
+{
+     int i;
+
+     memset(prof, 0, sizeof(PROFILE));
+     prof->program = program;
+     prof->file = file;
+     prof->channel = channel;
+     prof->cur = -1;
+     for (i=0; i<PROF_NUM_COUNTERS; i++)
+	 prof->counter_fd[i] = -1;
+     prof->wall0 = prof_wall_time();
+     prof->cpu0 = prof_cpu_time();
+}
+
+
+/***************************************************************************
+  prof_open_counters(): Open the hardware counters of this process. Counters
+                that the CPU or the kernel does not provide are left out.
+		Return the number of counters opened, 0 if none is available.
+*******************************************************************************/
+int prof_open_counters(PROFILE *prof)
+{
+     struct perf_event_attr attr;
+     int i, err = 0;
+
+     for (i=0; i<PROF_NUM_COUNTERS; i++) {
+	 memset(&attr, 0, sizeof(attr));
+	 attr.type = PERF_TYPE_HARDWARE;
+	 attr.size = sizeof(attr);
+	 attr.config = counter_config[i];
+	 attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	 attr.exclude_kernel = 1;
+	 attr.exclude_hv = 1;
+	 prof->counter_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	 if (prof->counter_fd[i] >= 0)
+	     prof->num_counters++;
+	 else
+	     err = errno;
+     }
+     if (prof->num_counters == 0)
+	 fprintf(stderr,"Hardware counters not available (%s), reporting times only\n",
+		 strerror(err));
+     return prof->num_counters;
+}
+
+/* Read the counters into count[], scaled up if the kernel multiplexed them */
+static void read_counters(PROFILE *prof, double *count)
+{
+     unsigned long long v[3];             /* value, time enabled, time running */
+     int i;
+
+     for (i=0; i<PROF_NUM_COUNTERS; i++) {
+	 count[i] = 0.0;
+	 if (prof->counter_fd[i] < 0 || read(prof->counter_fd[i], v, sizeof(v)) != sizeof(v))
+	     continue;
+	 if (v[2] > 0)
+	     count[i] = (double)v[0]*(double)v[1]/(double)v[2];
+     }
+}
+
+
+/* Start timing stage; a running stage is ended first */
+void prof_begin(PROFILE *prof, char *stage)
+{
+     MEM_STAT mem;
+     int s;
+
+     if (prof->cur >= 0)
+	 prof_end(prof);
+     for (s=0; s<prof->num_stages; s++)
+	 if (strcmp(prof->stage[s].name, stage) == 0)
+	     break;
+     if (s == prof->num_stages) {
+	 if (s == PROF_MAX_STAGES)
+	     return;
+	 strncpy(prof->stage[s].name, stage, PROF_NAME_LEN-1);
+	 prof->num_stages++;
+     }
+     mem_get_stat(&mem);
+     mem_reset_peak();
+     prof->stage_allocs0 = mem.num_allocs;
+     prof->cur = s;
+     SSVAD_PROBE2(stage__start, prof->file, prof->stage[s].name);
+     if (prof->num_counters > 0)
+	 read_counters(prof, prof->stage_count0);
+     prof->stage_wall0 = prof_wall_time();
+     prof->stage_cpu0 = prof_cpu_time();
+}
+
+
+void prof_end(PROFILE *prof)
+{
+     PROF_STAGE *st;
+     MEM_STAT mem;
+     double count[PROF_NUM_COUNTERS];
+     int i;
+
+     if (prof->cur < 0)
+	 return;
+     st = &prof->stage[prof->cur];
+     if (prof->num_counters > 0) {
+	 read_counters(prof, count);
+	 for (i=0; i<PROF_NUM_COUNTERS; i++)
+	     st->count[i] += count[i] - prof->stage_count0[i];
+     }
+     st->wall += prof_wall_time() - prof->stage_wall0;
+     st->cpu += prof_cpu_time() - prof->stage_cpu0;
+     st->calls++;
+     mem_get_stat(&mem);
+     st->allocs += mem.num_allocs - prof->stage_allocs0;
+     if (mem.peak_bytes > st->peak_bytes)
+	 st->peak_bytes = mem.peak_bytes;
+     if (mem.peak_bytes > prof->peak_bytes)
+	 prof->peak_bytes = mem.peak_bytes;
+     st->cur_bytes = mem.cur_bytes;
+     if (prof->num_spans < PROF_MAX_SPANS) {
+	 prof->span[prof->num_spans].stage = prof->cur;
+	 prof->span[prof->num_spans].start = prof->stage_wall0;
+	 prof->span[prof->num_spans].dur = prof_wall_time() - prof->stage_wall0;
+	 prof->num_spans++;
+     }
+     SSVAD_PROBE3(stage__end, prof->file, st->name,
+		  (unsigned long long)(1e9*(prof_wall_time()-prof->stage_wall0)));
+     prof->cur = -1;
+}
+
+
+void prof_set_audio(PROFILE *prof, unsigned long num_samples, long sample_rate)
+{
+     prof->audio_sec = (sample_rate > 0) ? (double)num_samples/(double)sample_rate : 0.0;
+}
+
+
+/* Add the number of frames processed by the running stage */
+void prof_add_frames(PROFILE *prof, unsigned long frames)
+{
+     if (prof->cur >= 0)
+	 prof->stage[prof->cur].frames += frames;
+}
+
+
+/* Write str as a JSON string */
+static void json_string(FILE *fp, char *str)
+{
+     unsigned char *p;
+
+     fputc('"', fp);
+     for (p=(unsigned char *)str; *p; p++) {
+	 if (*p == '"' || *p == '\\')
+	     fprintf(fp, "\\%c", *p);
+	 else if (*p < 0x20)
+	     fprintf(fp, "\\u%04x", *p);
+	 else
+	     fputc(*p, fp);
+     }
+     fputc('"', fp);
+}
+
+
+/* Write the hardware counts and the cost per frame of stage st */
+static void write_counters(FILE *fp, PROFILE *prof, PROF_STAGE *st)
+{
+     int i;
+
+     for (i=0; i<PROF_NUM_COUNTERS; i++)
+	 if (prof->counter_fd[i] >= 0)
+	     fprintf(fp, ",\"%s\":%.0f", counter_name[i], st->count[i]);
+     if (st->frames == 0)
+	 return;
+     fprintf(fp, ",\"frames\":%lu,\"ns_per_frame\":%.1f", st->frames, 1e9*st->wall/st->frames);
+     for (i=0; i<PROF_NUM_COUNTERS; i++)
+	 if (prof->counter_fd[i] >= 0)
+	     fprintf(fp, ",\"%s_per_frame\":%.1f", counter_name[i], st->count[i]/st->frames);
+}
+
+
+/* Append buf[0..len-1] to file ("-" for stdout) with a single write() on an
+   O_APPEND descriptor, so that concurrent runs sharing one file do not
+   interleave. head is written first if the file is empty; the file is
+   locked so that only one run can find it empty. head is not written to
+   stdout */
+static int append_file(char *file, char *buf, size_t len, char *head)
+{
+     struct stat sb;
+     int fd, ret = 0;
+
+     if (strcmp(file, "-") == 0) {
+	 fflush(stdout);
+	 fd = STDOUT_FILENO;
+     } else if ((fd=open(file, O_WRONLY|O_CREAT|O_APPEND, 0644)) < 0) {
+	 fprintf(stderr,"Unable to open %s for write\n",file);
+	 return -1;
+     }
+     if (head != NULL && fd != STDOUT_FILENO) {
+	 flock(fd, LOCK_EX);
+	 if (fstat(fd, &sb) == 0 && sb.st_size == 0 &&
+	     write(fd, head, strlen(head)) != (ssize_t)strlen(head))
+	     ret = -1;
+     }
+     if (write(fd, buf, len) != (ssize_t)len)
+	 ret = -1;
+     if (fd != STDOUT_FILENO)
+	 close(fd);                        /* Also releases the lock */
+     return ret;
+}
+
+
+/***************************************************************************
+  prof_write(): Append the profile as one JSON line to jsonfile ("-" for
+                stdout). Return 0 on success, -1 if the file cannot be
+		written.
+*******************************************************************************/
+int prof_write(PROFILE *prof, char *jsonfile)
+{
+     FILE *fp;
+     char *line = NULL;
+     size_t len = 0;
+     double wall, cpu, audio;
+     char ch[2];
+     int s, ret;
+
+     if (prof->cur >= 0)
+	 prof_end(prof);
+     wall = prof_wall_time() - prof->wall0;
+     cpu = prof_cpu_time() - prof->cpu0;
+     audio = (prof->audio_sec > 0.0) ? prof->audio_sec : 1.0;
+
+     if ((fp=open_memstream(&line, &len)) == NULL)
+	 return -1;
+     ch[0] = prof->channel;
+     ch[1] = '\0';
+     fprintf(fp, "{\"program\":");
+     json_string(fp, prof->program);
+     fprintf(fp, ",\"file\":");
+     json_string(fp, prof->file);
+     fprintf(fp, ",\"channel\":");
+     json_string(fp, ch);
+     fprintf(fp, ",\"audio_sec\":%.3f,\"wall\":%.6f,\"cpu\":%.6f,\"rtf\":%.6g,\"peak_bytes\":%lu,\"stages\":{",
+	     prof->audio_sec, wall, cpu, wall/audio, prof->peak_bytes);
+     for (s=0; s<prof->num_stages; s++) {
+	 fprintf(fp, "%s", (s > 0) ? "," : "");
+	 json_string(fp, prof->stage[s].name);
+	 fprintf(fp, ":{\"calls\":%d,\"wall\":%.6f,\"cpu\":%.6f,\"rtf\":%.6g,"
+		 "\"allocs\":%lu,\"peak_bytes\":%lu,\"cur_bytes\":%lu",
+		 prof->stage[s].calls, prof->stage[s].wall, prof->stage[s].cpu,
+		 prof->stage[s].wall/audio, prof->stage[s].allocs,
+		 prof->stage[s].peak_bytes, prof->stage[s].cur_bytes);
+	 write_counters(fp, prof, &prof->stage[s]);
+	 fprintf(fp, "}");
+     }
+     fprintf(fp, "}}\n");
+     fclose(fp);
+
+     ret = append_file(jsonfile, line, len, NULL);
+     free(line);
+     return ret;
+}
+
+
+/***************************************************************************
+  prof_write_trace(): Append the spans of the profile as Chrome trace events
+                to tracefile, which cannot be "-" (stdout): a new file is
+		started with "[", which needs a file to tell. Timestamps are in microseconds of the monotonic clock,
+		so that the runs on one machine share a time line. Return 0
+		on success, -1 if the file cannot be written.
+*******************************************************************************/
+int prof_write_trace(PROFILE *prof, char *tracefile)
+{
+     FILE *fp;
+     char *buf = NULL;
+     size_t len = 0;
+     char ch[2];
+     long pid, tid;
+     int i, ret;
+
+     if (strcmp(tracefile, "-") == 0) {
+	 fprintf(stderr,"Chrome trace events cannot be written to stdout\n");
+	 return -1;
+     }
+     if (prof->cur >= 0)
+	 prof_end(prof);
+     pid = (long)getpid();
+     tid = (long)syscall(SYS_gettid);
+     ch[0] = prof->channel;
+     ch[1] = '\0';
+
+     if ((fp=open_memstream(&buf, &len)) == NULL)
+	 return -1;
+     /* Name the process after the file, and add a span for the whole run */
+     fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":",
+	     pid, tid);
+     json_string(fp, prof->file);
+     fprintf(fp, "}},\n");
+     fprintf(fp, "{\"name\":");
+     json_string(fp, prof->program);
+     fprintf(fp, ",\"cat\":\"vad\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,"
+	     "\"args\":{\"file\":", 1e6*prof->wall0, 1e6*(prof_wall_time()-prof->wall0), pid, tid);
+     json_string(fp, prof->file);
+     fprintf(fp, ",\"channel\":");
+     json_string(fp, ch);
+     fprintf(fp, ",\"audio_sec\":%.3f}},\n", prof->audio_sec);
+     for (i=0; i<prof->num_spans; i++) {
+	 fprintf(fp, "{\"name\":");
+	 json_string(fp, prof->stage[prof->span[i].stage].name);
+	 fprintf(fp, ",\"cat\":\"vad\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,"
+		 "\"args\":{\"file\":", 1e6*prof->span[i].start, 1e6*prof->span[i].dur, pid, tid);
+	 json_string(fp, prof->file);
+	 fprintf(fp, ",\"channel\":");
+	 json_string(fp, ch);
+	 fprintf(fp, "}},\n");
+     }
+     fclose(fp);
+
+     ret = append_file(tracefile, buf, len, "[\n");
+     free(buf);
+     return ret;
+}
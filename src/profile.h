@@ -0,0 +1,67 @@
+/*
+   Filename	:profile.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Function prototypes for profile.c, which times the stages of the
+                 VAD pipeline (reading, findnoise, denoise, ...) and records their
+		 memory usage for -profile
+*/
+
+#ifndef __PROFILE_INCLUDE__
+#define __PROFILE_INCLUDE__
+
+#define PROF_MAX_STAGES 16
+#define PROF_NAME_LEN   32
+#define PROF_MAX_SPANS  64
+#define PROF_NUM_COUNTERS 4		/* cycles, instructions, cache misses, branch misses */
+
+typedef struct {
+	char	name[PROF_NAME_LEN];	/* Stage name, e.g. "denoise" */
+	int	calls;			/* Number of prof_begin()/prof_end() pairs */
+	double	wall;			/* Accumulated wall time in sec (monotonic clock) */
+	double	cpu;			/* Accumulated CPU time of the process in sec */
+	unsigned long allocs;		/* Number of mmalloc allocations in the stage */
+	unsigned long peak_bytes;	/* Largest mmalloc usage during the stage */
+	unsigned long cur_bytes;	/* mmalloc usage at the end of the stage */
+	double	count[PROF_NUM_COUNTERS];/* Hardware counts, see prof_open_counters() */
+	unsigned long frames;		/* Frames processed, for the cost per frame */
+} PROF_STAGE;
+
+typedef struct {
+	int	stage;			/* Index to stage[] */
+	double	start;			/* Monotonic clock at prof_begin() in sec */
+	double	dur;			/* Wall time in sec */
+} PROF_SPAN;
+
+typedef struct {
+	char	*program;		/* argv[0] */
+	char	*file;			/* Input file name */
+	char	channel;		/* Channel ID ('A', 'B', ...) */
+	double	audio_sec;		/* Duration of the processed audio in sec */
+	double	wall0, cpu0;		/* Clocks at prof_init() */
+	double	stage_wall0, stage_cpu0;/* Clocks at the last prof_begin() */
+	unsigned long stage_allocs0;	/* mmalloc allocation count at the last prof_begin() */
+	unsigned long peak_bytes;	/* Largest mmalloc usage of all stages */
+	int	counter_fd[PROF_NUM_COUNTERS];/* perf_event_open() descriptors, -1 if not available */
+	int	num_counters;		/* Number of counters opened */
+	double	stage_count0[PROF_NUM_COUNTERS];/* Counts at the last prof_begin() */
+	int	cur;			/* Index of the running stage, -1 if none */
+	int	num_stages;
+	PROF_STAGE stage[PROF_MAX_STAGES];
+	int	num_spans;		/* Every prof_begin()/prof_end() pair, for -trace */
+	PROF_SPAN span[PROF_MAX_SPANS];
+} PROFILE;
+
+double prof_wall_time(void);
+double prof_cpu_time(void);
+void prof_init(PROFILE *prof, char *program, char *file, char channel);
+void prof_begin(PROFILE *prof, char *stage);
+void prof_end(PROFILE *prof);
+void prof_set_audio(PROFILE *prof, unsigned long num_samples, long sample_rate);
+void prof_add_frames(PROFILE *prof, unsigned long frames);
+int prof_open_counters(PROFILE *prof);
+int prof_write(PROFILE *prof, char *jsonfile);
+int prof_write_trace(PROFILE *prof, char *tracefile);
+
+#endif
@@ -0,0 +1,182 @@
+/* Filename	:profinfo.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :Display percentiles of the per-stage timing and the peak memory
+                 written by the -profile option of sph2phn and sph2phn_2ch (one
+		 JSON line per file)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "veclib.h"
+#include "qsortfunc.h"
+#include "cmdline.h"
+#include "profile.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_ProfileFile="-",	/* JSON lines written by -profile, "-" for stdin */
+     *CL_Percentiles="50,90,99";
+
+CLINEPARA options[]=
+{
+    {"-ProfileFile", "-prof", &CL_ProfileFile},
+    {"-Percentiles", "-pct", &CL_Percentiles}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define MAX_LINE   8192
+#define MAX_PCT    8
+#define TOTAL      "total"
+
+/* Wall time and real-time factor of one stage over all files */
+typedef struct {
+	char	name[PROF_NAME_LEN];
+	int	n, size;
+	vec_t	*wall, *rtf;
+	vec_t	max_peak;		/* Largest peak_bytes */
+} STAGE_STAT;
+
+
+static STAGE_STAT *find_stage(STAGE_STAT *stat, int *num_stats, char *name)
+{
+     int s;
+
+     for (s=0; s<*num_stats; s++)
+	 if (strcmp(stat[s].name, name) == 0)
+	     return &stat[s];
+     if (*num_stats == PROF_MAX_STAGES+1)
+	 return (STAGE_STAT *)NULL;
+     memset(&stat[s], 0, sizeof(STAGE_STAT));
+     strncpy(stat[s].name, name, PROF_NAME_LEN-1);
+     (*num_stats)++;
+     return &stat[s];
+}
+
+static void add_value(STAGE_STAT *st, vec_t wall, vec_t rtf, vec_t peak)
+{
+     if (st == NULL)
+	 return;
+     if (st->n == st->size) {
+	 st->size = (st->size > 0) ? 2*st->size : 256;
+	 st->wall = (vec_t *)realloc(st->wall, st->size*sizeof(vec_t));
+	 st->rtf = (vec_t *)realloc(st->rtf, st->size*sizeof(vec_t));
+     }
+     st->wall[st->n] = wall;
+     st->rtf[st->n] = rtf;
+     st->n++;
+     if (peak > st->max_peak)
+	 st->max_peak = peak;
+}
+
+/* Value of "key":number in str[0..] before end, 0 if absent */
+static vec_t json_number(char *str, char *end, char *key)
+{
+     char pat[PROF_NAME_LEN+4];
+     char *p;
+
+     sprintf(pat, "\"%s\":", key);
+     if ((p=strstr(str, pat)) == NULL || p >= end)
+	 return 0.0;
+     return (vec_t)atof(p+strlen(pat));
+}
+
+/* Nearest-rank percentile of the sorted x[0..n-1] */
+static vec_t percentile(vec_t *x, int n, vec_t pct)
+{
+     int k = (int)ceil(pct/100.0*n) - 1;
+
+     if (k < 0) k = 0;
+     if (k >= n) k = n-1;
+     return x[k];
+}
+
+
+int main(int argc, char *argv[])
+{
+     FILE *fp;
+     char line[MAX_LINE], name[PROF_NAME_LEN], *p, *q, *end;
+     STAGE_STAT stat[PROF_MAX_STAGES+1];
+     int num_stats = 0, num_files = 0, num_pct, i, s;
+     vec_t pct[MAX_PCT], mean;
+
+     if (argc>1)
+	 get_cmdline(argc, argv, num_options, options);
+     for (num_pct=1, p=CL_Percentiles; *p; p++)
+	 if (*p == ',')
+	     num_pct++;
+     if (num_pct > MAX_PCT)
+	 num_pct = MAX_PCT;
+     for (i=0; i<num_pct; i++)
+	 pct[i] = string_to_float(CL_Percentiles, i+1);
+
+     if (strcmp(CL_ProfileFile, "-") == 0)
+	 fp = stdin;
+     else if ((fp=fopen(CL_ProfileFile, "r")) == NULL) {
+	 fprintf(stderr,"Error in opening %s\n",CL_ProfileFile);
+	 exit(EXIT_FAILURE);
+     }
+
+     /* Collect the total and the per-stage timing of every line */
+     find_stage(stat, &num_stats, TOTAL);
+     while (fgets(line, MAX_LINE, fp) != NULL) {
+	 if ((p=strstr(line, "\"stages\":{")) == NULL)
+	     continue;
+	 add_value(&stat[0], json_number(line, p, "wall"), json_number(line, p, "rtf"),
+		   json_number(line, p, "peak_bytes"));
+	 num_files++;
+	 p += strlen("\"stages\":{");
+	 while ((q=strchr(p, '"')) != NULL) {
+	     q++;
+	     if ((end=strchr(q, '"')) == NULL || end-q >= PROF_NAME_LEN)
+		 break;
+	     memcpy(name, q, end-q);
+	     name[end-q] = '\0';
+	     if ((end=strchr(end, '}')) == NULL)
+		 break;
+	     add_value(find_stage(stat, &num_stats, name),
+		       json_number(q, end, "wall"), json_number(q, end, "rtf"),
+		       json_number(q, end, "peak_bytes"));
+	     p = end+1;
+	 }
+     }
+     if (fp != stdin)
+	 fclose(fp);
+     if (num_files == 0) {
+	 fprintf(stderr,"No profile found in %s\n",CL_ProfileFile);
+	 exit(EXIT_FAILURE);
+     }
+
+     /* Print mean, percentiles and max of each stage, and its largest memory peak */
+     printf("%d files\n", num_files);
+     printf("%-16s %6s %10s", "stage", "n", "mean(ms)");
+     for (i=0; i<num_pct; i++)
+	 printf("   p%-2g(ms)", pct[i]);
+     printf("  max(ms) %10s", "mean_rtf");
+     for (i=0; i<num_pct; i++)
+	 printf("  p%-2g_rtf", pct[i]);
+     printf("  peak(MB)\n");
+     for (s=0; s<num_stats; s++) {
+	 STAGE_STAT *st = &stat[(s+1)%num_stats];    /* total comes last */
+
+	 qsort(st->wall, st->n, sizeof(vec_t), (int (*)(const void *, const void *))qsortcomparef);
+	 qsort(st->rtf, st->n, sizeof(vec_t), (int (*)(const void *, const void *))qsortcomparef);
+	 for (mean=0.0, i=0; i<st->n; i++)
+	     mean += st->wall[i];
+	 printf("%-16s %6d %10.3f", st->name, st->n, 1000.0*mean/st->n);
+	 for (i=0; i<num_pct; i++)
+	     printf(" %10.3f", 1000.0*percentile(st->wall, st->n, pct[i]));
+	 printf(" %8.3f", 1000.0*st->wall[st->n-1]);
+	 for (mean=0.0, i=0; i<st->n; i++)
+	     mean += st->rtf[i];
+	 printf(" %10.5f", mean/st->n);
+	 for (i=0; i<num_pct; i++)
+	     printf(" %9.5f", percentile(st->rtf, st->n, pct[i]));
+	 printf(" %9.1f\n", st->max_peak/1048576.0);
+     }
+     return(0);
+}
@@ -1,5 +1,6 @@
 /*
   Function for the qsort() routine in stdlib
+  Modified(Oct 26): heap_sort() added, as qsort() without memory allocation
 */
 
 #include "qsortfunc.h"
@@ -13,3 +14,50 @@ int   qsortcomparef(const vec_t *x, const vec_t *y)
       else
            return 1;
 }
+
+
+static void swap_elems(char *p, char *q, size_t size)
+{
+      char t;
+
+      while (size-- > 0) {
+           t = *p; *p++ = *q; *q++ = t;
+      }
+}
+
+
+/* Move base[k] down the max-heap base[0..n-1] */
+static void sift_down(char *a, size_t k, size_t n, size_t size,
+                      int (*compar)(const void *, const void *))
+{
+      size_t c;
+
+      for (; (c=2*k+1) < n; k=c) {
+           if (c+1 < n && compar(a+c*size, a+(c+1)*size) < 0)
+                c++;
+           if (compar(a+k*size, a+c*size) >= 0)
+                break;
+           swap_elems(a+k*size, a+c*size, size);
+      }
+}
+
+
+/*
+  Sort base[0..n-1] in place as qsort() does. glibc's qsort() mallocs a copy of
+  arrays of more than 1 KB, which the callers of SSVAD with a memory arena avoid.
+  Not stable: elements that compare equal may come out in any order
+*/
+void  heap_sort(void *base, size_t n, size_t size, int (*compar)(const void *, const void *))
+{
+      char *a = (char *)base;
+      size_t i;
+
+      if (n < 2)
+           return;
+      for (i=n/2; i>0; i--)
+           sift_down(a, i-1, n, size, compar);
+      for (i=n-1; i>0; i--) {
+           swap_elems(a, a+i*size, size);
+           sift_down(a, 0, i, size, compar);
+      }
+}
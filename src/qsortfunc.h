@@ -1,3 +1,5 @@
+#include <stddef.h>
 #include "veclib.h"
 
 int   qsortcomparef(const vec_t *x, const vec_t *y);
+void  heap_sort(void *base, size_t n, size_t size, int (*compar)(const void *, const void *));
@@ -0,0 +1,169 @@
+/*
+   Filename	:refimpl.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Reference build of the signal processing modules, for vadverify.
+                 window.c, findnoise.c, denoise.c, silence.c, rm_crosstalk.c and
+		 veclib.c are compiled a second time into *_ref.o with
+		 -DREFERENCE_IMPL -include refimpl.h, which renames their global
+		 functions with the prefix ref_. vadverify links both builds and
+		 runs them on the same input.
+
+		 An optimised code path in these modules must keep the plain C
+		 code it replaces, and use it when REFERENCE_IMPL is defined:
+
+		 #ifdef REFERENCE_IMPL
+		     ... original loop ...
+		 #else
+		     ... optimised loop ...
+		 #endif
+
+		 Without REFERENCE_IMPL, this header declares the ref_ functions
+		 called by vadverify.
+*/
+
+#ifndef __REFIMPL_INCLUDE__
+#define __REFIMPL_INCLUDE__
+
+#ifdef REFERENCE_IMPL
+
+/* window.c */
+#define windowing                   ref_windowing
+#define dewindowing                 ref_dewindowing
+#define hamming                     ref_hamming
+
+/* findnoise.c */
+#define findnoise                   ref_findnoise
+#define findnoise_ex                ref_findnoise_ex
+#define findnoise_from_file_start   ref_findnoise_from_file_start
+
+/* denoise.c */
+#define denoise                     ref_denoise
+#define denoise_ex                  ref_denoise_ex
+#define denoise_sel                 ref_denoise_sel
+#define estimate_snr                ref_estimate_snr
+
+/* silence.c */
+#define zero_crossing               ref_zero_crossing
+#define average_magnitude           ref_average_magnitude
+#define remove_offset               ref_remove_offset
+#define FIR_filtering               ref_FIR_filtering
+#define moving_average              ref_moving_average
+#define detect_silence              ref_detect_silence
+#define detect_silence_ex           ref_detect_silence_ex
+#define detect_silence_sel          ref_detect_silence_sel
+#define ambiguous_frames            ref_ambiguous_frames
+#define free_ambiguous_frames       ref_free_ambiguous_frames
+#define median                      ref_median
+#define signal_summary              ref_signal_summary
+#define sgn                         ref_sgn
+
+/* rm_crosstalk.c */
+#define remove_crosstalk_SRE10      ref_remove_crosstalk_SRE10
+#define remove_crosstalk_SRE12      ref_remove_crosstalk_SRE12
+#define remove_crosstalk_SRE10_ex   ref_remove_crosstalk_SRE10_ex
+#define remove_crosstalk_SRE12_ex   ref_remove_crosstalk_SRE12_ex
+
+/* veclib.c */
+#define VECL2normf                  ref_VECL2normf
+#define VECL2norms                  ref_VECL2norms
+#define VECaddalphab                ref_VECaddalphab
+#define VECaddalphaf                ref_VECaddalphaf
+#define VECaddalphafHuge            ref_VECaddalphafHuge
+#define VECaddf                     ref_VECaddf
+#define VECaddfHuge                 ref_VECaddfHuge
+#define VECamaxShortHuge            ref_VECamaxShortHuge
+#define VECamaxf                    ref_VECamaxf
+#define VECamaxfHuge                ref_VECamaxfHuge
+#define VECamaxiHuge                ref_VECamaxiHuge
+#define VECamaxposf                 ref_VECamaxposf
+#define VECasubb                    ref_VECasubb
+#define VECasumf                    ref_VECasumf
+#define VECasums                    ref_VECasums
+#define VECcopyb                    ref_VECcopyb
+#define VECcopyf                    ref_VECcopyf
+#define VECcopyfHuge                ref_VECcopyfHuge
+#define VECdotf                     ref_VECdotf
+#define VECdotfHuge                 ref_VECdotfHuge
+#define VECedistf                   ref_VECedistf
+#define VECfillb                    ref_VECfillb
+#define VECfillf                    ref_VECfillf
+#define VECfillfHuge                ref_VECfillfHuge
+#define VECfilli                    ref_VECfilli
+#define VECmataddf                  ref_VECmataddf
+#define VECmatmultf                 ref_VECmatmultf
+#define VECmatsubf                  ref_VECmatsubf
+#define VECmattracef                ref_VECmattracef
+#define VECmaxb                     ref_VECmaxb
+#define VECmaxf                     ref_VECmaxf
+#define VECmaxfHuge                 ref_VECmaxfHuge
+#define VECmaxi                     ref_VECmaxi
+#define VECmaxposf                  ref_VECmaxposf
+#define VECmeanf                    ref_VECmeanf
+#define VECmetricf                  ref_VECmetricf
+#define VECmetricfHuge              ref_VECmetricfHuge
+#define VECminb                     ref_VECminb
+#define VECminf                     ref_VECminf
+#define VECminfHuge                 ref_VECminfHuge
+#define VECmini                     ref_VECmini
+#define VECminposf                  ref_VECminposf
+#define VECmtransposef              ref_VECmtransposef
+#define VECmtransposefHuge          ref_VECmtransposefHuge
+#define VECmuladdf                  ref_VECmuladdf
+#define VECmuladdfHuge              ref_VECmuladdfHuge
+#define VECmulalphab                ref_VECmulalphab
+#define VECmulalphaf                ref_VECmulalphaf
+#define VECmulalphafHuge            ref_VECmulalphafHuge
+#define VECmvmulf                   ref_VECmvmulf
+#define VECmvmulfHuge               ref_VECmvmulfHuge
+#define VECnzposs                   ref_VECnzposs
+#define VECpermutef                 ref_VECpermutef
+#define VECpostmultn                ref_VECpostmultn
+#define VECpostmultnHuge            ref_VECpostmultnHuge
+#define VECprintmatrixfHuge         ref_VECprintmatrixfHuge
+#define VECprintvectorfHuge         ref_VECprintvectorfHuge
+#define VECsgnchgs                  ref_VECsgnchgs
+#define VECskewf                    ref_VECskewf
+#define VECsoftmaxf                 ref_VECsoftmaxf
+#define VECsqedistf                 ref_VECsqedistf
+#define VECsqmdistf                 ref_VECsqmdistf
+#define VECstatf                    ref_VECstatf
+#define VECstddevf                  ref_VECstddevf
+#define VECsubf                     ref_VECsubf
+#define VECsubfHuge                 ref_VECsubfHuge
+#define VECsumf                     ref_VECsumf
+#define VECsummarys                 ref_VECsummarys
+#define VECswapf                    ref_VECswapf
+#define VECznorm                    ref_VECznorm
+
+#else
+
+#include "veclib.h"
+#include "segment.h"
+#include "silence.h"
+
+void ref_windowing(short *iparray, vec_t *oparray, int win_size,
+		   int win_type, int nor_factor, vec_t prem_factor);
+vec_t *ref_findnoise(const short *inpwave, unsigned long num_smps,
+		     const unsigned long frameSize, const vec_t bkg_frac);
+vec_t *ref_findnoise_ex(const short *inpwave, unsigned long num_smps,
+			const unsigned long frameSize, const vec_t bkg_frac,
+			const int skip_zero_frms);
+short *ref_denoise_ex(const short *nspeech, const unsigned long num_smps, const unsigned long frameSize,
+		      const unsigned long frameAdv, unsigned long *nOutSmps, const double *noise,
+		      const double alphaMax, const double alphaMin,
+		      const double betaMax, const double betaMin, const SIGNAL_SUMMARY *sum);
+void ref_signal_summary(short *x, unsigned long num_samples, SIGNAL_SUMMARY *sum);
+vec_t ref_zero_crossing(short *x, unsigned long n);
+vec_t ref_average_magnitude(short *x, unsigned long n);
+void ref_remove_offset(short *x, unsigned long num_samples);
+SEGMENT *ref_detect_silence_ex(short *x, unsigned long num_samples, int sample_rate,
+			       vec_t zcr_factor, vec_t avm_factor, vec_t noise_energy, int verbose,
+			       const SIGNAL_SUMMARY *sum);
+SEGMENT *ref_remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel);
+vec_t ref_VECL2normf(int length, vec_t *vec);
+
+#endif
+
+#endif
@@ -39,6 +39,7 @@
 #include "mmalloc.h"
 #include "segment.h"
 #include "veclib.h"
+#include "probes.h"
 
 #define WIN_SIZE 200       // Min frame size (assume 8kHz)
 #define WIN_ADV 80         // Min frame shift
@@ -46,7 +47,8 @@
 /* 
    Remove crosstalk in nist10 files: Only ChB will crosstalk to ChA, not the other way round
 */
-SEGMENT *remove_crosstalk_SRE10(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel)
+SEGMENT *remove_crosstalk_SRE10_ex(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel,
+				  int verbose)
 {
     unsigned long i,j,t,tot_num_segs,num_sph_segs,num_sph_samples,num_sph_frms;
     char *phoneme;
@@ -107,14 +109,14 @@ SEGMENT *remove_crosstalk_SRE10(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
 	seg3[j].begin = t;
 	if (label3[t] == 0) {
 	    strcpy(seg3[j].phoneme,"h#");            // Crosstalk or silence
-	    while (label3[t] == 0) {                 // Search for next segment
+	    while (t<num_samples && label3[t] == 0) { // Search for next segment
 		t++;
 	    }
 	    seg3[j].end = t;
 	    seg3[j].num_samples = t-seg3[j].begin+1;
 	} else {
 	    strcpy(seg3[j].phoneme,"S");             // Speech segment
-	    while (label3[t] == 1) {                 // Search for next segment
+	    while (t<num_samples && label3[t] == 1) { // Search for next segment
 		t++;
 	    }
 	    seg3[j].end = t;
@@ -138,7 +140,8 @@ SEGMENT *remove_crosstalk_SRE10(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
 	    num_sph_segs++;
     }
     if (num_sph_segs == 0 || num_sph_frms == 0 || num_sph_samples == 0) {
-	printf("No speech segment, artificially assign one to help sph2cep.c\n");
+	if (verbose)
+	    printf("No speech segment, artificially assign one to help sph2cep.c\n");
 	seg3[0].num_segs = 2;
 	seg3[0].begin = 0;
 	seg3[0].end = 512;
@@ -148,19 +151,26 @@ SEGMENT *remove_crosstalk_SRE10(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
 	seg3[1].end = seg1[tot_num_segs-1].end;
 	strcpy(seg3[1].phoneme,"h#");
     }
+    SSVAD_PROBE2(crosstalk__segments, num_samples, seg3[0].num_segs);
 
     free_vector((char *)label1,0,sizeof(int));
     free_vector((char *)label2,0,sizeof(int));
     free_vector((char *)label3,0,sizeof(int));
     return seg3;
 }
+
+SEGMENT *remove_crosstalk_SRE10(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel)
+{
+    return remove_crosstalk_SRE10_ex(seg1,seg2,num_samples,channel,1);
+}
   
 
 
 /* 
    Remove crosstalks in nist12 files
 */
-SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel)
+SEGMENT *remove_crosstalk_SRE12_ex(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel,
+				  int verbose)
 {
     unsigned long i,j,t,tot_num_segs,num_sph_segs,num_sph_samples,num_sph_frms;
     char *phoneme;
@@ -228,14 +238,14 @@ SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
 	seg3[j].begin = t;
 	if (label3[t] == 0) {
 	    strcpy(seg3[j].phoneme,"h#");            // Crosstalk or silence
-	    while (label3[t] == 0) {                 // Search for next segment
+	    while (t<num_samples && label3[t] == 0) { // Search for next segment
 		t++;
 	    }
 	    seg3[j].end = t;
 	    seg3[j].num_samples = t-seg3[j].begin+1;
 	} else {
 	    strcpy(seg3[j].phoneme,"S");             // Speech segment
-	    while (label3[t] == 1) {                 // Search for next segment
+	    while (t<num_samples && label3[t] == 1) { // Search for next segment
 		t++;
 	    }
 	    seg3[j].end = t;
@@ -259,7 +269,8 @@ SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
 	    num_sph_segs++;
     }
     if (num_sph_segs == 0 || num_sph_frms == 0 || num_sph_samples == 0) {
-	printf("No speech segment, artificially assign one to help sph2cep.c\n");
+	if (verbose)
+	    printf("No speech segment, artificially assign one to help sph2cep.c\n");
 	seg3[0].num_segs = 2;
 	seg3[0].begin = 0;
 	seg3[0].end = 512;
@@ -269,6 +280,7 @@ SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
 	seg3[1].end = seg1[tot_num_segs-1].end;
 	strcpy(seg3[1].phoneme,"h#");
     }
+    SSVAD_PROBE2(crosstalk__segments, num_samples, seg3[0].num_segs);
 
     free_vector((char *)label1,0,sizeof(int));
     free_vector((char *)label2,0,sizeof(int));
@@ -277,6 +289,11 @@ SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_
     free_vector((char *)amp2,0,sizeof(vec_t));
     return seg3;
 }
+
+SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel)
+{
+    return remove_crosstalk_SRE12_ex(seg1,seg2,num_samples,channel,1);
+}
  
 
 
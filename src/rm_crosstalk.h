@@ -13,4 +13,10 @@
 SEGMENT *remove_crosstalk_SRE10(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel);
 SEGMENT *remove_crosstalk_SRE12(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel);
 
+/* As above; verbose=0 suppresses the "No speech segment" message */
+SEGMENT *remove_crosstalk_SRE10_ex(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel,
+				   int verbose);
+SEGMENT *remove_crosstalk_SRE12_ex(SEGMENT *seg1, SEGMENT *seg2, unsigned long num_samples, char channel,
+				   int verbose);
+
 #endif
@@ -0,0 +1,358 @@
+/* Filename	:rtfbench.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :End-to-end benchmark of sph2phn and sph2phn_2ch. The programs
+                 are run on the files in examples/, and their .phn files are
+		 compared with the ones in examples/. They are then run on
+		 concatenations of eslnc.sph lasting -dur minutes, to show how
+		 the cost scales with the file duration. For each run, the wall
+		 and CPU time, the real-time factor (RTF), the samples per second
+		 and the peak RSS are printed. The last line is the overall RTF
+		 (total wall time over total audio), the number to track from
+		 one change to the next. The exit status is 1 if a .phn file
+		 does not match.
+
+   Example      :rtfbench -bin ../bin -ex ../examples -dur 1,10,60,180 -json rtf.json
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "cmdline.h"
+#include "profile.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_BinDir="../bin",		/* Directory of sph2phn and sph2phn_2ch */
+     *CL_ExampleDir="../examples",	/* Directory of the example .sph and .phn files */
+     *CL_TmpDir="/tmp",			/* Directory for the concatenated files and the outputs */
+     *CL_Durations="1,10,60,180",	/* Durations of the concatenated files in minutes */
+     *CL_JsonFile=(char *)NULL;		/* Append the results to this file as JSON lines */
+
+CLINEPARA options[]=
+{
+    {"-BinDir", "-bin", &CL_BinDir},
+    {"-ExampleDir", "-ex", &CL_ExampleDir},
+    {"-TmpDir", "-tmp", &CL_TmpDir},
+    {"-Durations", "-dur", &CL_Durations},
+    {"-JsonFile", "-json", &CL_JsonFile}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define MAX_PATH 1024
+#define MAX_DUR  16
+#define LONG_SOURCE "eslnc.sph"		/* Uncompressed, so that it can be concatenated */
+
+/* The example files, with the options used to make their .phn files */
+typedef struct {
+	char	*program;
+	char	*sphfile;
+	char	channel;
+	char	*phnfile;		/* Reference in examples/ */
+} EXAMPLE;
+
+static EXAMPLE example[] = {
+     {"sph2phn", "eslnc.sph", 'A', "eslnc_A.phn"},
+     {"sph2phn_2ch", "idcfvk_sre12.sph", 'A', "idcfvk_sre12_A.phn"},
+     {"sph2phn_2ch", "idcfvk_sre12.sph", 'B', "idcfvk_sre12_B.phn"}
+};
+
+static int num_examples = sizeof(example)/sizeof(EXAMPLE);
+
+/* Result of one run */
+typedef struct {
+	double	audio;			/* Duration in sec */
+	double	wall, cpu;		/* Wall time and user+system time of the child in sec */
+	long	maxrss;			/* Peak RSS in kbytes */
+	int	status;			/* Exit status of the child */
+} RUN;
+
+static double tot_wall = 0.0, tot_audio = 0.0;
+static FILE *json = NULL;
+
+
+/* Read sample_count, sample_rate and the header size of a SPHERE file */
+static int sph_info(char *file, unsigned long *count, long *rate, long *hdr_size)
+{
+     FILE *fp;
+     char line[MAX_PATH];
+
+     if ((fp=fopen(file, "r")) == NULL)
+	 return -1;
+     *count = 0;
+     *rate = 0;
+     *hdr_size = 0;
+     if (fgets(line, MAX_PATH, fp) != NULL && strncmp(line, "NIST_1A", 7) == 0 &&
+	 fgets(line, MAX_PATH, fp) != NULL)
+	 *hdr_size = atol(line);
+     while (fgets(line, MAX_PATH, fp) != NULL && strncmp(line, "end_head", 8) != 0) {
+	 if (strncmp(line, "sample_count -i ", 16) == 0)
+	     *count = strtoul(line+16, NULL, 10);
+	 else if (strncmp(line, "sample_rate -i ", 15) == 0)
+	     *rate = atol(line+15);
+     }
+     fclose(fp);
+     return (*hdr_size > 0 && *rate > 0) ? 0 : -1;
+}
+
+
+/* Write outfile with the first num_samples of the samples of infile repeated;
+   the header of infile is kept except the sample count and checksum */
+static int concat_sph(char *infile, char *outfile, unsigned long num_samples)
+{
+     FILE *fin, *fout;
+     char line[MAX_PATH], *hdr, *data;
+     unsigned long count, n, smp_bytes = 0, chan = 0;
+     long rate, hdr_size, len = 0, data_size;
+
+     if (sph_info(infile, &count, &rate, &hdr_size) < 0 || (fin=fopen(infile, "r")) == NULL)
+	 return -1;
+     hdr = (char *)malloc(hdr_size+1);
+     for (n=0; fgets(line, MAX_PATH, fin) != NULL; n++) {
+	 if (strncmp(line, "sample_n_bytes -i ", 18) == 0)
+	     smp_bytes = atol(line+18);
+	 else if (strncmp(line, "channel_count -i ", 17) == 0)
+	     chan = atol(line+17);
+	 else if (strncmp(line, "sample_coding ", 14) == 0 && strstr(line, "shorten") != NULL) {
+	     fprintf(stderr,"%s is compressed and cannot be concatenated\n",infile);
+	     fclose(fin);
+	     free(hdr);
+	     return -1;
+	 }
+	 if (strncmp(line, "sample_checksum ", 16) == 0)
+	     continue;
+	 if (strncmp(line, "sample_count ", 13) == 0)
+	     sprintf(line, "sample_count -i %lu\n", num_samples);
+	 if (len+(long)strlen(line) > hdr_size)
+	     break;
+	 strcpy(hdr+len, line);
+	 len += strlen(line);
+	 if (strncmp(line, "end_head", 8) == 0)
+	     break;
+     }
+     memset(hdr+len, ' ', hdr_size-len);
+     data_size = (long)(count*smp_bytes*chan);
+     data = (char *)malloc(data_size);
+     fseek(fin, hdr_size, SEEK_SET);
+     if (data_size == 0 || fread(data, 1, data_size, fin) != (size_t)data_size ||
+	 (fout=fopen(outfile, "w")) == NULL) {
+	 fclose(fin);
+	 free(hdr);
+	 free(data);
+	 return -1;
+     }
+     fclose(fin);
+     fwrite(hdr, 1, hdr_size, fout);
+     for (n=0; n<num_samples; n+=count)
+	 fwrite(data, smp_bytes*chan, (num_samples-n < count) ? num_samples-n : count, fout);
+     fclose(fout);
+     free(hdr);
+     free(data);
+     return 0;
+}
+
+
+/* Run program on sphfile, with its output in phnfile */
+static void run_vad(char *program, char *sphfile, char channel, char *phnfile, RUN *run)
+{
+     char path[MAX_PATH], ch[2];
+     unsigned long count;
+     long rate, hdr_size;
+     struct rusage ru;
+     double t0;
+     pid_t pid;
+     int fd;
+
+     memset(run, 0, sizeof(RUN));
+     if (sph_info(sphfile, &count, &rate, &hdr_size) == 0)
+	 run->audio = (double)count/rate;
+     sprintf(path, "%s/%s", CL_BinDir, program);
+     ch[0] = channel;
+     ch[1] = '\0';
+
+     t0 = prof_wall_time();
+     if ((pid=fork()) == 0) {
+	 fd = open("/dev/null", O_WRONLY);
+	 dup2(fd, STDOUT_FILENO);
+	 execl(path, program, "-sph", sphfile, "-phn", phnfile, "-ch", ch, "-dn", "Y",
+	       "-af", "0.95", (char *)NULL);
+	 fprintf(stderr,"Unable to run %s\n",path);
+	 _exit(127);
+     }
+     if (pid < 0 || wait4(pid, &run->status, 0, &ru) < 0) {
+	 run->status = -1;
+	 return;
+     }
+     run->wall = prof_wall_time() - t0;
+     run->cpu = ru.ru_utime.tv_sec + 1e-6*ru.ru_utime.tv_usec + ru.ru_stime.tv_sec + 1e-6*ru.ru_stime.tv_usec;
+     run->maxrss = ru.ru_maxrss;
+}
+
+
+/* Compare two .phn files. Return 0 if they match, otherwise the first line that differs.
+   The end of the last segment is not compared: remove_crosstalk_SRE12() takes it from
+   past the end of its label array, so it changes with the memory layout of the build */
+static int compare_phn(char *file1, char *file2)
+{
+     FILE *fp1, *fp2;
+     char line1[MAX_PATH], line2[MAX_PATH], next1[MAX_PATH], next2[MAX_PATH];
+     char *r1, *r2;
+     long b1, e1, b2, e2;
+     int n = 0, ret = 0;
+
+     if ((fp1=fopen(file1, "r")) == NULL || (fp2=fopen(file2, "r")) == NULL) {
+	 if (fp1 != NULL)
+	     fclose(fp1);
+	 return -1;
+     }
+     r1 = fgets(line1, MAX_PATH, fp1);
+     r2 = fgets(line2, MAX_PATH, fp2);
+     while (r1 != NULL && r2 != NULL) {
+	 n++;
+	 r1 = fgets(next1, MAX_PATH, fp1);
+	 r2 = fgets(next2, MAX_PATH, fp2);
+	 if (strcmp(line1, line2) != 0) {
+	     if (r1 != NULL || r2 != NULL || sscanf(line1, "%ld %ld", &b1, &e1) != 2 ||
+		 sscanf(line2, "%ld %ld", &b2, &e2) != 2 || b1 != b2 ||
+		 strcmp(strrchr(line1, ' '), strrchr(line2, ' ')) != 0) {
+		 ret = n;
+		 break;
+	     }
+	 }
+	 strcpy(line1, next1);
+	 strcpy(line2, next2);
+     }
+     if (ret == 0 && (r1 != NULL || r2 != NULL))
+	 ret = n+1;
+     fclose(fp1);
+     fclose(fp2);
+     return ret;
+}
+
+
+static void print_run(char *program, char *input, char channel, RUN *run, char *check)
+{
+     double samples = 0.0;
+     unsigned long count;
+     long rate, hdr_size;
+
+     if (sph_info(input, &count, &rate, &hdr_size) == 0 && run->wall > 0.0)
+	 samples = (double)count/run->wall;
+     if (run->status != 0) {
+	 printf("%-12s %-24s %c  failed with status %d\n", program, strrchr(input, '/')+1,
+		channel, run->status);
+	 return;
+     }
+     printf("%-12s %-24s %c %9.1f %9.2f %9.2f %9.5f %11.3g %9.1f  %s\n", program,
+	    strrchr(input, '/')+1, channel, run->audio, run->wall, run->cpu,
+	    run->wall/run->audio, samples, run->maxrss/1024.0, check);
+     fflush(stdout);
+     tot_wall += run->wall;
+     tot_audio += run->audio;
+     if (json != NULL)
+	 fprintf(json, "{\"program\":\"%s\",\"file\":\"%s\",\"channel\":\"%c\",\"audio_sec\":%.3f,"
+		 "\"wall\":%.3f,\"cpu\":%.3f,\"rtf\":%.6g,\"samples_per_sec\":%.6g,\"maxrss_kb\":%ld,"
+		 "\"check\":\"%s\"}\n", program, strrchr(input, '/')+1, channel, run->audio,
+		 run->wall, run->cpu, run->wall/run->audio, samples, run->maxrss, check);
+}
+
+
+int main(int argc, char *argv[])
+{
+     char sphfile[MAX_PATH], phnfile[MAX_PATH], reffile[MAX_PATH], longfile[MAX_PATH], check[64];
+     char *program[2] = {"sph2phn", "sph2phn_2ch"};
+     RUN run, first[2], last[2];
+     double dur[MAX_DUR];
+     unsigned long count;
+     long rate, hdr_size;
+     int num_dur, num_fail = 0, i, p, line;
+
+     if (argc>1)
+	 get_cmdline(argc, argv, num_options, options);
+     for (num_dur=1, i=0; CL_Durations[i]; i++)
+	 if (CL_Durations[i] == ',')
+	     num_dur++;
+     if (CL_Durations[0] == '\0')
+	 num_dur = 0;
+     if (num_dur > MAX_DUR)
+	 num_dur = MAX_DUR;
+     for (i=0; i<num_dur; i++)
+	 dur[i] = string_to_float(CL_Durations, i+1);
+     if (CL_JsonFile != NULL && (json=fopen(CL_JsonFile, "a")) == NULL) {
+	 fprintf(stderr,"Unable to open %s for write\n",CL_JsonFile);
+	 exit(EXIT_FAILURE);
+     }
+
+     printf("%-12s %-24s %s %9s %9s %9s %9s %11s %9s  %s\n", "program", "file", "ch", "audio(s)",
+	    "wall(s)", "cpu(s)", "RTF", "samples/s", "RSS(MB)", "check");
+
+     /* Example files, checked against their .phn files */
+     for (i=0; i<num_examples; i++) {
+	 sprintf(sphfile, "%s/%s", CL_ExampleDir, example[i].sphfile);
+	 sprintf(reffile, "%s/%s", CL_ExampleDir, example[i].phnfile);
+	 sprintf(phnfile, "%s/rtfbench_%d_%s", CL_TmpDir, (int)getpid(), example[i].phnfile);
+	 run_vad(example[i].program, sphfile, example[i].channel, phnfile, &run);
+	 if ((line=compare_phn(phnfile, reffile)) == 0)
+	     strcpy(check, "phn ok");
+	 else {
+	     if (line < 0)
+		 strcpy(check, "phn missing");
+	     else
+		 sprintf(check, "phn differs at line %d", line);
+	     num_fail++;
+	 }
+	 print_run(example[i].program, sphfile, example[i].channel, &run, check);
+	 unlink(phnfile);
+     }
+
+     /* Concatenations of LONG_SOURCE, for the scaling with the duration */
+     sprintf(sphfile, "%s/%s", CL_ExampleDir, LONG_SOURCE);
+     if (num_dur > 0 && sph_info(sphfile, &count, &rate, &hdr_size) < 0) {
+	 fprintf(stderr,"Unable to read %s\n",sphfile);
+	 num_dur = 0;
+     }
+     for (i=0; i<num_dur; i++) {
+	 sprintf(longfile, "%s/rtfbench_%d_%gmin.sph", CL_TmpDir, (int)getpid(), dur[i]);
+	 sprintf(phnfile, "%s/rtfbench_%d.phn", CL_TmpDir, (int)getpid());
+	 if (concat_sph(sphfile, longfile, (unsigned long)(dur[i]*60.0*rate)) < 0) {
+	     fprintf(stderr,"Unable to write %s\n",longfile);
+	     break;
+	 }
+	 for (p=0; p<2; p++) {
+	     run_vad(program[p], longfile, 'A', phnfile, &run);
+	     print_run(program[p], longfile, 'A', &run, "");
+	     if (i == 0)
+		 first[p] = run;
+	     last[p] = run;
+	 }
+	 unlink(longfile);
+	 unlink(phnfile);
+     }
+
+     /* Growth of the wall time with the duration: 1 for linear, 2 for quadratic */
+     if (num_dur > 1 && dur[num_dur-1] != dur[0])
+	 for (p=0; p<2; p++)
+	     if (first[p].wall > 0.0 && last[p].wall > 0.0)
+		 printf("%s: wall time grows as duration^%.2f from %g to %g min\n", program[p],
+			log(last[p].wall/first[p].wall)/log(last[p].audio/first[p].audio),
+			dur[0], dur[num_dur-1]);
+
+     printf("Overall RTF: %.5f (%.1f sec of audio in %.1f sec)%s\n",
+	    (tot_audio > 0.0) ? tot_wall/tot_audio : 0.0, tot_audio, tot_wall,
+	    (num_fail > 0) ? ", .phn mismatch" : "");
+     if (json != NULL) {
+	 fprintf(json, "{\"overall_rtf\":%.6g,\"audio_sec\":%.3f,\"wall\":%.3f,\"phn_mismatch\":%d}\n",
+		 (tot_audio > 0.0) ? tot_wall/tot_audio : 0.0, tot_audio, tot_wall, num_fail);
+	 fclose(json);
+     }
+     return (num_fail > 0) ? 1 : 0;
+}
@@ -29,23 +29,24 @@ SEGMENT *PhnFileRead(char *PhnFileName)
      SEGMENT 	*seg;
      int	num_segs;		/* Number of segment in .phn file */
      int	i;
-     char	buf[10];
+     char	buf[30];
      int	dummy;
 
      if ((phnfile=fopen(PhnFileName,"r"))==NULL) {
 	 fprintf(stderr,"Error in opening %s\n",PhnFileName);
-         exit(EXIT_FAILURE);
+	 return((SEGMENT *)NULL);
      }
 
      /* Parse .phn file and determine the number of segment */
      num_segs = 0;
-     while (fscanf(phnfile,"%d %d %s\n",&dummy,&dummy,buf)!=EOF)
+     while (fscanf(phnfile,"%d %d %29s\n",&dummy,&dummy,buf)!=EOF)
 	 num_segs++;
      rewind(phnfile);
 
      /* Check whether there is any segments */
      if (num_segs<1) {
          fprintf(stderr,"Warning: No segment is defined in %s\n",PhnFileName);
+	 fclose(phnfile);
 	 return((SEGMENT *)NULL);
      }
 
@@ -59,9 +60,11 @@ SEGMENT *PhnFileRead(char *PhnFileName)
 
      /* Read the .phn file again to get segment information */
      for (i=0; i<num_segs; i++){
-	 if (fscanf(phnfile,"%d %d %s\n", &seg[i].begin, &seg[i].end, 
+	 if (fscanf(phnfile,"%d %d %29s\n", &seg[i].begin, &seg[i].end, 
 		    seg[i].phoneme)!=3){
 	     fprintf(stderr,"Warning: incorrect .phn file format, no segment is defined");
+	     free_vector((char *)seg,0,sizeof(SEGMENT));
+	     fclose(phnfile);
 	     return((SEGMENT *)NULL);	
 	 }
 	 /* Last samples specified in the .phn file are regarded as the begining
@@ -71,6 +74,7 @@ SEGMENT *PhnFileRead(char *PhnFileName)
 	 seg[i].num_samples = seg[i].end-seg[i].begin+1;
 	 seg[i].num_segs = num_segs;
      }
+     fclose(phnfile);
      return(seg);
 }
 
@@ -79,9 +83,10 @@ SEGMENT *PhnFileRead(char *PhnFileName)
   PhnFileWrite:write the .phn file 
   Input: (char *)PhnFileName: .phn file to be written
          (SEGMENT *)segment: array of SEGMENT structure
+  Output: return 0 on success, -1 if the file cannot be written
 */
 
-void PhnFileWrite(char *phnfilename, SEGMENT *seg)
+int PhnFileWrite(char *phnfilename, SEGMENT *seg)
 {
      int s;
      int num_segs;
@@ -89,13 +94,35 @@ void PhnFileWrite(char *phnfilename, SEGMENT *seg)
      
      if ((phnfile=fopen(phnfilename,"w"))==NULL) {
 	 fprintf(stderr,"Unable to open %s for write\n",phnfilename);
-	 exit(EXIT_FAILURE);
+	 return(-1);
      }
 
      num_segs = seg[0].num_segs;
      for (s=0; s<num_segs; s++)
          fprintf(phnfile,"%d %d %s\n",seg[s].begin,seg[s].end,seg[s].phoneme);
-     fclose(phnfile);
+     if (fclose(phnfile)!=0) {
+	 fprintf(stderr,"Error in writing %s\n",phnfilename);
+	 return(-1);
+     }
+     return(0);
+}
+
+
+/*
+  shift_segments: add offset to the begin and end of all segments, e.g. to
+                  convert the positions within a time range of a file into
+		  absolute sample positions before PhnFileWrite()
+  Input: (SEGMENT *)seg: array of SEGMENT structure
+         long offset: index of the first sample of the range in the file
+*/
+void shift_segments(SEGMENT *seg, long offset)
+{
+     int s;
+
+     for (s=0; s<seg[0].num_segs; s++) {
+	 seg[s].begin += offset;
+	 seg[s].end += offset;
+     }
 }
 
 
@@ -26,7 +26,8 @@ typedef struct {
 short *extract_sample(SEGMENT *seg, short *sample, unsigned long *num_samples);
 
 SEGMENT *PhnFileRead(char *PhnFileName);
-void PhnFileWrite(char *phnfilename, SEGMENT *seg);
+int PhnFileWrite(char *phnfilename, SEGMENT *seg);
+void shift_segments(SEGMENT *seg, long offset);
 
 SEGMENT *MrkFileRead(char *MrkFileName, char channel, int freq);
 
@@ -0,0 +1,498 @@
+/*
+   Filename	:shorten.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description  :Decoder for the shorten streams embedded in NIST SPHERE files
+                 ("pcm,embedded-shorten-v2.00"). Most NIST SRE .sph files are
+		 compressed in this way, and libsp decompresses them through a
+		 temporary buffer before we can see any sample.
+
+		 The decoder reads the stream one block at a time and writes the
+		 samples of every channel straight into the per-channel buffers
+		 used by the VAD pipeline. All channels are decoded in a single
+		 pass, so sph2phn_2ch no longer needs to decompress the file twice.
+
+		 Only the linear PCM file types are handled here (TYPE_S8, TYPE_U8,
+		 TYPE_S16HL, TYPE_U16HL, TYPE_S16LH, TYPE_U16LH). For other types,
+		 e.g. ulaw-coded shorten streams, shn_open() returns NULL and the
+		 caller should fall back to libsp.
+
+		 The bitstream format follows T. Robinson, "SHORTEN: Simple lossless
+		 and near-lossless waveform compression", CUED/F-INFENG/TR.156, 1994.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mmalloc.h"
+#include "shorten.h"
+
+#define SHN_MAGIC       "ajkg"
+#define SHN_MAX_VERSION 2
+
+/* Field sizes of the Rice codes */
+#define ULONGSIZE       2
+#define NSKIPSIZE       1
+#define LPCQSIZE        2
+#define LPCQUANT        5
+#define XBYTESIZE       7
+#define TYPESIZE        4
+#define CHANSIZE        0
+#define ENERGYSIZE      3
+#define BITSHIFTSIZE    2
+#define FNSIZE          2
+#define VERBATIM_CKSIZE_SIZE 5
+#define VERBATIM_BYTE_SIZE   8
+
+#define NWRAP           3
+#define DEFAULT_BLOCK_SIZE 256
+#define DEFAULT_BLOCK_BITS 8           /* log2(DEFAULT_BLOCK_SIZE) */
+#define MAX_BLOCK_SIZE  65535
+#define MAX_NCHAN       8
+#define MAX_NMEAN       32
+#define V2LPCQOFFSET    (1 << LPCQUANT)
+
+/* Function codes */
+#define FN_DIFF0        0
+#define FN_DIFF1        1
+#define FN_DIFF2        2
+#define FN_DIFF3        3
+#define FN_QUIT         4
+#define FN_BLOCKSIZE    5
+#define FN_BITSHIFT     6
+#define FN_QLPC         7
+#define FN_ZERO         8
+#define FN_VERBATIM     9
+
+/* File types */
+#define TYPE_S8         1
+#define TYPE_U8         2
+#define TYPE_S16HL      3
+#define TYPE_U16HL      4
+#define TYPE_S16LH      5
+#define TYPE_U16LH      6
+
+#define ROUNDEDSHIFTDOWN(x,n) ((n)==0 ? (x) : ((x) + (1L << ((n)-1))) >> (n))
+
+
+/***************************************************************************
+  Bit reader. Bits are consumed MSB first from a 64-bit reservoir that is
+  refilled a byte at a time from a large fread() buffer.
+*******************************************************************************/
+static void shn_refill(SHN_DECODER *shn)
+{
+     while (shn->bitcnt <= 56) {
+	 if (shn->bytepos >= shn->nbytes) {
+	     shn->nbytes = fread(shn->bytes, 1, SHN_BUFSIZE, shn->fp);
+	     shn->bytepos = 0;
+	     if (shn->nbytes <= 0) {
+		 shn->nbytes = 0;
+		 shn->eof = 1;
+		 return;
+	     }
+	 }
+	 shn->bitbuf |= (unsigned long long)shn->bytes[shn->bytepos++] << (56 - shn->bitcnt);
+	 shn->bitcnt += 8;
+     }
+}
+
+static unsigned long shn_getbits(SHN_DECODER *shn, int nbit)
+{
+     unsigned long val;
+
+     if (nbit == 0)
+	 return 0;
+     if (shn->bitcnt < nbit)
+	 shn_refill(shn);
+     val = (unsigned long)(shn->bitbuf >> (64 - nbit));
+     shn->bitbuf <<= nbit;
+     shn->bitcnt -= nbit;
+     if (shn->bitcnt < 0)
+	 shn->bitcnt = 0;                  /* Reading past EOF, caller checks shn->eof */
+     return val;
+}
+
+/* Unsigned Rice code: unary high part terminated by a one, then nbin low bits */
+static unsigned long shn_uvar_get(SHN_DECODER *shn, int nbin)
+{
+     unsigned long result = 0;
+     int zeros;
+
+     for (;;) {
+	 if (shn->bitcnt == 0)
+	     shn_refill(shn);
+	 if (shn->bitbuf != 0)
+	     break;
+	 if (shn->eof && shn->bitcnt == 0)
+	     return 0;
+	 result += shn->bitcnt;            /* All valid bits are zero */
+	 shn->bitcnt = 0;
+     }
+     zeros = __builtin_clzll(shn->bitbuf);
+     result += zeros;
+     if (zeros == 63)                      /* Only the LSB is set: a shift by 64 is undefined */
+	 shn->bitbuf = 0;
+     else
+	 shn->bitbuf <<= zeros + 1;
+     shn->bitcnt -= zeros + 1;
+     return (result << nbin) | shn_getbits(shn, nbin);
+}
+
+/* Signed Rice code */
+static long shn_var_get(SHN_DECODER *shn, int nbin)
+{
+     unsigned long uvar = shn_uvar_get(shn, nbin+1);
+     if (uvar & 1)
+	 return ~(long)(uvar >> 1);
+     return (long)(uvar >> 1);
+}
+
+static unsigned long shn_ulong_get(SHN_DECODER *shn)
+{
+     int nbit = (int)shn_uvar_get(shn, ULONGSIZE);
+     if (nbit > 32) {
+	 shn->eof = 1;                     /* Corrupted stream, stop decoding */
+	 shn->bitbuf = 0;
+	 shn->bitcnt = 0;
+	 shn->nbytes = shn->bytepos = 0;
+	 return 0;
+     }
+     return shn_uvar_get(shn, nbit);
+}
+
+/* Header fields are Rice coded with a fixed size in version 0 only */
+static unsigned long shn_uint_get(SHN_DECODER *shn, int nbit)
+{
+     return (shn->version == 0) ? shn_uvar_get(shn, nbit) : shn_ulong_get(shn);
+}
+
+
+/***************************************************************************
+  shn_alloc_buffers(): (Re)allocate the per-channel sample history for a new
+                       block size. The last nwrap samples are preserved.
+*******************************************************************************/
+static int shn_alloc_buffers(SHN_DECODER *shn, int blocksize)
+{
+     int c;
+     long *buf;
+
+     if (blocksize <= shn->bufsize)
+	 return 0;
+     for (c=0; c<shn->nchan; c++) {
+	 buf = (long *)calloc(shn->nwrap + blocksize, sizeof(long));
+	 if (buf == NULL)
+	     return -1;
+	 if (shn->buffer[c] != NULL) {
+	     memcpy(buf, shn->buffer[c] - shn->nwrap, shn->nwrap*sizeof(long));
+	     free(shn->buffer[c] - shn->nwrap);
+	 }
+	 shn->buffer[c] = buf + shn->nwrap;
+     }
+     shn->bufsize = blocksize;
+     return 0;
+}
+
+
+/***************************************************************************
+  shn_open(): Read the shorten header from fp
+  Input:
+        fp: stream positioned at the start of the shorten data, i.e., right
+	    after the SPHERE header
+  Return:
+        A decoder on success; NULL if the stream is not shorten, the version
+	is not supported, or the file type is not linear PCM
+*******************************************************************************/
+SHN_DECODER *shn_open(FILE *fp)
+{
+     SHN_DECODER *shn;
+     unsigned char magic[5];
+     int c, i, nskip, nmean;
+     long mean;
+
+     if (fread(magic, 1, 5, fp) != 5 || memcmp(magic, SHN_MAGIC, 4) != 0)
+	 return((SHN_DECODER *)NULL);
+     if (magic[4] > SHN_MAX_VERSION) {
+	 fprintf(stderr,"Error: Unsupported shorten version %d\n",magic[4]);
+	 return((SHN_DECODER *)NULL);
+     }
+
+     shn = (SHN_DECODER *)calloc(1, sizeof(SHN_DECODER));
+     shn->fp = fp;
+     shn->version = magic[4];
+     shn->bytes = (unsigned char *)malloc(SHN_BUFSIZE);
+
+     shn->ftype = (int)shn_uint_get(shn, TYPESIZE);
+     shn->nchan = (int)shn_uint_get(shn, CHANSIZE);
+     if (shn->version > 0) {
+	 shn->blocksize = (int)shn_uint_get(shn, DEFAULT_BLOCK_BITS);
+	 shn->maxnlpc = (int)shn_uint_get(shn, LPCQSIZE);
+	 shn->nmean = (int)shn_uint_get(shn, 0);
+	 nskip = (int)shn_uint_get(shn, NSKIPSIZE);
+	 for (c=0; c<nskip; c++)
+	     shn_uvar_get(shn, XBYTESIZE);
+     } else {
+	 shn->blocksize = DEFAULT_BLOCK_SIZE;
+	 shn->maxnlpc = 0;
+	 shn->nmean = 0;
+     }
+
+     if ((shn->eof && shn->bitcnt == 0) || shn->nchan < 1 || shn->nchan > MAX_NCHAN ||
+	 shn->blocksize < 1 || shn->blocksize > MAX_BLOCK_SIZE || shn->nmean > MAX_NMEAN) {
+	 fprintf(stderr,"Error: Corrupted shorten header\n");
+	 shn_close(shn);
+	 return((SHN_DECODER *)NULL);
+     }
+     if (shn->ftype < TYPE_S8 || shn->ftype > TYPE_U16LH) {
+	 shn_close(shn);                   /* ulaw/alaw etc. are left to libsp */
+	 return((SHN_DECODER *)NULL);
+     }
+
+     shn->nwrap = (shn->maxnlpc > NWRAP) ? shn->maxnlpc : NWRAP;
+     shn->qlpc = (int *)calloc(shn->nwrap, sizeof(int));
+     shn->buffer = (long **)calloc(shn->nchan, sizeof(long *));
+     shn->offset = (long **)calloc(shn->nchan, sizeof(long *));
+     /* Zero is the mean of all signed types; unsigned types are centred at mid-scale */
+     if (shn->ftype == TYPE_U8)
+	 mean = 0x80;
+     else if (shn->ftype == TYPE_U16HL || shn->ftype == TYPE_U16LH)
+	 mean = 0x8000;
+     else
+	 mean = 0;
+     nmean = (shn->nmean > 1) ? shn->nmean : 1;
+     for (c=0; c<shn->nchan; c++) {
+	 shn->offset[c] = (long *)calloc(nmean, sizeof(long));
+	 for (i=0; i<nmean; i++)
+	     shn->offset[c][i] = mean;
+     }
+     if (shn_alloc_buffers(shn, shn->blocksize) != 0) {
+	 shn_close(shn);
+	 return((SHN_DECODER *)NULL);
+     }
+     return(shn);
+}
+
+
+/* Convert a decoded sample to 16-bit linear PCM */
+static short shn_to_pcm16(SHN_DECODER *shn, long v)
+{
+     switch (shn->ftype) {
+	 case TYPE_S8:  v <<= 8; break;
+	 case TYPE_U8:  v = (v - 0x80) << 8; break;
+	 case TYPE_U16HL:
+	 case TYPE_U16LH: v -= 0x8000; break;
+	 default: break;
+     }
+     if (v > 32767) v = 32767;
+     if (v < -32768) v = -32768;
+     return (short)v;
+}
+
+
+/***************************************************************************
+  shn_decode_block(): Decode the next block of all channels
+  Input:
+        shn         : decoder returned by shn_open()
+	pos         : index in chan_buf[c][] at which the block is written. It
+	              may be negative; samples before index 0 are dropped.
+	max_samples : length of chan_buf[c][]; samples beyond it are dropped
+  Output:
+        chan_buf[c] : decoded samples of channel c. Channels whose buffer is
+	              NULL are decoded (they are needed for the running state)
+		      but not stored.
+  Return:
+        Number of samples per channel in the block, 0 at the end of stream
+	and -1 if the stream is corrupted
+*******************************************************************************/
+int shn_decode_block(SHN_DECODER *shn, short **chan_buf, long pos, unsigned long max_samples)
+{
+     int chan = 0;
+     int cmd, i, j, resn, nlpc, nblk = 0;
+     long coffset, sum, *cbuffer;
+
+     while (chan < shn->nchan) {
+	 cmd = (int)shn_uvar_get(shn, FNSIZE);
+	 if (shn->eof && shn->bitcnt == 0 && cmd == 0)
+	     return (chan == 0) ? 0 : -1;  /* Truncated file without FN_QUIT */
+
+	 switch (cmd) {
+	 case FN_QUIT:
+	     return (chan == 0) ? 0 : -1;
+
+	 case FN_BLOCKSIZE:
+	     i = (int)shn_uint_get(shn, DEFAULT_BLOCK_BITS);
+	     if (i < 1 || i > MAX_BLOCK_SIZE || shn_alloc_buffers(shn, i) != 0)
+		 return -1;
+	     shn->blocksize = i;
+	     break;
+
+	 case FN_BITSHIFT:
+	     shn->bitshift = (int)shn_uvar_get(shn, BITSHIFTSIZE);
+	     break;
+
+	 case FN_VERBATIM:
+	     i = (int)shn_uvar_get(shn, VERBATIM_CKSIZE_SIZE);
+	     while (i--)
+		 shn_uvar_get(shn, VERBATIM_BYTE_SIZE);
+	     break;
+
+	 case FN_ZERO:
+	 case FN_DIFF0:
+	 case FN_DIFF1:
+	 case FN_DIFF2:
+	 case FN_DIFF3:
+	 case FN_QLPC:
+	     cbuffer = shn->buffer[chan];
+	     resn = 0;
+	     if (cmd != FN_ZERO) {
+		 resn = (int)shn_uvar_get(shn, ENERGYSIZE);
+		 if (shn->version == 0)
+		     resn--;               /* Version 0 differed in the definition of var_get */
+		 if (resn < 0 || resn > 30)
+		     return -1;
+	     }
+
+	     /* Find mean offset */
+	     if (shn->nmean == 0)
+		 coffset = shn->offset[chan][0];
+	     else {
+		 sum = (shn->version < 2) ? 0 : shn->nmean/2;
+		 for (i=0; i<shn->nmean; i++)
+		     sum += shn->offset[chan][i];
+		 if (shn->version < 2)
+		     coffset = sum/shn->nmean;
+		 else
+		     coffset = ROUNDEDSHIFTDOWN(sum/shn->nmean, shn->bitshift);
+	     }
+
+	     switch (cmd) {
+	     case FN_ZERO:
+		 for (i=0; i<shn->blocksize; i++)
+		     cbuffer[i] = 0;
+		 break;
+	     case FN_DIFF0:
+		 for (i=0; i<shn->blocksize; i++)
+		     cbuffer[i] = shn_var_get(shn, resn) + coffset;
+		 break;
+	     case FN_DIFF1:
+		 for (i=0; i<shn->blocksize; i++)
+		     cbuffer[i] = shn_var_get(shn, resn) + cbuffer[i-1];
+		 break;
+	     case FN_DIFF2:
+		 for (i=0; i<shn->blocksize; i++)
+		     cbuffer[i] = shn_var_get(shn, resn) + (2*cbuffer[i-1] - cbuffer[i-2]);
+		 break;
+	     case FN_DIFF3:
+		 for (i=0; i<shn->blocksize; i++)
+		     cbuffer[i] = shn_var_get(shn, resn) + 3*(cbuffer[i-1] - cbuffer[i-2]) + cbuffer[i-3];
+		 break;
+	     case FN_QLPC:
+		 nlpc = (int)shn_uvar_get(shn, LPCQSIZE);
+		 if (nlpc > shn->nwrap)
+		     return -1;
+		 for (i=0; i<nlpc; i++)
+		     shn->qlpc[i] = (int)shn_var_get(shn, LPCQUANT);
+		 for (i=0; i<nlpc; i++)
+		     cbuffer[i-nlpc] -= coffset;
+		 for (i=0; i<shn->blocksize; i++) {
+		     sum = (shn->version > 1) ? V2LPCQOFFSET : 0;
+		     for (j=0; j<nlpc; j++)
+			 sum += shn->qlpc[j] * cbuffer[i-j-1];
+		     cbuffer[i] = shn_var_get(shn, resn) + (sum >> LPCQUANT);
+		 }
+		 if (coffset != 0)
+		     for (i=0; i<shn->blocksize; i++)
+			 cbuffer[i] += coffset;
+		 break;
+	     }
+
+	     /* Update the running means with the current block */
+	     if (shn->nmean > 0) {
+		 sum = (shn->version < 2) ? 0 : shn->blocksize/2;
+		 for (i=0; i<shn->blocksize; i++)
+		     sum += cbuffer[i];
+		 for (i=1; i<shn->nmean; i++)
+		     shn->offset[chan][i-1] = shn->offset[chan][i];
+		 if (shn->version < 2)
+		     shn->offset[chan][shn->nmean-1] = sum/shn->blocksize;
+		 else
+		     shn->offset[chan][shn->nmean-1] = (sum/shn->blocksize) << shn->bitshift;
+	     }
+
+	     /* Store the block, restoring the dropped low-order bits */
+	     if (chan_buf[chan] != NULL && pos+shn->blocksize > 0) {
+		 for (i=(pos<0) ? -pos : 0; i<shn->blocksize && pos+i<(long)max_samples; i++)
+		     chan_buf[chan][pos+i] = shn_to_pcm16(shn, cbuffer[i] << shn->bitshift);
+	     }
+
+	     /* Keep the history for the prediction of the next block */
+	     for (i=-shn->nwrap; i<0; i++)
+		 cbuffer[i] = cbuffer[i+shn->blocksize];
+
+	     nblk = shn->blocksize;
+	     chan++;
+	     break;
+
+	 default:
+	     fprintf(stderr,"Error: Unknown shorten function code %d\n",cmd);
+	     return -1;
+	 }
+     }
+     return nblk;
+}
+
+
+/***************************************************************************
+  shn_decode(): Decode the stream up to sample start+num_samples. Shorten
+                has no seek index, so the blocks before start are decoded
+		but not stored.
+  Input:
+        shn         : decoder returned by shn_open()
+	start       : index of the first sample to be stored
+	num_samples : length of chan_buf[c][]
+  Output:
+        chan_buf[c] : samples [start,start+num_samples) of channel c (NULL to
+	              skip a channel)
+  Return:
+        Number of samples per channel stored, -1 on error
+*******************************************************************************/
+long shn_decode(SHN_DECODER *shn, short **chan_buf, unsigned long start, unsigned long num_samples)
+{
+     long pos = -(long)start;
+     int n;
+
+     while (pos < (long)num_samples) {
+	 n = shn_decode_block(shn, chan_buf, pos, num_samples);
+	 if (n < 0)
+	     return -1;
+	 if (n == 0)
+	     break;
+	 pos += n;
+     }
+     if (pos < 0)
+	 return 0;
+     return (pos < (long)num_samples) ? pos : (long)num_samples;
+}
+
+
+void shn_close(SHN_DECODER *shn)
+{
+     int c;
+
+     if (shn == NULL)
+	 return;
+     if (shn->buffer != NULL) {
+	 for (c=0; c<shn->nchan; c++)
+	     if (shn->buffer[c] != NULL)
+		 free(shn->buffer[c] - shn->nwrap);
+	 free(shn->buffer);
+     }
+     if (shn->offset != NULL) {
+	 for (c=0; c<shn->nchan; c++)
+	     free(shn->offset[c]);
+	 free(shn->offset);
+     }
+     free(shn->qlpc);
+     free(shn->bytes);
+     free(shn);
+}
@@ -0,0 +1,43 @@
+/*
+   Filename	:shorten.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Function prototypes for shorten.c, an in-tree decoder for the
+                 shorten (v0-v2) streams embedded in NIST SPHERE files
+*/
+
+#ifndef __SHORTEN_INCLUDE__
+#define __SHORTEN_INCLUDE__
+
+#include <stdio.h>
+
+#define SHN_BUFSIZE 65536              /* Size of the byte buffer for fread() */
+
+typedef struct {
+	FILE	*fp;			/* Stream positioned at the shorten magic "ajkg" */
+	int	version;		/* Shorten version (0, 1 or 2) */
+	int	ftype;			/* Shorten file type, e.g. TYPE_S16LH */
+	int	nchan;			/* Number of interleaved channels */
+	int	blocksize;		/* Number of samples per channel in one block */
+	int	maxnlpc;		/* Maximum LPC order */
+	int	nmean;			/* Number of blocks in the running mean */
+	int	nwrap;			/* Number of history samples kept before each block */
+	int	bitshift;		/* Number of low-order bits dropped by the encoder */
+	int	bufsize;		/* Allocated length of buffer[c] excluding history */
+	long	**buffer;		/* Decoded samples, buffer[c][-nwrap..blocksize-1] */
+	long	**offset;		/* Running means, offset[c][0..nmean-1] */
+	int	*qlpc;			/* Quantized LPC coefficients [0..maxnlpc-1] */
+	unsigned long long bitbuf;	/* Left-aligned bit reservoir */
+	int	bitcnt;			/* Number of valid bits in bitbuf */
+	unsigned char *bytes;		/* Byte buffer filled by fread() */
+	int	nbytes, bytepos;	/* Number of bytes in bytes[] and read position */
+	int	eof;			/* Set when fread() returns no more data */
+} SHN_DECODER;
+
+SHN_DECODER *shn_open(FILE *fp);
+int shn_decode_block(SHN_DECODER *shn, short **chan_buf, long pos, unsigned long max_samples);
+long shn_decode(SHN_DECODER *shn, short **chan_buf, unsigned long start, unsigned long num_samples);
+void shn_close(SHN_DECODER *shn);
+
+#endif
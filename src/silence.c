@@ -10,6 +10,15 @@
 		 This avoids the case where all samples in the background regions
 		 are zeros. However, it is likely that the resulting .phn file
 		 will have two segments only
+   Modified(Oct 26): zero_crossing() and average_magnitude() use the int16
+		 kernels VECsgnchgs() and VECasums() of veclib.c. signal_summary()
+		 added; detect_silence_ex() takes the DC offset and peak from it,
+		 labels runs of zeros of 0.1s or longer as silence and returns
+		 at once for a signal of zeros
+   Modified(Oct 26): frame_features() split out of detect_silence_ex(); the
+		 background and peak frames are picked from a heap instead of
+		 repeated VECminposf()/VECmaxposf(). ambiguous_frames() and
+		 detect_silence_sel() added for sph2phn -dn S
 */
 
 #include <stdio.h>
@@ -21,6 +30,7 @@
 #include "silence.h"
 #include "veclib.h"
 #include "qsortfunc.h"
+#include "probes.h"
 
 int sgn(short y);
 vec_t median(unsigned int num_pk_frms, vec_t *peak);
@@ -36,9 +46,14 @@ int sgn(short y)
 
 vec_t median(unsigned int num_pk_frms, vec_t *peak)
 {
+#ifdef REFERENCE_IMPL
     int (*fp)();
     fp = qsortcomparef;
     qsort((vec_t *)peak, num_pk_frms ,sizeof(vec_t), fp);
+#else
+    /* Sorted in place: qsort() would malloc a copy of peak[] */
+    heap_sort(peak, num_pk_frms, sizeof(vec_t), (int (*)(const void *, const void *))qsortcomparef);
+#endif
     return(peak[(num_pk_frms/2)]);
 }
 
@@ -53,11 +68,16 @@ vec_t median(unsigned int num_pk_frms, vec_t *peak)
 *******************************************************************************/
 vec_t zero_crossing(short *x, unsigned long n)
 {
+#ifdef REFERENCE_IMPL
     unsigned long i;
     unsigned long sum=0;
     for (i=1; i<n; i++)
         sum+=abs(sgn(x[i])-sgn(x[i-1]));
     return (vec_t)sum/(2*(vec_t)n);
+#else
+    /* Each change of sgn() adds |1-(-1)| = 2 to the sum */
+    return (vec_t)(2*VECsgnchgs(n, x))/(2*(vec_t)n);
+#endif
 }
 
 
@@ -71,12 +91,33 @@ vec_t zero_crossing(short *x, unsigned long n)
 *******************************************************************************/
 vec_t average_magnitude(short *x, unsigned long n)
 {
+#ifdef REFERENCE_IMPL
       unsigned long i;
       vec_t amag=0.0;
 
       for (i=0; i<n; i++)
 	  amag += (vec_t)abs(x[i]);
       return(amag/n);
+#else
+      /* The integer sum is exact, as the sum above up to 2^53/32768 samples */
+      return(VECasums(n, x)/n);
+#endif
+}
+
+
+/***************************************************************************
+  signal_summary(): Statistics of a whole speech signal in one pass
+  Input:
+        short *x: speech signals [0..num_samples-1]
+	unsigned long num_samples: number of samples in x[]
+  Output:
+        SIGNAL_SUMMARY *sum: sum, sum of magnitude, peak and sign changes of x[]
+*******************************************************************************/
+void signal_summary(short *x, unsigned long num_samples, SIGNAL_SUMMARY *sum)
+{
+     sum->num_samples = num_samples;
+     VECsummarys(num_samples, x, &sum->sum, &sum->asum, &sum->peak, &sum->num_sgnchg);
+     sum->all_zero = (sum->peak == 0);
 }
 
 
@@ -155,152 +196,447 @@ void moving_average(vec_t *x, unsigned long N, int M)
 
 
 /***************************************************************************
-  detect_silence(): Determine the silence regions of a given speech signals
-  Input:
-        x             : speech signal [0..num_samples-1]
-	num_samples   : number of samples in x[]
-	sample_rate   : sampling rate in Hz
-        zcr_factor    : factor of mean bkg zero-crossing rate 
-        avm_factor    : factor of mean bkg amplitude ($\nu$ in Eq. 9 of CSL paper)
-        noise_energy  : Energy of background noise, for crosstalk removal
-  Return:
-        seg           : array of SEGMENT structure containing the beginning and end 
-	                of silence regions
+  zero_segments(): The segments of detect_silence_ex() for a signal of zeros,
+                   i.e. one h# segment over all frames, without the frame
+		   features. The features of zeros are zero, so that all
+		   frames are silence and their normalized magnitude is zero.
 *******************************************************************************/
+static SEGMENT *zero_segments(unsigned long num_frms, unsigned int wininc,
+			      unsigned long num_samples, int verbose)
+{
+     SEGMENT *seg = (SEGMENT *)vector(0,1,sizeof(SEGMENT));
+
+     seg[0].begin = 0;
+     seg[0].end = num_frms*wininc;
+     strcpy(seg[0].phoneme,"h#");
+     seg[0].num_segs = 1;
+     seg[0].num_samples = seg[0].end-seg[0].begin+1;
+     seg[0].mean_namp = 0.0;
+     SSVAD_PROBE3(silence__segment, seg[0].begin, seg[0].end, 0);
+     SSVAD_PROBE2(silence__segments, num_samples, 1);
+     if (verbose) {
+	 printf("all samples are zero\n");
+	 print_seg_info(seg, wininc, num_samples);
+     }
+     return(seg);
+}
+
+
 #define BKG_AMP_FLOOR 5
 #define BKG_ZCR_FLOOR 0.3
 #define BKG_RATIO 0.1                      /* Assume that 10% of the speech file contain background */
 #define PEAK_RATIO 0.05                    /* Assume that 5% of the speech file contain signal peaks */
-SEGMENT *detect_silence(short *x, unsigned long num_samples, int sample_rate,
-			vec_t zcr_factor, vec_t avm_factor, vec_t noise_energy)
+#define MIN_ZERO_RUN 0.1                   /* Runs of zeros (in seconds) labelled as silence directly */
+#define SEL_HALO 0.05                      /* Context (in seconds) denoised around an ambiguous frame,
+					      longer than the 40-frame moving average */
+
+/* Frame features, thresholds and decisions of detect_silence_ex() */
+typedef struct {
+     unsigned long num_frms;               /* Number of frames */
+     unsigned int winsize;                 /* Number of samples in a frame */
+     unsigned int wininc;                  /* Number of samples to advance for each frame */
+     vec_t    *zcr,*avm;                   /* Smoothed zero crossing rate and average magnitude
+					      [0..num_frms-1] */
+     vec_t    zcr_th;                      /* Threshold for zero crossing rate */
+     vec_t    avm_th;                      /* Threshold for average magnitude */
+     vec_t    mean_zcr;                    /* Mean zero crossing rate of the background */
+     vec_t    mean_avm;                    /* Mean average magnitude of the background */
+     vec_t    min_peak,mean_peak;          /* Minimum and mean of signal peaks */
+     short    *silence;                    /* SILENCE or NONSILENCE [0..num_frms-1], by decide_frames() */
+     short    *zero_frm;                   /* 1 if frame i is all zeros [0..num_frms-1], NULL in
+					      REFERENCE_IMPL, if all frames are zeros or if
+					      the signal is not as read (denoised) */
+     short    *bk_frm;                     /* 1 if frame i is taken as background [0..num_frms-1],
+					      only if asked for */
+     int      all_zero;                    /* 1 if all samples are zeros; no features then */
+} FRAME_INFO;
+
+
+#ifndef REFERENCE_IMPL
+typedef struct {
+     vec_t    v;
+     unsigned long i;
+} RANKED_FRAME;
+
+/* 1 if frame p is picked before frame q: by value, then by position */
+static int picked_before(const RANKED_FRAME *p, const RANKED_FRAME *q, int descending)
 {
-     unsigned long i,j;
-     SEGMENT *seg;                         /* Array of segment to be returned */
-     int      s;                           /* Segment number, index to access seg[] */
-     int      num_segs;                    /* Number of segment */
-     vec_t    *zcr,*z;                     /* Number of zero crossing */
-     vec_t    *avm,*a;                     /* Average magnitude */
+     if (p->v != q->v)
+	 return(descending ? (p->v > q->v) : (p->v < q->v));
+     return(p->i < q->i);
+}
+
+/* Move r[k] down the heap r[0..n-1], whose root is the frame picked first */
+static void sift_frame(RANKED_FRAME *r, unsigned long k, unsigned long n, int descending)
+{
+     unsigned long c;
+     RANKED_FRAME t = r[k];
+
+     for (; (c=2*k+1) < n; k=c) {
+	 if (c+1 < n && picked_before(&r[c+1], &r[c], descending))
+	     c++;
+	 if (!picked_before(&r[c], &t, descending))
+	     break;
+	 r[k] = r[c];
+     }
+     r[k] = t;
+}
+
+/* The first k frames of v[0..n-1] in r[0..k-1], in the order in which repeated
+   VECminposf() (or VECmaxposf() if descending) picks them and removes them. They are
+   taken from a heap of the frames, without sorting the others or allocating more */
+static RANKED_FRAME *rank_frames(const vec_t *v, unsigned long n, unsigned long k, int descending)
+{
+     unsigned long i;
+     RANKED_FRAME t;
+     RANKED_FRAME *r = (RANKED_FRAME *)vector(0,n-1,sizeof(RANKED_FRAME));
+
+     for (i=0; i<n; i++) {
+	 r[i].v = v[i];
+	 r[i].i = i;
+     }
+     if (k > n)
+	 k = n;
+     for (i=n/2; i>0; i--)
+	 sift_frame(r, i-1, n, descending);
+     for (i=0; i<k; i++) {		/* The i-th frame picked goes to r[n-1-i] */
+	 t = r[0]; r[0] = r[n-1-i]; r[n-1-i] = t;
+	 sift_frame(r, 0, n-1-i, descending);
+     }
+     for (i=0; i<k/2; i++) {
+	 t = r[n-k+i]; r[n-k+i] = r[n-1-i]; r[n-1-i] = t;
+     }
+     memmove(r, &r[n-k], k*sizeof(RANKED_FRAME));
+     return(r);
+}
+#endif
+
+
+/***************************************************************************
+  background_stats(): Mean and standard deviation of the average magnitude
+                      and zero crossing rate of the num_bk_frms frames with
+		      the lowest average magnitude, flooring the lowest average
+		      amplitude to BKG_AMP_FLOOR. These frames are marked in
+		      bk_frm[] unless it is NULL. a[] may be overwritten.
+*******************************************************************************/
+static void background_stats(vec_t *a, vec_t *z, unsigned long num_frms, unsigned int num_bk_frms,
+			     vec_t *mean_avm, vec_t *std_avm, vec_t *mean_zcr, vec_t *std_zcr,
+			     short *bk_frm)
+{
+     unsigned long i;
      vec_t    *bk_zcr;                     /* Zero crossing rate of background */
      vec_t    *bk_avm;                     /* Average magnitude of background */
-     vec_t    zcr_th;                      /* Threshold for zero crossing rate */
-     vec_t    avm_th;                      /* Threshold for average magnitude */
+     vec_t    minamp;
+#ifdef REFERENCE_IMPL
+     int      minpos;
+#else
+     unsigned long minpos;
+     RANKED_FRAME *r;                      /* Lowest frames by average magnitude, instead of
+					      finding the lowest num_bk_frms times */
+#endif
+
+     bk_zcr = (vec_t *)vector(0,num_bk_frms-1,sizeof(vec_t));
+     bk_avm = (vec_t *)vector(0,num_bk_frms-1,sizeof(vec_t));
+#ifndef REFERENCE_IMPL
+     r = rank_frames(a, num_frms, num_bk_frms, 0);
+#endif
+     for (i=0; i<num_bk_frms; i++) {
+#ifdef REFERENCE_IMPL
+         minamp = VECminposf(num_frms, a, &minpos);
+#else
+	 minpos = r[i].i;
+	 minamp = r[i].v;
+#endif
+	 if (minamp < BKG_AMP_FLOOR) {
+	     bk_avm[i] = BKG_AMP_FLOOR;
+	     bk_zcr[i] = BKG_ZCR_FLOOR;
+	 } else {
+	     bk_avm[i] = a[minpos];
+	     bk_zcr[i] = z[minpos];
+	 }
+	 if (bk_frm != NULL)
+	     bk_frm[minpos] = 1;
+#ifdef REFERENCE_IMPL
+	 a[minpos] = 1e38;
+#endif
+     }
+#ifndef REFERENCE_IMPL
+     free_vector((char *)r,0,sizeof(RANKED_FRAME));
+#endif
+     VECstatf(num_bk_frms,bk_zcr,mean_zcr,std_zcr);
+     VECstatf(num_bk_frms,bk_avm,mean_avm,std_avm);
+     free_vector((char *)bk_zcr,0,sizeof(vec_t));
+     free_vector((char *)bk_avm,0,sizeof(vec_t));
+}
+
+
+/* The num_pk_frms largest average magnitudes of a[0..num_frms-1], largest first */
+static void find_peaks(const vec_t *a, unsigned long num_frms, unsigned int num_pk_frms, vec_t *peak)
+{
+     unsigned long i;
+#ifdef REFERENCE_IMPL
+     vec_t    maxamp;
+     int      maxpos;
+     vec_t    *p;                          // [0..num_frms-1]
+
+     p = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
+     VECcopyf(num_frms, p, (vec_t *)a);
+     for (i=0; i<num_pk_frms; i++) {
+	 maxamp = VECmaxposf(num_frms, p, &maxpos);
+	 peak[i] = p[maxpos];
+	 p[maxpos] = 0;
+     }
+     free_vector((char *)p,0,sizeof(vec_t));
+#else
+     /* The peaks in the order of repeated VECmaxposf(), from one heap of the frames */
+     RANKED_FRAME *r = rank_frames(a, num_frms, num_pk_frms, 1);
+
+     for (i=0; i<num_pk_frms; i++)
+	 peak[i] = r[i].v;
+     free_vector((char *)r,0,sizeof(RANKED_FRAME));
+#endif
+}
+
+
+/***************************************************************************
+  set_thresholds(): Determine the thresholds based on background statistics and
+                    average magnitude and zero crossing of the speech signal.
+		    Limit the mag threshold within 20% of mean signal peak.
+		    Magnitude threshold is a linear combination between minimum
+		    of peaks and mean background magnitude.
+*******************************************************************************/
+static void set_thresholds(FRAME_INFO *fi, vec_t zcr_factor, vec_t avm_factor,
+			   vec_t mean_avm, vec_t mean_zcr, vec_t std_zcr)
+{
+     if (zcr_factor > 0)
+	 fi->zcr_th = zcr_factor*mean_zcr + 2.0*std_zcr;
+     else
+	 fi->zcr_th = -1;    // Do not use zero-crossing
+     fi->avm_th = avm_factor*mean_avm + (1-avm_factor)*fi->min_peak;
+     if (fi->avm_th==0.0 || fi->avm_th > 0.2*fi->mean_peak) {
+        fi->avm_th = 0.2 * fi->mean_peak;
+     }
+     fi->mean_zcr = mean_zcr;
+     fi->mean_avm = mean_avm;
+}
+
+
+/***************************************************************************
+  frame_features(): Remove the DC offset of x[] and find the smoothed frame
+                    features and the thresholds of detect_silence_ex(), and
+		    the background frames if want_bk is non-zero
+*******************************************************************************/
+static void frame_features(short *x, unsigned long num_samples, int sample_rate,
+			   vec_t zcr_factor, vec_t avm_factor, int verbose,
+			   const SIGNAL_SUMMARY *sum, int want_bk, FRAME_INFO *fi)
+{
+     unsigned long i,j;
+     vec_t    *z;                          /* Number of zero crossing */
+     vec_t    *a;                          /* Average magnitude */
      unsigned long num_frms;               /* Number of frames */
      unsigned int winsize;                 /* Number of samples in a frame */
      unsigned int wininc;                  /* Number of samples to advance for each frame */
-     short    *silence;                    /* Array indicating which frame contain voice and
-					      which frame contain silence. [0..num_frms-1] */
      unsigned int num_bk_frms;             /* Number of frames in the background period */
      unsigned int num_pk_frms;             /* Number of frames containing peak amplitude */
-     vec_t    mean_zcr,std_zcr;            /* The mean and standard derivation of zero crossing 
+     vec_t    mean_zcr,std_zcr;            /* The mean and standard derivation of zero crossing
 					      rate during the background period */
      vec_t    mean_avm,std_avm;            /* The mean and standard derivation of average magnitude
 					      rate during the background period */
      int      sig_peak;                    /* the peak of the signal */
-     vec_t    minamp,maxamp;
-     int      minpos,maxpos;
-     vec_t    mean_peak;                   // Mean of signal peaks
      vec_t    *peak;                       // Amplitude of frames containing peaks [0..num_bkg_frms-1]
-     vec_t    *p;                          // [0..num_frms-1]
      vec_t    median_peak;
-     vec_t    min_peak;
-     vec_t    *norm_avm;                   // Z-normalized average amplitude of the utt
-     unsigned long start_frm,end_frm;      // Start and end frame indexes of the current segment
-
+#ifndef REFERENCE_IMPL
+     SIGNAL_SUMMARY own_sum;               // Summary of x[] if sum is not given
+     int      as_read;                     // 1 if x[] is the signal as read, with its summary given
+     short    offset;                      // DC offset
+     unsigned long nzpos;                  // Position of the first non-zero sample >= i*wininc
+#endif
+
+     memset(fi, 0, sizeof(FRAME_INFO));
      winsize = FRAME_WIDTH*sample_rate;
      wininc = sample_rate/FRAME_RATE;
      num_frms = (num_samples-winsize)/wininc+1;
-     printf("No. of frames = %ld, ",num_frms); fflush(stdout);
+     fi->num_frms = num_frms;
+     fi->winsize = winsize;
+     fi->wininc = wininc;
+     if (verbose) {
+	 printf("No. of frames = %ld, ",num_frms); fflush(stdout);
+     }
 
+#ifdef REFERENCE_IMPL
      /* Remove DC offset */
      remove_offset(x,num_samples);
 
      /* Determine the peak value of x[] */
      for (sig_peak=0,i=0; i<num_samples; i++)
         if (abs(x[i])>sig_peak) sig_peak=abs(x[i]);
-     
-     /* 
-        Find the statistic of background period by looking for nonspeech frames 
+#else
+     /* Remove DC offset as remove_offset(), with the mean and peak from the summary of x[].
+	x[] is only swept if the offset is not zero, and then its peak is found in the same pass */
+     as_read = (sum != NULL && sum->num_samples == num_samples);
+     if (!as_read) {
+	 signal_summary(x, num_samples, &own_sum);
+	 sum = &own_sum;
+     }
+     if (sum->all_zero && avm_factor >= 0) {	/* avm_th < 0 would make zeros speech */
+	 fi->all_zero = 1;
+	 return;
+     }
+
+     /* Frames of digital silence, found before the offset is removed. Only in the signal
+	as read: spectral subtraction may round speech to zeros, so a denoised signal
+	(given without its summary) has none */
+     if (as_read) {
+	 fi->zero_frm = (short *)vector(0,num_frms-1,sizeof(short));
+	 for (nzpos=0,i=0; i<num_frms; i++) {
+	     j = i*wininc;
+	     if (nzpos < j)
+		 nzpos = j + VECnzposs(num_samples-j, &x[j]);
+	     fi->zero_frm[i] = (nzpos >= j+winsize);
+	 }
+     }
+     offset = (short)((vec_t)sum->sum/(vec_t)num_samples);
+     if (offset == 0) {
+	 sig_peak = sum->peak;
+     } else {
+	 for (sig_peak=0,i=0; i<num_samples; i++) {
+	     x[i] -= offset;
+	     if (abs(x[i])>sig_peak) sig_peak=abs(x[i]);
+	 }
+     }
+#endif
+
+     /*
+        Find the statistic of background period by looking for nonspeech frames
         We consider 'num_bk_frms' frames with the lowest amplitude, flooring the
 	lowest average amplitude to BKG_AMP_FLOOR.
 	We assume that about 10% of the speech file is non-speech.
-	We assume that 5% of the speech contain peaks. 
+	We assume that 5% of the speech contain peaks.
      */
 
-     num_bk_frms = BKG_RATIO*num_frms;  
-     if (num_bk_frms < 1) 
+     num_bk_frms = BKG_RATIO*num_frms;
+     if (num_bk_frms < 1)
 	 num_bk_frms = 1;
-     num_pk_frms = PEAK_RATIO*num_frms; 
+     num_pk_frms = PEAK_RATIO*num_frms;
      if (num_pk_frms < 1)
 	 num_pk_frms = 1;
-     bk_zcr = (vec_t *)vector(0,num_bk_frms-1,sizeof(vec_t));
-     bk_avm = (vec_t *)vector(0,num_bk_frms-1,sizeof(vec_t));
      peak = (vec_t *)vector(0,num_pk_frms-1,sizeof(vec_t));
      a = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
-     p = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
      z = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
      for (i=0; i<num_frms; i++) {
          j=i*wininc;
 	 a[i] = average_magnitude(&x[j],winsize);
 	 z[i] = zero_crossing(&x[j],winsize);
      }
-     VECcopyf(num_frms, p, a);
-     for (i=0; i<num_bk_frms; i++) {
-         minamp = VECminposf(num_frms, a, &minpos);
-	 if (minamp < BKG_AMP_FLOOR) {
-	     bk_avm[i] = BKG_AMP_FLOOR;
-	     bk_zcr[i] = BKG_ZCR_FLOOR;
-	 } else {
-	     bk_avm[i] = a[minpos];
-	     bk_zcr[i] = z[minpos];
-	 }
-	 a[minpos] = 1e38;
-     }
-     for (i=0; i<num_pk_frms; i++) {
-	 maxamp = VECmaxposf(num_frms, p, &maxpos);
-	 peak[i] = p[maxpos];
-	 p[maxpos] = 0;
+     if (want_bk) {
+	 fi->bk_frm = (short *)vector(0,num_frms-1,sizeof(short));
+	 memset(fi->bk_frm, 0, num_frms*sizeof(short));
      }
+     find_peaks(a, num_frms, num_pk_frms, peak);
+     background_stats(a, z, num_frms, num_bk_frms, &mean_avm, &std_avm, &mean_zcr, &std_zcr,
+		      fi->bk_frm);
 
-     VECstatf(num_bk_frms,bk_zcr,&mean_zcr,&std_zcr);
-     VECstatf(num_bk_frms,bk_avm,&mean_avm,&std_avm);
-     mean_peak = VECmeanf(num_pk_frms,peak);
+     fi->mean_peak = VECmeanf(num_pk_frms,peak);
      median_peak = median(num_pk_frms,peak);
-     min_peak = VECminf(num_pk_frms,peak);
+     fi->min_peak = VECminf(num_pk_frms,peak);
+     set_thresholds(fi, zcr_factor, avm_factor, mean_avm, mean_zcr, std_zcr);
 
-     /* 
-        Determine the thresholds based on background statistics and average magnitude and
-        zero crossing of the speech signal. Limit the mag threshold within 20% of mean signal peak.
-	Magnitude threshold is a linear combination between minimum of peaks and mean background magnitude.
-     */
-     if (zcr_factor > 0)
-	 zcr_th = zcr_factor*mean_zcr + 2.0*std_zcr;
-     else
-	 zcr_th = -1;    // Do not use zero-crossing
-     avm_th = avm_factor*mean_avm + (1-avm_factor)*min_peak;
-     if (avm_th==0.0 || avm_th > 0.2*mean_peak) {
-        avm_th = 0.2 * mean_peak;
-     }
-     
-     printf("mean_bkg_avm=%.2lf, std_bkg_avm=%.2lf, mean_bkg_zcr=%.2lf, std_bkg_zcr=%.2lf, min_peak=%.2lf, sig_peak=%d, median_peak=%.2lf, mean_peak=%.2lf, avm_th=%.2lf, zcr_th=%.2lf, mean_zcr=%.2lf\n",mean_avm,std_avm,mean_zcr,std_avm,min_peak,sig_peak,median_peak,mean_peak,avm_th,zcr_th,mean_zcr);
+     if (verbose)
+	 printf("mean_bkg_avm=%.2lf, std_bkg_avm=%.2lf, mean_bkg_zcr=%.2lf, std_bkg_zcr=%.2lf, min_peak=%.2lf, sig_peak=%d, median_peak=%.2lf, mean_peak=%.2lf, avm_th=%.2lf, zcr_th=%.2lf, mean_zcr=%.2lf\n",mean_avm,std_avm,mean_zcr,std_avm,fi->min_peak,sig_peak,median_peak,fi->mean_peak,fi->avm_th,fi->zcr_th,mean_zcr);
 
-     /* Determine silence frames. Information store in silence[] */
-     silence = (short *)vector(0,num_frms-1,sizeof(short));
-     zcr = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
-     avm = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
+     /* Frame features for the decisions */
+#ifdef REFERENCE_IMPL
+     fi->zcr = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
+     fi->avm = (vec_t *)vector(0,num_frms-1,sizeof(vec_t));
      for (i=0; i<num_frms; i++) {
          j=i*wininc;
-	 zcr[i]=zero_crossing(&x[j],winsize);
-	 avm[i]=average_magnitude(&x[j],winsize);
+	 fi->zcr[i]=zero_crossing(&x[j],winsize);
+	 fi->avm[i]=average_magnitude(&x[j],winsize);
      }
+     free_vector((char *)a,0,sizeof(vec_t));
+     free_vector((char *)z,0,sizeof(vec_t));
+#else
+     /* They are a[] and z[] again: background_stats() leaves a[] as it is */
+     fi->zcr = z;
+     fi->avm = a;
+#endif
 
      /* Smooth the profile of average amplitude and zero crossing using moving averaging */
-     moving_average(zcr,num_frms,40);
-     moving_average(avm,num_frms,40);
+     moving_average(fi->zcr,num_frms,40);
+     moving_average(fi->avm,num_frms,40);
+
+     free_vector((char *)peak,0,sizeof(vec_t));
+}
+
+
+/* SILENCE or NONSILENCE of frame i by the features and thresholds of fi */
+static short frame_decision(const FRAME_INFO *fi, unsigned long i)
+{
+     /* Use zero crossing only if backgroud frames do not contain all zeros */
+     if (fi->zcr_th > 0.0)
+	 return((fi->zcr[i] <= fi->zcr_th && fi->avm[i] <= fi->avm_th) ? SILENCE : NONSILENCE);
+     if (fi->avm[i] <= fi->avm_th)
+	 return(SILENCE);
+     if (fi->zcr[i] < fi->mean_zcr*0.1)
+	 return(SILENCE);           // Set frames with extremely low zero crossing rate to silence
+     return(NONSILENCE);
+}
+
+
+/***************************************************************************
+  decide_frames(): Determine silence frames. Information store in fi->silence[]
+*******************************************************************************/
+static void decide_frames(FRAME_INFO *fi)
+{
+     unsigned long i;
+#ifndef REFERENCE_IMPL
+     unsigned long j;
+     unsigned long run;                    // Start of a run of zero frames
+#endif
+
+     fi->silence = (short *)vector(0,fi->num_frms-1,sizeof(short));
+     for (i=0; i<fi->num_frms; i++)
+	 fi->silence[i] = frame_decision(fi, i);
+
+#ifndef REFERENCE_IMPL
+     /* Long runs of zero frames of the signal as read are non-speech whatever their
+	smoothed features. Short ones are left alone */
+     if (fi->zero_frm == NULL)
+	 return;
+     for (run=0,i=0; i<=fi->num_frms; i++) {
+	 if (i < fi->num_frms && fi->zero_frm[i])
+	     continue;
+	 if (i-run >= (unsigned long)(MIN_ZERO_RUN*FRAME_RATE)) {
+	     for (j=run; j<i; j++)
+		 fi->silence[j]=SILENCE;
+	 }
+	 run = i+1;
+     }
+#endif
+}
+
+
+/***************************************************************************
+  frame_segments(): The segments of the frame decisions fi->silence[], with the
+                    smoothed average magnitude fi->avm[] normalized by noise_energy
+*******************************************************************************/
+static SEGMENT *frame_segments(FRAME_INFO *fi, vec_t noise_energy, unsigned long num_samples,
+			       int verbose)
+{
+     unsigned long i;
+     SEGMENT *seg;                         /* Array of segment to be returned */
+     int      s;                           /* Segment number, index to access seg[] */
+     int      num_segs;                    /* Number of segment */
+     unsigned long num_frms = fi->num_frms;
+     unsigned int wininc = fi->wininc;
+     short    *silence = fi->silence;
+     vec_t    *norm_avm;                   // Z-normalized average amplitude of the utt
+     unsigned long start_frm,end_frm;      // Start and end frame indexes of the current segment
 
      /* Normalize the energy so that the energy in the 2 channels can be compared. This is
 	important for crosstalk removal */
      norm_avm = (vec_t *)vector(0, num_frms-1, sizeof(vec_t));
-     VECcopyf(num_frms, norm_avm, avm);
+     VECcopyf(num_frms, norm_avm, fi->avm);
 
      // Perform Z-norm: This is not good for some files
      //VECznorm(num_frms, norm_avm, VECmeanf(num_frms, avm), VECstddevf(num_frms, avm));
@@ -311,26 +647,6 @@ SEGMENT *detect_silence(short *x, unsigned long num_samples, int sample_rate,
      // Normalized by the square root of the norm of background spectrum: Seems to be the best option
      VECmulalphaf(num_frms, 1/(noise_energy+1e-38), norm_avm);
 
-     /* Use zero crossing only if backgroud frames do not contain all zeros */
-     if (zcr_th > 0.0) {
-        for (i=0; i<num_frms; i++) {
-	    if (zcr[i] <= zcr_th && avm[i] <= avm_th)
-	        silence[i]=SILENCE;
-	    else
-	        silence[i]=NONSILENCE;
-        }
-     } else {
-        for (i=0; i<num_frms; i++) {
-	    if (avm[i]<=avm_th)
-	       silence[i]=SILENCE;
-	    else
-	       silence[i]=NONSILENCE;
-	    if (zcr[i] < mean_zcr*0.1) {
-	    	silence[i]=SILENCE;           // Set frames with extremely low zero crossing rate to silence
-	    }        
-	}
-     }
-
      /* Determine the number of segments */
      num_segs=0;
      for (i=1; i<num_frms; i++)
@@ -356,27 +672,292 @@ SEGMENT *detect_silence(short *x, unsigned long num_samples, int sample_rate,
 	 seg[s].num_samples = seg[s].end-seg[s].begin+1;
 	 end_frm = i;
 	 seg[s].mean_namp = VECmeanf(end_frm-start_frm+1, &norm_avm[start_frm]);
+	 SSVAD_PROBE3(silence__segment, seg[s].begin, seg[s].end, silence[i]!=SILENCE);
 	 i++;
 	 s++;
      }
+     SSVAD_PROBE2(silence__segments, num_samples, num_segs);
 
      /* Print segment information in <#frames #segments #samples %speech> */
-     print_seg_info(seg, wininc, num_samples);
+     if (verbose)
+	 print_seg_info(seg, wininc, num_samples);
+
+     free_vector((char *)norm_avm,0,sizeof(vec_t));
+     return(seg);
+}
+
+
+static void free_frame_info(FRAME_INFO *fi)
+{
+     if (fi->silence != NULL)
+	 free_vector((char *)fi->silence,0,sizeof(short));
+     if (fi->zero_frm != NULL)
+	 free_vector((char *)fi->zero_frm,0,sizeof(short));
+     if (fi->bk_frm != NULL)
+	 free_vector((char *)fi->bk_frm,0,sizeof(short));
+     if (fi->zcr != NULL)
+	 free_vector((char *)fi->zcr,0,sizeof(vec_t));
+     if (fi->avm != NULL)
+	 free_vector((char *)fi->avm,0,sizeof(vec_t));
+}
+
+
+/***************************************************************************
+  detect_silence(): Determine the silence regions of a given speech signals
+  Input:
+        x             : speech signal [0..num_samples-1]
+	num_samples   : number of samples in x[]
+	sample_rate   : sampling rate in Hz
+        zcr_factor    : factor of mean bkg zero-crossing rate
+        avm_factor    : factor of mean bkg amplitude ($\nu$ in Eq. 9 of CSL paper)
+        noise_energy  : Energy of background noise, for crosstalk removal
+	verbose       : print frame count, thresholds and segments to stdout if non-zero
+                        (detect_silence() always prints)
+	sum           : signal_summary() of x[0..num_samples-1], or NULL to take it here.
+	                Runs of zeros are labelled as silence only if it is given, i.e.
+			x[] is the signal as read rather than a denoised one
+  Return:
+        seg           : array of SEGMENT structure containing the beginning and end
+	                of silence regions
+*******************************************************************************/
+SEGMENT *detect_silence_ex(short *x, unsigned long num_samples, int sample_rate,
+			   vec_t zcr_factor, vec_t avm_factor, vec_t noise_energy, int verbose,
+			   const SIGNAL_SUMMARY *sum)
+{
+     FRAME_INFO fi;
+     SEGMENT  *seg;
+
+     frame_features(x, num_samples, sample_rate, zcr_factor, avm_factor, verbose, sum, 0, &fi);
+     if (fi.all_zero)
+	 return(zero_segments(fi.num_frms, fi.wininc, num_samples, verbose));
+     decide_frames(&fi);
+     seg = frame_segments(&fi, noise_energy, num_samples, verbose);
+     free_frame_info(&fi);
+     return(seg);
+}
+
+
+/* 1 if the smoothed average magnitude of frame i is within a factor 1+margin of avm_th,
+   or of the background if avm_th has been limited to below it (by 20% of mean peak) */
+static int ambiguous(const FRAME_INFO *fi, unsigned long i, vec_t margin)
+{
+     vec_t upper = (fi->avm_th > fi->mean_avm) ? fi->avm_th : fi->mean_avm;
+
+     if (fi->zero_frm != NULL && fi->zero_frm[i])
+	 return(0);
+     return(fi->avm[i]*(1+margin) >= fi->avm_th && fi->avm[i] <= upper*(1+margin));
+}
+
+
+/* Select the frames of denoise_sel() that give the output samples [begin..end-1] */
+static void select_samples(AMBIGUOUS_FRAMES *af, long begin, long end)
+{
+     long offset = af->frame_size/2 - af->frame_adv/2;
+     unsigned long k,first,last;
+
+     first = (begin > offset) ? (begin-offset)/af->frame_adv : 0;
+     last = (end > offset) ? (end-1-offset)/af->frame_adv : 0;
+     for (k=first; k<=last && k<af->num_dn_frms; k++) {
+	 af->num_sel += !af->sel[k];
+	 af->sel[k] = 1;
+     }
+}
+
+
+/* 1 if the output samples [j..j+winsize-1] of denoise_sel() are all denoised */
+static int denoised(const AMBIGUOUS_FRAMES *af, unsigned long j, unsigned long winsize)
+{
+     unsigned long k, offset = af->frame_size/2 - af->frame_adv/2;
+
+     if (j < offset || j+winsize-offset > af->num_dn_frms*af->frame_adv)
+	 return(0);
+     for (k=(j-offset)/af->frame_adv; k<=(j+winsize-1-offset)/af->frame_adv; k++)
+	 if (!af->sel[k])
+	     return(0);
+     return(1);
+}
+
 
-     free_vector((char *)silence,0,sizeof(short));
-     free_vector((char *)bk_zcr,0,sizeof(short));
-     free_vector((char *)bk_avm,0,sizeof(short));
-     free_vector((char *)zcr,0,sizeof(vec_t));
-     free_vector((char *)avm,0,sizeof(vec_t));
+/***************************************************************************
+  ambiguous_frames(): First stage of detect_silence() with selective
+                      denoising. The frames of x[] are decided as by
+		      detect_silence_ex(). Those whose smoothed average
+		      magnitude is within a factor 1+margin of avm_th are
+		      ambiguous; they and SEL_HALO seconds around them are to
+		      be denoised, and so are the background frames, from which
+		      detect_silence_sel() takes the thresholds of the denoised
+		      speech.
+  Input:
+        x, num_samples, sample_rate, zcr_factor, avm_factor, sum: as detect_silence_ex(),
+	                but x[] is not changed
+        margin        : relative margin around avm_th
+	frameSize, frameAdv: frame size and advance of denoise_sel()
+  Return:
+        af            : decisions and ambiguous frames of x[], and sel[] for denoise_sel().
+	                Free with free_ambiguous_frames().
+*******************************************************************************/
+AMBIGUOUS_FRAMES *ambiguous_frames(short *x, unsigned long num_samples, int sample_rate,
+				   vec_t zcr_factor, vec_t avm_factor, vec_t margin,
+				   unsigned long frameSize, unsigned long frameAdv,
+				   const SIGNAL_SUMMARY *sum)
+{
+     FRAME_INFO fi;
+     AMBIGUOUS_FRAMES *af;
+     unsigned long i;
+     long j,halo;
+     short *xc;                            // x[] without DC offset, for the features
+
+     af = (AMBIGUOUS_FRAMES *)vector(0,0,sizeof(AMBIGUOUS_FRAMES));
+     memset(af, 0, sizeof(AMBIGUOUS_FRAMES));
+     af->frame_size = frameSize;
+     af->frame_adv = frameAdv;
+     af->num_dn_frms = num_samples/frameAdv-((frameSize/frameAdv)-1);
+     af->sel = (unsigned char *)vector(0,af->num_dn_frms-1,sizeof(unsigned char));
+     memset(af->sel, 0, af->num_dn_frms);
+
+     xc = (short *)vector(0,num_samples-1,sizeof(short));
+     memcpy(xc, x, num_samples*sizeof(short));
+     frame_features(xc, num_samples, sample_rate, zcr_factor, avm_factor, 0, sum, 1, &fi);
+     free_vector((char *)xc,0,sizeof(short));
+     af->num_frms = fi.num_frms;
+     af->all_zero = fi.all_zero;
+     if (!fi.all_zero) {
+	 decide_frames(&fi);
+	 af->silence = fi.silence;
+	 fi.silence = NULL;
+	 af->ambiguous = (unsigned char *)vector(0,fi.num_frms-1,sizeof(unsigned char));
+	 halo = (long)(SEL_HALO*sample_rate);
+	 for (i=0; i<fi.num_frms; i++) {
+	     j = i*fi.wininc;
+	     af->ambiguous[i] = ambiguous(&fi, i, margin);
+	     if (af->ambiguous[i])
+		 select_samples(af, j-halo, j+fi.winsize+halo);
+	     else if (fi.bk_frm[i])
+		 select_samples(af, j, j+fi.winsize);
+	 }
+     }
+     free_frame_info(&fi);
+     return(af);
+}
+
+
+void free_ambiguous_frames(AMBIGUOUS_FRAMES *af)
+{
+     if (af->silence != NULL)
+	 free_vector((char *)af->silence,0,sizeof(short));
+     if (af->ambiguous != NULL)
+	 free_vector((char *)af->ambiguous,0,sizeof(unsigned char));
+     free_vector((char *)af->sel,0,sizeof(unsigned char));
+     free_vector((char *)af,0,sizeof(AMBIGUOUS_FRAMES));
+}
+
+
+/***************************************************************************
+  detect_silence_sel(): Second stage of detect_silence() with selective
+                        denoising. The ambiguous frames of ambiguous_frames()
+			are decided again on y[], against thresholds from the
+			background of its denoised part; the others keep their
+			decisions.
+  Input:
+	y             : x[] of ambiguous_frames(), denoised by denoise_sel() in the
+	                frames af->sel[] [0..num_samples-1]. Its DC offset is removed.
+	num_samples   : number of samples of y[]
+	af            : ambiguous_frames() of x[]
+	others        : as detect_silence_ex()
+  Return:
+        seg           : as detect_silence_ex(); mean_namp is that of y[]
+*******************************************************************************/
+SEGMENT *detect_silence_sel(short *y, unsigned long num_samples, int sample_rate,
+			    vec_t zcr_factor, vec_t avm_factor, const AMBIGUOUS_FRAMES *af,
+			    vec_t noise_energy, int verbose)
+{
+     FRAME_INFO fy;                        // Features of y[]
+     SEGMENT  *seg;
+     unsigned long i,j,n,num_redo;
+     vec_t    *a,*z;                       // Features of the denoised frames [0..n-1]
+     vec_t    mean_zcr,std_zcr,mean_avm,std_avm;
+     unsigned int num_bk_frms,num_pk_frms;
+     vec_t    *peak;                       // Amplitude of frames containing peaks [0..num_pk_frms-1]
+
+     memset(&fy, 0, sizeof(FRAME_INFO));
+     fy.winsize = FRAME_WIDTH*sample_rate;
+     fy.wininc = sample_rate/FRAME_RATE;
+     fy.num_frms = (num_samples-fy.winsize)/fy.wininc+1;
+     if (fy.num_frms > af->num_frms)
+	 fy.num_frms = af->num_frms;
+     if (af->all_zero)
+	 return(zero_segments(fy.num_frms, fy.wininc, num_samples, verbose));
+     if (verbose) {
+	 printf("No. of frames = %ld, ",fy.num_frms); fflush(stdout);
+     }
+
+     /* Features of y[], as detect_silence_ex() takes them, and those of its denoised frames */
+     remove_offset(y, num_samples);
+     fy.zcr = (vec_t *)vector(0,fy.num_frms-1,sizeof(vec_t));
+     fy.avm = (vec_t *)vector(0,fy.num_frms-1,sizeof(vec_t));
+     a = (vec_t *)vector(0,fy.num_frms-1,sizeof(vec_t));
+     z = (vec_t *)vector(0,fy.num_frms-1,sizeof(vec_t));
+     for (n=0,i=0; i<fy.num_frms; i++) {
+	 j = i*fy.wininc;
+	 fy.zcr[i] = zero_crossing(&y[j],fy.winsize);
+	 fy.avm[i] = average_magnitude(&y[j],fy.winsize);
+	 if (denoised(af, j, fy.winsize)) {
+	     a[n] = fy.avm[i];
+	     z[n] = fy.zcr[i];
+	     n++;
+	 }
+     }
+     num_pk_frms = PEAK_RATIO*fy.num_frms;
+     if (num_pk_frms < 1)
+	 num_pk_frms = 1;
+     peak = (vec_t *)vector(0,num_pk_frms-1,sizeof(vec_t));
+     find_peaks(fy.avm, fy.num_frms, num_pk_frms, peak);
+     fy.mean_peak = VECmeanf(num_pk_frms,peak);
+     fy.min_peak = VECminf(num_pk_frms,peak);
      free_vector((char *)peak,0,sizeof(vec_t));
-     free_vector((char *)p,0,sizeof(vec_t));
+     moving_average(fy.zcr,fy.num_frms,40);
+     moving_average(fy.avm,fy.num_frms,40);
+
+     /* Re-decide the ambiguous frames on y[], against the background of its denoised frames
+	and its peaks. As many background frames are taken as detect_silence_ex()
+	takes from the whole signal: the ambiguous frames and their halo have little of it */
+     fy.silence = (short *)vector(0,fy.num_frms-1,sizeof(short));
+     memcpy(fy.silence, af->silence, fy.num_frms*sizeof(short));
+     num_redo = 0;
+     if (n > 0) {
+	 num_bk_frms = BKG_RATIO*fy.num_frms;
+	 if (num_bk_frms > n)
+	     num_bk_frms = n;
+	 if (num_bk_frms < 1)
+	     num_bk_frms = 1;
+	 background_stats(a, z, n, num_bk_frms, &mean_avm, &std_avm, &mean_zcr, &std_zcr, NULL);
+	 set_thresholds(&fy, zcr_factor, avm_factor, mean_avm, mean_zcr, std_zcr);
+	 for (i=0; i<fy.num_frms; i++) {
+	     if (af->ambiguous[i] && denoised(af, i*fy.wininc, fy.winsize)) {
+		 fy.silence[i] = frame_decision(&fy, i);
+		 num_redo++;
+	     }
+	 }
+     }
+     if (verbose)
+	 printf("%lu frames denoised, %lu ambiguous frames decided again with avm_th=%.2lf\n",
+		n, num_redo, fy.avm_th);
+
+     /* The segments of the decisions, with the magnitude of y[] for crosstalk removal */
+     seg = frame_segments(&fy, noise_energy, num_samples, verbose);
+
      free_vector((char *)a,0,sizeof(vec_t));
      free_vector((char *)z,0,sizeof(vec_t));
-     free_vector((char *)norm_avm,0,sizeof(vec_t));
-
+     free_frame_info(&fy);
      return(seg);
 }
 
+SEGMENT *detect_silence(short *x, unsigned long num_samples, int sample_rate,
+			vec_t zcr_factor, vec_t avm_factor, vec_t noise_energy)
+{
+     return(detect_silence_ex(x,num_samples,sample_rate,zcr_factor,avm_factor,noise_energy,1,NULL));
+}
+
 
          
 
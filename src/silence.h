@@ -15,10 +15,23 @@
 
 #define FRAME_WIDTH 0.01                   /* Frame width in second */
 #define FRAME_RATE 1000                     /* How many frame per second */
+#define NUM_FRAMES(n,sr) (((n)-(unsigned long)(FRAME_WIDTH*(sr)))/((sr)/FRAME_RATE)+1) /* Frames of detect_silence() */
 #define BACKGROUND_PERIOD 0.1              /* The first 0.1 seconds have no speech */
 #define SILENCE     1
 #define NONSILENCE -1
 
+/* Whole-signal statistics, taken in one pass when the signal is read and shared by the
+   stages that used to scan it on their own */
+typedef struct {
+     unsigned long num_samples;            /* Samples of x[] summarised */
+     long long     sum;                    /* Sum of x[]; DC offset = sum/num_samples */
+     unsigned long long asum;              /* Sum of |x[]| */
+     int           peak;                   /* max |x[]| */
+     unsigned long num_sgnchg;             /* Sign changes, zero_crossing(x) = num_sgnchg/num_samples */
+     int           all_zero;               /* 1 if all samples are 0 */
+} SIGNAL_SUMMARY;
+
+void signal_summary(short *x, unsigned long num_samples, SIGNAL_SUMMARY *sum);
 vec_t zero_crossing(short *x, unsigned long n);
 vec_t average_magnitude(short *x, unsigned long n);
 void remove_offset(short *x, unsigned long num_samples);
@@ -26,6 +39,29 @@ void FIR_filtering(vec_t *x, unsigned long N, vec_t a0, vec_t a1, vec_t a2);
 void moving_average(vec_t *x, unsigned long N, int M);
 SEGMENT *detect_silence(short *x, unsigned long num_samples, int sample_rate,
 			vec_t zcr_factor, vec_t avm_factor, vec_t noise_energy);
+SEGMENT *detect_silence_ex(short *x, unsigned long num_samples, int sample_rate,
+			   vec_t zcr_factor, vec_t avm_factor, vec_t noise_energy, int verbose,
+			   const SIGNAL_SUMMARY *sum);
+/* First stage of detect_silence() with selective denoising (sph2phn -dn S), see silence.c */
+typedef struct {
+     unsigned long num_frms;               /* Frames of detect_silence_ex() */
+     int           all_zero;               /* 1 if all samples are 0; no frames are decided then */
+     short         *silence;               /* SILENCE or NONSILENCE of the noisy speech [0..num_frms-1] */
+     unsigned char *ambiguous;             /* 1 if frame i is to be decided again [0..num_frms-1] */
+     unsigned long frame_size,frame_adv;   /* Frame size and advance of denoise_sel() */
+     unsigned long num_dn_frms;            /* Frames of denoise_sel() */
+     unsigned char *sel;                   /* 1 if frame k of denoise_sel() is denoised [0..num_dn_frms-1] */
+     unsigned long num_sel;                /* Number of frames in sel[] */
+} AMBIGUOUS_FRAMES;
+
+AMBIGUOUS_FRAMES *ambiguous_frames(short *x, unsigned long num_samples, int sample_rate,
+				   vec_t zcr_factor, vec_t avm_factor, vec_t margin,
+				   unsigned long frameSize, unsigned long frameAdv,
+				   const SIGNAL_SUMMARY *sum);
+void free_ambiguous_frames(AMBIGUOUS_FRAMES *af);
+SEGMENT *detect_silence_sel(short *y, unsigned long num_samples, int sample_rate,
+			    vec_t zcr_factor, vec_t avm_factor, const AMBIGUOUS_FRAMES *af,
+			    vec_t noise_energy, int verbose);
 
 #endif
 
@@ -21,6 +21,9 @@
 #include "denoise.h"
 #include "findnoise.h"
 #include "winwav.h"
+#include "flac.h"
+#include "profile.h"
+#include "probes.h"
 
 
 
@@ -32,7 +35,20 @@ char
     *CL_SphFile="default.sph",	      /* Default .sph filename */
     *CL_ChannelID="A",                /* In case of SPIDRE corpus, the channel to be read */
     *CL_Denoise="Y",                  /* Apply noise reduction before performing speech detection */
+                                      /* (Y, N, A: only if the estimated SNR is not above -snr, */
+                                      /* or S: only around the frames near the threshold) */
+    *CL_SnrThreshold="35",            /* SNR in dB above which -dn A does not denoise */
+    *CL_DenoiseMargin="1.0",          /* -dn S: relative margin of average magnitude around its threshold */
     *CL_DenoiseWavFile=(char *)NULL,  /* Denoised speech file, only if Denoise is Y */
+    *CL_WavFile=(char *)NULL,         /* MS .wav file, read instead of the .sph file */
+    *CL_RawFile=(char *)NULL,         /* Headerless PCM file, read instead of the .sph file */
+    *CL_FlacFile=(char *)NULL,        /* FLAC file, read instead of the .sph file */
+    *CL_StartTime="0",                /* Start of the region to be processed, in sec or [hh:]mm:ss */
+    *CL_EndTime=(char *)NULL,         /* End of the region, NULL for the end of file */
+    *CL_ProfileFile=(char *)NULL,     /* Append per-stage timing as a JSON line to this file ("-" for stdout) */
+    *CL_TraceFile=(char *)NULL,       /* Append Chrome trace events of the stages to this file (not "-") */
+    *CL_PerfCounters="N",             /* Y: add hardware counters (cycles, cache misses, ...) to the profile */
+    *CL_RawFormat="8000,1,16",        /* Sampling rate, no. of channels and bits/sample of raw file */
     *CL_ZcrFactor="-1000",            /* Factor for determining zero crossing threshold (<0 means not use) */
     *CL_AvmFactor="0.99";             /* Factor for determining average mag threshold */
                                       /* Th = f*bkg_magnitude+(1-f)mean_peak */
@@ -44,6 +60,17 @@ CLINEPARA options[]=
     {"-ChannelID", "-ch", &CL_ChannelID},
     {"-Denoise", "-dn", &CL_Denoise},
     {"-DenoiseWavFile", "-df", &CL_DenoiseWavFile},
+    {"-SnrThreshold", "-snr", &CL_SnrThreshold},
+    {"-DenoiseMargin", "-dm", &CL_DenoiseMargin},
+    {"-WavFile", "-wav", &CL_WavFile},
+    {"-RawFile", "-raw", &CL_RawFile},
+    {"-RawFormat", "-rf", &CL_RawFormat},
+    {"-FlacFile", "-flac", &CL_FlacFile},
+    {"-StartTime", "-start", &CL_StartTime},
+    {"-EndTime", "-end", &CL_EndTime},
+    {"-ProfileFile", "-profile", &CL_ProfileFile},
+    {"-TraceFile", "-trace", &CL_TraceFile},
+    {"-PerfCounters", "-perf", &CL_PerfCounters},
     {"-ZeroCrossingFactor", "-zf", &CL_ZcrFactor},
     {"-AverageAmplitudeFactor", "-af", &CL_AvmFactor}
 };  	
@@ -58,6 +85,8 @@ int main(int argc, char *argv[])
      SP_INTEGER sr;                 /* Sampling rate in Hz */
      unsigned long num_samples;     /* number of samples to be read from audio device */
      short *spbuf;                  /* buffer storing speech samples */
+     short **wavbuf;                /* channels read from .wav or raw file */
+     WAV_INFO wavinfo;              /* format of .wav, .flac or raw file */
      SEGMENT *segment;              /* Structure storing information regarding silence 
 				       regions*/
      int   errcode;
@@ -74,6 +103,16 @@ int main(int argc, char *argv[])
      unsigned long numOutSmps;		  // Number of output samples. Could be less than numSmps
      vec_t *noiseSpec;			  // Noise spectrum [0...frameSize-1]
      unsigned long j,tot_num_segs,num_sph_segs;
+     double start_time, end_time;          // Region to be processed in sec, end_time<=0 for end of file
+     unsigned long first_smp;              // Index of the first sample of the region in the file
+     short **sphbuf;
+     char *infile;                         // Input file, for the profile
+     int has_speech;
+     int do_denoise;                       // -dn Y, or -dn A and SNR not above -snr
+     vec_t snr;                            // estimate_snr() of spbuf[] for -dn A
+     AMBIGUOUS_FRAMES *amb = NULL;         // Frames of spbuf[] to be denoised and decided again for -dn S
+     SIGNAL_SUMMARY sigsum;                // DC offset, peak and zero crossings of spbuf[]
+     PROFILE prof;                         // Wall and CPU time of each stage
 
      if (argc==1)
          usage(argv[0],num_options,options);
@@ -82,23 +121,118 @@ int main(int argc, char *argv[])
      get_cmdline(argc, argv, num_options, options);
      zcr_factor = atof(CL_ZcrFactor);
      avm_factor = atof(CL_AvmFactor);
+     start_time = string_to_time(CL_StartTime);
+     end_time = (CL_EndTime!=NULL) ? string_to_time(CL_EndTime) : 0.0;
+     if (CL_TraceFile!=NULL && strcmp(CL_TraceFile,"-")==0) {
+	 fprintf(stderr,"%s: -trace needs a file, the trace cannot go to stdout\n",argv[0]);
+	 exit(EXIT_FAILURE);
+     }
+     infile = CL_WavFile ? CL_WavFile : CL_FlacFile ? CL_FlacFile : CL_RawFile ? CL_RawFile : CL_SphFile;
+     prof_init(&prof, argv[0], infile, CL_ChannelID[0]);
+     SSVAD_PROBE2(file__start, prof.file, CL_ChannelID[0]);
+     if (CL_PerfCounters[0] == 'Y') {
+	 if (CL_ProfileFile==NULL)
+	     CL_ProfileFile = "-";
+	 prof_open_counters(&prof);
+     }
 
      /* Read the wave file */
-     if ((spbuf=read_wav_file(CL_SphFile,&num_samples,&bps,&n_ch,&sr,&smpcode,CL_ChannelID[0],
-			      &errcode))==NULL) {
-	 fprintf(stderr,"%s: Error in reading %s\n",argv[0],CL_SphFile);
-	 exit(EXIT_FAILURE);
+     prof_begin(&prof,"read");
+     if (CL_WavFile!=NULL || CL_RawFile!=NULL || CL_FlacFile!=NULL) {
+	 if (CL_WavFile!=NULL) {
+	     wavbuf=WavReadChannels(CL_WavFile,&wavinfo,CL_ChannelID[0]-'A',start_time,end_time,
+				     &num_samples);
+	 } else if (CL_FlacFile!=NULL) {
+	     wavbuf=FlacReadChannels(CL_FlacFile,&wavinfo,CL_ChannelID[0]-'A',start_time,end_time,
+				      &num_samples);
+	 } else {
+	     wavinfo.srate = (INT32)string_to_float(CL_RawFormat,1);
+	     wavinfo.channel = (int)string_to_float(CL_RawFormat,2);
+	     wavinfo.bps = (int)string_to_float(CL_RawFormat,3);
+	     wavbuf=RawReadChannels(CL_RawFile,&wavinfo,CL_ChannelID[0]-'A',start_time,end_time,
+				     &num_samples);
+	 }
+	 if (wavbuf==NULL) {
+	     fprintf(stderr,"%s: Error in reading %s\n",argv[0],
+		     CL_WavFile ? CL_WavFile : CL_FlacFile ? CL_FlacFile : CL_RawFile);
+	     exit(EXIT_FAILURE);
+	 }
+	 spbuf = wavbuf[CL_ChannelID[0]-'A'];
+	 free(wavbuf);
+	 sr = wavinfo.srate;
+	 n_ch = wavinfo.channel;
+	 bps = 2;                          /* Samples are converted to 16-bit PCM */
+     } else if (CL_ChannelID[0]!='A' && CL_ChannelID[0]!='B') {
+	 if ((spbuf=read_wav_file_range(CL_SphFile,start_time,end_time,&num_samples,&bps,&n_ch,
+					&sr,&smpcode,CL_ChannelID[0],&errcode))==NULL) {
+	     fprintf(stderr,"%s: Error in reading %s\n",argv[0],CL_SphFile);
+	     exit(EXIT_FAILURE);
+	 }
+     } else {
+	 if ((sphbuf=read_wav_range(CL_SphFile,CL_ChannelID[0]-'A',start_time,end_time,&num_samples,
+				    &bps,&n_ch,&sr,&smpcode,&errcode))==NULL) {
+	     fprintf(stderr,"%s: Error in reading %s\n",argv[0],CL_SphFile);
+	     exit(EXIT_FAILURE);
+	 }
+	 spbuf = sphbuf[CL_ChannelID[0]-'A'];
+	 free(sphbuf);
      }
+     first_smp = SEC2SMP(start_time,sr);
+     prof_end(&prof);
+     prof_set_audio(&prof, num_samples, sr);
 
-     /* Perform spectral subtraction only if spbuf[] contains speech */
-     if (CL_Denoise[0] == 'Y' && zero_crossing(spbuf, num_samples)>0) {
+     /* Scan spbuf[] once for the statistics used by denoise() and detect_silence() */
+     prof_begin(&prof,"signal_summary");
+     signal_summary(spbuf, num_samples, &sigsum);
+     prof_end(&prof);
+
+     /* With -dn A, leave clean speech alone: denoise only if the SNR estimated from a
+	subsample of frames is not above -snr */
+     do_denoise = (CL_Denoise[0] == 'Y' || CL_Denoise[0] == 'S');
+     if (CL_Denoise[0] == 'A' && sigsum.num_sgnchg > 0) {
+	 prof_begin(&prof,"estimate_snr");
+	 snr = estimate_snr(spbuf, num_samples, framesize);
+	 prof_end(&prof);
+	 do_denoise = (snr <= atof(CL_SnrThreshold));
+	 printf("Estimated SNR = %.1f dB, %s\n", snr, do_denoise ? "denoising" : "no denoising");
+     }
+
+     /* Perform spectral subtraction only if spbuf[] contains speech (zero_crossing() > 0) */
+     has_speech = (do_denoise && sigsum.num_sgnchg > 0);
+     if (has_speech) {
 	 printf("Performing denoising\n"); fflush(stdout);
-	 noiseSpec = findnoise(spbuf, num_samples, framesize, BKG_FRAC);
-	 denoiseSph = denoise(spbuf, num_samples, framesize, framesize/4, &numOutSmps,
-			      noiseSpec, alphaMax,alphaMin,betaMax,betaMin);
+	 prof_begin(&prof,"findnoise");
+	 noiseSpec = findnoise_ex(spbuf, num_samples, framesize, BKG_FRAC, 1);
+	 if (CL_Denoise[0] == 'S') {
+	     /* -dn S: denoise only around the frames whose magnitude is near the threshold
+		of detect_silence() on the noisy speech */
+	     prof_begin(&prof,"ambiguous_frames");
+	     prof_add_frames(&prof, NUM_FRAMES(num_samples,sr));
+	     amb = ambiguous_frames(spbuf, num_samples, sr, zcr_factor, avm_factor,
+				    atof(CL_DenoiseMargin), framesize, framesize/4, &sigsum);
+	     prof_begin(&prof,"denoise");
+	     prof_add_frames(&prof, amb->num_sel);
+	     printf("Denoising %lu of %lu frames\n", amb->num_sel, amb->num_dn_frms);
+	     denoiseSph = denoise_sel(spbuf, num_samples, framesize, framesize/4, &numOutSmps,
+				      noiseSpec, alphaMax,alphaMin,betaMax,betaMin,&sigsum,amb->sel);
+	 } else {
+	     prof_begin(&prof,"denoise");
+	     prof_add_frames(&prof, num_samples/(framesize/4)-3);
+	     denoiseSph = denoise_ex(spbuf, num_samples, framesize, framesize/4, &numOutSmps,
+				     noiseSpec, alphaMax,alphaMin,betaMax,betaMin,&sigsum);
+	 }
+	 prof_end(&prof);
+	 free_vector((char *)noiseSpec,0,sizeof(vec_t));
+	 if (denoiseSph==NULL) {
+	     fprintf(stderr,"%s: FFT failed in denoise()\n",argv[0]);
+	     exit(EXIT_FAILURE);
+	 }
 	 if (CL_DenoiseWavFile) {
 	     printf("Writing denoised file %s\n", CL_DenoiseWavFile);
-             wavwrite(denoiseSph, numOutSmps,sr,bps, CL_DenoiseWavFile);
+	     prof_begin(&prof,"write_wav");
+             if (wavwrite(denoiseSph, numOutSmps,sr,bps, CL_DenoiseWavFile)!=0)
+		 exit(EXIT_FAILURE);
+	     prof_end(&prof);
 	 }
      } else {
 	 denoiseSph = spbuf;
@@ -107,7 +241,16 @@ int main(int argc, char *argv[])
 
      /* Determine silence sections */
      printf("Performing speech detection\n"); fflush(stdout);
-     segment=detect_silence((short *)denoiseSph,numOutSmps,sr,zcr_factor,avm_factor,1.0);
+     prof_begin(&prof,"detect_silence");
+     prof_add_frames(&prof, NUM_FRAMES(numOutSmps,sr));
+     if (amb != NULL) {
+	 segment=detect_silence_sel((short *)denoiseSph,numOutSmps,sr,zcr_factor,avm_factor,amb,1.0,1);
+	 free_ambiguous_frames(amb);
+     } else {
+	 segment=detect_silence_ex((short *)denoiseSph,numOutSmps,sr,zcr_factor,avm_factor,1.0,1,
+				   (denoiseSph==spbuf) ? &sigsum : NULL);
+     }
+     prof_end(&prof);
 
      /* A normal speech file should have at least 3 segments: <sil><speech><sil>.
 	If the number of segments is 1, the speech file could be either all silence
@@ -133,9 +276,23 @@ int main(int argc, char *argv[])
     }
 
 
-     /* Save segment information to .phn file */
-     PhnFileWrite(CL_PhnFile,segment);
+     /* Save segment information to .phn file, in sample positions of the whole file */
+     prof_begin(&prof,"write_phn");
+     shift_segments(segment,(long)first_smp);
+     if (PhnFileWrite(CL_PhnFile,segment)!=0)
+	 exit(EXIT_FAILURE);
+     prof_end(&prof);
+     SSVAD_PROBE3(file__end, prof.file, num_samples, segment[0].num_segs);
+
+     if (CL_ProfileFile!=NULL)
+	 prof_write(&prof, CL_ProfileFile);
+     if (CL_TraceFile!=NULL)
+	 prof_write_trace(&prof, CL_TraceFile);
 
+     free_vector((char *)segment,0,sizeof(SEGMENT));
+     if (denoiseSph!=spbuf)
+	 free_vector((char *)denoiseSph,0,sizeof(short));
+     free_vector((char *)spbuf,0,sizeof(short));
      return(0);
 }
 
@@ -48,7 +48,10 @@
 #include "denoise.h"
 #include "findnoise.h"
 #include "winwav.h"
+#include "flac.h"
 #include "rm_crosstalk.h"
+#include "profile.h"
+#include "probes.h"
 
 
 /* Declare global variables here */
@@ -57,7 +60,19 @@ char *CL_PhnFile="default.phn",        /* .phn file for ch A */
      *CL_SphFile="default.sph",	       /* Default .sph filename */
      *CL_ChannelID="A",                /* In case of SPIDRE corpus, the channel to be read */
      *CL_Denoise="Y",                  /* Apply noise reduction before performing speech detection */
+                                       /* (Y, N or A: only if the estimated SNR is not above -snr;
+					  S of sph2phn is not supported) */
+     *CL_SnrThreshold="35",            /* SNR in dB above which -dn A does not denoise */
      *CL_DenoiseWavFile=(char *)NULL,  /* Denoised speech file for output, only if Denoise is Y */
+     *CL_WavFile=(char *)NULL,         /* MS .wav file, read instead of the .sph file */
+     *CL_RawFile=(char *)NULL,         /* Headerless PCM file, read instead of the .sph file */
+     *CL_FlacFile=(char *)NULL,        /* FLAC file, read instead of the .sph file */
+     *CL_StartTime="0",                /* Start of the region to be processed, in sec or [hh:]mm:ss */
+     *CL_EndTime=(char *)NULL,         /* End of the region, NULL for the end of file */
+     *CL_ProfileFile=(char *)NULL,     /* Append per-stage timing as a JSON line to this file ("-" for stdout) */
+     *CL_TraceFile=(char *)NULL,       /* Append Chrome trace events of the stages to this file (not "-") */
+     *CL_PerfCounters="N",             /* Y: add hardware counters (cycles, cache misses, ...) to the profile */
+     *CL_RawFormat="8000,2,16",        /* Sampling rate, no. of channels and bits/sample of raw file */
      *CL_Corpus="nist12",              /* Corpus, if "nist12", "nist12_8k" or "nist12_16k", use post-SRE12 crosstalk rm */
      *CL_AlphaMax="4.0",               /* Hyper-parameters for spectral subtraction algorithm */ 
      *CL_AlphaMin="0.5",
@@ -74,6 +89,16 @@ CLINEPARA options[]=
 	{"-ChannelID", "-ch", &CL_ChannelID},
 	{"-Denoise", "-dn", &CL_Denoise},
 	{"-DenoiseWavFile", "-df", &CL_DenoiseWavFile},
+	{"-SnrThreshold", "-snr", &CL_SnrThreshold},
+	{"-WavFile", "-wav", &CL_WavFile},
+	{"-RawFile", "-raw", &CL_RawFile},
+	{"-RawFormat", "-rf", &CL_RawFormat},
+	{"-FlacFile", "-flac", &CL_FlacFile},
+	{"-StartTime", "-start", &CL_StartTime},
+	{"-EndTime", "-end", &CL_EndTime},
+	{"-ProfileFile", "-profile", &CL_ProfileFile},
+	{"-TraceFile", "-trace", &CL_TraceFile},
+	{"-PerfCounters", "-perf", &CL_PerfCounters},
 	{"-Corpus", "-c", &CL_Corpus},
 	{"-AlphaMax","-amax", &CL_AlphaMax},
 	{"-AlphaMin","-amin", &CL_AlphaMin},
@@ -92,6 +117,8 @@ int main(int argc, char *argv[])
      SP_INTEGER bps;                 /* Byte per samples */
      SP_INTEGER sr;                  /* Sampling rate in Hz */
      unsigned long num_samples;      /* number of samples to be read from audio device */
+     short **spbuf;                  /* buffers storing speech samples of all channels */
+     WAV_INFO wavinfo;               /* format of .wav, .flac or raw file */
      short *spbuf1,*spbuf2;          /* buffer storing speech samples in both channels */
      SEGMENT *seg1,*seg2,*seg3;      /* Structure storing information regarding silence regions
 					seg3[] stores the segmentation (VAD) information after crosstalk removal */
@@ -100,13 +127,19 @@ int main(int argc, char *argv[])
      double zcr_factor;              /* Factor for determining zero crossing threshold */
      double avm_factor;              /* Factor for determining average mag threshold */
      char *smpcode;
+     char *infile;                         // Input file, for the profile and error messages
      short *denoiseSph1,*denoiseSph2;     // Waveform after spectral subtraction */
      unsigned long framesize = FRM_SIZE;  // Frame size of spectral subtraction. Must be power of 2
      unsigned long numOutSmps1;		  // Number of output samples in Channel A. Could be less than numOutSmps
      unsigned long numOutSmps2;		  // Number of output samples in Channel B. Could be less than numOutSmps
      unsigned long numOutSmps;            // The less of numOutSmps1 and numOutSmps2
      vec_t *noiseSpec1,*noiseSpec2;	  // Noise spectrum [0...frameSize-1] for Channels A and B
-     vec_t *denoiseSpec1,*denoiseSpec2;	  // Noise spectrum [0...frameSize-1] after spectral subtraction
+     vec_t *denoiseSpec1=NULL,*denoiseSpec2=NULL; // Noise spectrum [0...frameSize-1] after spectral subtraction
+     double start_time, end_time;         // Region to be processed in sec, end_time<=0 for end of file
+     SIGNAL_SUMMARY sigsum1,sigsum2;      // DC offset, peak and zero crossings of Channels A and B
+     PROFILE prof;                        // Wall and CPU time of each stage
+     int do_denoise;                      // -dn Y, or -dn A and SNR of a channel not above -snr
+     vec_t snr1,snr2;                     // estimate_snr() of Channels A and B for -dn A
 
      vec_t alphaMax = atof(CL_AlphaMax);		   // Parameters for spectral subtraction
      vec_t alphaMin = atof(CL_AlphaMin);		   // with musical noise minimization
@@ -124,48 +157,131 @@ int main(int argc, char *argv[])
      alphaMin = atof(CL_AlphaMin);		   // with musical noise minimization
      betaMax = atof(CL_BetaMax);
      betaMin = atof(CL_BetaMin);
+     start_time = string_to_time(CL_StartTime);
+     end_time = (CL_EndTime!=NULL) ? string_to_time(CL_EndTime) : 0.0;
+     if (CL_TraceFile!=NULL && strcmp(CL_TraceFile,"-")==0) {
+	 fprintf(stderr,"%s: -trace needs a file, the trace cannot go to stdout\n",argv[0]);
+	 exit(EXIT_FAILURE);
+     }
+     if (CL_Denoise[0] == 'S') {
+	 fprintf(stderr,"%s: -dn S is only supported by sph2phn, use Y, N or A\n",argv[0]);
+	 exit(EXIT_FAILURE);
+     }
+     infile = CL_WavFile ? CL_WavFile : CL_FlacFile ? CL_FlacFile : CL_RawFile ? CL_RawFile : CL_SphFile;
+     prof_init(&prof, argv[0], infile, CL_ChannelID[0]);
+     SSVAD_PROBE2(file__start, prof.file, CL_ChannelID[0]);
+     if (CL_PerfCounters[0] == 'Y') {
+	 if (CL_ProfileFile==NULL)
+	     CL_ProfileFile = "-";
+	 prof_open_counters(&prof);
+     }
 
-     /* Read Channel A and Channel B from wave file */
-     if ((spbuf1=read_wav_file(CL_SphFile,&num_samples,&bps,&n_ch,&sr,&smpcode,'A',&errcode))==NULL) {
+     /* Read Channel A and Channel B from wave file in one pass */
+     prof_begin(&prof,"read");
+     if (CL_WavFile!=NULL || CL_RawFile!=NULL || CL_FlacFile!=NULL) {
+	 if (CL_WavFile!=NULL) {
+	     spbuf=WavReadChannels(CL_WavFile,&wavinfo,-1,start_time,end_time,&num_samples);
+	 } else if (CL_FlacFile!=NULL) {
+	     spbuf=FlacReadChannels(CL_FlacFile,&wavinfo,-1,start_time,end_time,&num_samples);
+	 } else {
+	     wavinfo.srate = (INT32)string_to_float(CL_RawFormat,1);
+	     wavinfo.channel = (int)string_to_float(CL_RawFormat,2);
+	     wavinfo.bps = (int)string_to_float(CL_RawFormat,3);
+	     spbuf=RawReadChannels(CL_RawFile,&wavinfo,-1,start_time,end_time,&num_samples);
+	 }
+	 if (spbuf==NULL) {
+	     fprintf(stderr,"%s: Error in reading %s\n",argv[0],infile);
+	     exit(EXIT_FAILURE);
+	 }
+	 sr = wavinfo.srate;
+	 n_ch = wavinfo.channel;
+	 bps = 2;                           /* Samples are converted to 16-bit PCM */
+     } else if ((spbuf=read_wav_range(CL_SphFile,-1,start_time,end_time,&num_samples,
+				      &bps,&n_ch,&sr,&smpcode,&errcode))==NULL) {
 	 fprintf(stderr,"%s: Error in reading %s\n",argv[0],CL_SphFile);
 	 exit(EXIT_FAILURE);
      }
-     if ((spbuf2=read_wav_file(CL_SphFile,&num_samples,&bps,&n_ch,&sr,&smpcode,'B',&errcode))==NULL) {
-	 fprintf(stderr,"%s: Error in reading %s\n",argv[0],CL_SphFile);
+     if (n_ch < 2) {
+	 fprintf(stderr,"%s: %s has only %ld channel\n",argv[0],infile,(long)n_ch);
 	 exit(EXIT_FAILURE);
      }
+     spbuf1 = spbuf[0];
+     spbuf2 = spbuf[1];
+     prof_end(&prof);
+     prof_set_audio(&prof, num_samples, sr);
+
+     /* Scan each channel once for the statistics used by denoise() and detect_silence() */
+     prof_begin(&prof,"signal_summary");
+     signal_summary(spbuf1, num_samples, &sigsum1);
+     signal_summary(spbuf2, num_samples, &sigsum2);
+     prof_end(&prof);
+
+     /* With -dn A, the file is denoised unless the estimated SNR of every channel with
+	speech is above -snr, so that both channels are treated alike for crosstalk removal */
+     do_denoise = (CL_Denoise[0] == 'Y');
+     if (CL_Denoise[0] == 'A') {
+	 prof_begin(&prof,"estimate_snr");
+	 snr1 = (sigsum1.num_sgnchg>0) ? estimate_snr(spbuf1, num_samples, framesize) : HUGE_VAL;
+	 snr2 = (sigsum2.num_sgnchg>0) ? estimate_snr(spbuf2, num_samples, framesize) : HUGE_VAL;
+	 prof_end(&prof);
+	 do_denoise = (snr1 <= atof(CL_SnrThreshold) || snr2 <= atof(CL_SnrThreshold));
+	 printf("Estimated SNR = %.1f dB (channel A), %.1f dB (channel B), %s\n", snr1, snr2,
+		do_denoise ? "denoising" : "no denoising");
+     }
 
      /* Perform spectral subtraction if speech exists. Estimate noise spectrum before and after 
         spectral subtraction */
-     if (CL_Denoise[0] == 'Y') {
-	 if (zero_crossing(spbuf1, num_samples)>0) {
+     if (do_denoise) {
+	 if (sigsum1.num_sgnchg>0) {		// zero_crossing() > 0
 	     printf("Performing denoising on channel A\n"); fflush(stdout);
-	     noiseSpec1 = findnoise(spbuf1, num_samples, framesize, BKG_FRAC);
-	     denoiseSph1 = denoise(spbuf1, num_samples, framesize, framesize/4, &numOutSmps1,
-				   noiseSpec1, alphaMax,alphaMin,betaMax,betaMin);
+	     prof_begin(&prof,"findnoise");
+	     noiseSpec1 = findnoise_ex(spbuf1, num_samples, framesize, BKG_FRAC, 1);
+	     prof_begin(&prof,"denoise");
+	     prof_add_frames(&prof, num_samples/(framesize/4)-3);
+	     denoiseSph1 = denoise_ex(spbuf1, num_samples, framesize, framesize/4, &numOutSmps1,
+				      noiseSpec1, alphaMax,alphaMin,betaMax,betaMin,&sigsum1);
+	     free_vector((char *)noiseSpec1,0,sizeof(vec_t));
+	     if (denoiseSph1==NULL) {
+		 fprintf(stderr,"%s: FFT failed in denoise()\n",argv[0]);
+		 exit(EXIT_FAILURE);
+	     }
+	     prof_begin(&prof,"findnoise");
 	     denoiseSpec1 = findnoise(denoiseSph1, numOutSmps1, framesize, BKG_FRAC);
+	     prof_end(&prof);
 	     printf("Channel A Noise Energy = %f\n",sqrt(VECL2normf(framesize, denoiseSpec1))/framesize);
 	 } else {
 	     denoiseSph1 = spbuf1;
-	     denoiseSpec1 = (vec_t*)calloc(framesize,sizeof(vec_t));
+	     denoiseSpec1 = (vec_t *)vector(0,framesize-1,sizeof(vec_t));
 	     numOutSmps1 = num_samples;
 	 }
-	 if (zero_crossing(spbuf2, num_samples)>0) {
+	 if (sigsum2.num_sgnchg>0) {		// zero_crossing() > 0
 	     printf("Performing denoising on channel B\n"); fflush(stdout);
-	     noiseSpec2 = findnoise(spbuf2, num_samples, framesize, BKG_FRAC);
-	     denoiseSph2 = denoise(spbuf2, num_samples, framesize, framesize/4, &numOutSmps2,
-				   noiseSpec2, alphaMax,alphaMin,betaMax,betaMin);
+	     prof_begin(&prof,"findnoise");
+	     noiseSpec2 = findnoise_ex(spbuf2, num_samples, framesize, BKG_FRAC, 1);
+	     prof_begin(&prof,"denoise");
+	     prof_add_frames(&prof, num_samples/(framesize/4)-3);
+	     denoiseSph2 = denoise_ex(spbuf2, num_samples, framesize, framesize/4, &numOutSmps2,
+				      noiseSpec2, alphaMax,alphaMin,betaMax,betaMin,&sigsum2);
+	     free_vector((char *)noiseSpec2,0,sizeof(vec_t));
+	     if (denoiseSph2==NULL) {
+		 fprintf(stderr,"%s: FFT failed in denoise()\n",argv[0]);
+		 exit(EXIT_FAILURE);
+	     }
+	     prof_begin(&prof,"findnoise");
 	     denoiseSpec2 = findnoise(denoiseSph2, numOutSmps2, framesize, BKG_FRAC);
+	     prof_end(&prof);
 	     printf("Channel B Noise Energy = %f\n",sqrt(VECL2normf(framesize, denoiseSpec2))/framesize);
 	 } else {
 	     denoiseSph2 = spbuf2;
-	     denoiseSpec2 = (vec_t*)calloc(framesize,sizeof(vec_t));
+	     denoiseSpec2 = (vec_t *)vector(0,framesize-1,sizeof(vec_t));
 	     numOutSmps2 = num_samples;
 	 }
 
      } else {
 	 denoiseSph1 = spbuf1;
 	 denoiseSph2 = spbuf2;
+	 denoiseSpec1 = (vec_t *)vector(0,framesize-1,sizeof(vec_t));
+	 denoiseSpec2 = (vec_t *)vector(0,framesize-1,sizeof(vec_t));
 	 numOutSmps1 = num_samples;
 	 numOutSmps2 = num_samples;
      }
@@ -174,25 +290,34 @@ int main(int argc, char *argv[])
 
 
      /* Save denoised waveform as MS wave file */
-     if (CL_Denoise[0] == 'Y' && CL_DenoiseWavFile!=NULL) {
+     if (do_denoise && CL_DenoiseWavFile!=NULL) {
+	 prof_begin(&prof,"write_wav");
 	 if (CL_ChannelID[0] == 'A') {
 	     printf("Writing channel A to denoised WAVE file %s\n", CL_DenoiseWavFile);
-	     wavwrite(denoiseSph1, numOutSmps,sr,bps, CL_DenoiseWavFile);
+	     if (wavwrite(denoiseSph1, numOutSmps,sr,bps, CL_DenoiseWavFile)!=0)
+		 exit(EXIT_FAILURE);
 	 } else {
 	     printf("Writing channel B to denoised WAVE file %s\n", CL_DenoiseWavFile);
-	     wavwrite(denoiseSph2, numOutSmps,sr,bps, CL_DenoiseWavFile);
+	     if (wavwrite(denoiseSph2, numOutSmps,sr,bps, CL_DenoiseWavFile)!=0)
+		 exit(EXIT_FAILURE);
 	 }
+	 prof_end(&prof);
      }
 
      /* Determine silence segments */
      printf("Performing speech detection on channel A\n"); fflush(stdout);
-     seg1=detect_silence((short *)denoiseSph1,numOutSmps,sr,zcr_factor,avm_factor,
-			 sqrt(VECL2normf(framesize, denoiseSpec1))/framesize);
+     prof_begin(&prof,"detect_silence");
+     prof_add_frames(&prof, 2*NUM_FRAMES(numOutSmps,sr));
+     seg1=detect_silence_ex((short *)denoiseSph1,numOutSmps,sr,zcr_factor,avm_factor,
+			    sqrt(VECL2normf(framesize, denoiseSpec1))/framesize,1,
+			    (denoiseSph1==spbuf1) ? &sigsum1 : NULL);
      printf("Performing speech detection on channel B\n"); fflush(stdout);
-     seg2=detect_silence((short *)denoiseSph2,numOutSmps,sr,zcr_factor,avm_factor,
-			 sqrt(VECL2normf(framesize, denoiseSpec2))/framesize);
+     seg2=detect_silence_ex((short *)denoiseSph2,numOutSmps,sr,zcr_factor,avm_factor,
+			    sqrt(VECL2normf(framesize, denoiseSpec2))/framesize,1,
+			    (denoiseSph2==spbuf2) ? &sigsum2 : NULL);
 
      /* Perform crosstalk removal */
+     prof_begin(&prof,"crosstalk");
      if (strcmp(CL_Corpus,"nist12")==0 || strcmp(CL_Corpus,"nist12_8k")==0 || strcmp(CL_Corpus,"nist12_16k")==0) {
 	 printf("Performing SRE12 crosstalk removal\n");
 	 seg3 = remove_crosstalk_SRE12(seg1, seg2, numOutSmps, CL_ChannelID[0]);
@@ -208,16 +333,40 @@ int main(int argc, char *argv[])
 		 seg3 = seg2;                // We want VAD info of ChB
 	 }
      }
+     prof_end(&prof);
      print_seg_info(seg3, sr/FRAME_RATE, numOutSmps);
 
-     /* Save segment information to .phn file */
+     /* Save segment information to .phn file, in sample positions of the whole file */
      printf("Saving segment of Channel %c info to %s\n",CL_ChannelID[0],CL_PhnFile);
-     PhnFileWrite(CL_PhnFile,seg3);
+     prof_begin(&prof,"write_phn");
+     shift_segments(seg3,(long)SEC2SMP(start_time,sr));
+     if (PhnFileWrite(CL_PhnFile,seg3)!=0)
+	 exit(EXIT_FAILURE);
+     prof_end(&prof);
+     SSVAD_PROBE3(file__end, prof.file, num_samples, seg3[0].num_segs);
+
+     if (CL_ProfileFile!=NULL)
+	 prof_write(&prof, CL_ProfileFile);
+     if (CL_TraceFile!=NULL)
+	 prof_write_trace(&prof, CL_TraceFile);
 
      /* Save the crosstalk-removed speech to .sph file */
      //cx_rm_smp = extract_sample(seg3, spbuf1, &numOutSmps);
      //write_wav_file("/tmp/cx_rm_smp.sph",cx_rm_smp,(SP_INTEGER)numOutSmps,(SP_INTEGER)2,(SP_INTEGER)sr);     
 
+     if (seg3!=seg1 && seg3!=seg2)
+	 free_vector((char *)seg3,0,sizeof(SEGMENT));
+     free_vector((char *)seg1,0,sizeof(SEGMENT));
+     free_vector((char *)seg2,0,sizeof(SEGMENT));
+     free_vector((char *)denoiseSpec1,0,sizeof(vec_t));
+     free_vector((char *)denoiseSpec2,0,sizeof(vec_t));
+     if (denoiseSph1!=spbuf1)
+	 free_vector((char *)denoiseSph1,0,sizeof(short));
+     if (denoiseSph2!=spbuf2)
+	 free_vector((char *)denoiseSph2,0,sizeof(short));
+     free_vector((char *)spbuf1,0,sizeof(short));
+     free_vector((char *)spbuf2,0,sizeof(short));
+     free(spbuf);
      return(0);
 }
 
@@ -9,6 +9,17 @@
                          to SP_STRING to read_wav_file() for the parameter sample_coding.
                          Default option for sp_set_data_mod() in read_wav_file() has been
 			 added.
+   Modified: Oct 26. Shorten-compressed files are decoded natively by shorten.c
+                         in a single pass over all channels (read_wav_channels()).
+                         Other codings still go through libsp.
+   Modified: Oct 26. Uncompressed pcm, ulaw and alaw files are also read natively.
+                         G.711 data is expanded by table lookup or SSSE3 straight
+			 into the per-channel sample buffers.
+   Modified: Oct 26. read_wav_range() reads only the samples in a time range. The
+                         native readers seek to the first sample (shorten data is
+			 decoded up to it without being stored); libsp uses sp_seek().
+                         read_wav_file_range() does the same for one channel, also
+			 for the channel IDs read through libsp only.
 */   
 
 #include <stdio.h>
@@ -17,42 +28,407 @@
 #include <sp/sphere.h>
 #include "mmalloc.h"
 #include "sph_io.h"
+#include "shorten.h"
+#include "winwav.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SPH_X86
+#endif
+
+#define SPH_BLKSIZE 1024         /* Samples are returned in multiples of SPH_BLKSIZE */
+#define SPH_CHUNK   32768        /* Number of sample frames per fread() */
+
 
 /*******************************************************************
-   Read the wave file in the PCM-2 or RAW format of the TIMIT database.
-   On success, it returns a short int array containing num_samples samples;
-   otherwise, it return a NULL pointer. It also return an error code if
-   an NULL pointer is returned
-   
-   Error code:
-       -1: if there is an EOF error.
-       -2: file error occured
-       -3: file cannot be opened.
-       -4: error on getting the header field.
+   Parse the NIST_1A header of a SPHERE file without using libsp.
+   On success, it returns 0 and leaves fp positioned at the first
+   byte of sample data; otherwise, it returns SP_GET_HFIELD_ERR.
+   Fields that are absent from the header are set to 0 or "".
+********************************************************************/   
+int read_sph_header(FILE *fp, SPH_HEADER *hdr)
+{
+    char line[1024], name[256], type[16], *val;
+    int  len;
+
+    memset(hdr, 0, sizeof(SPH_HEADER));
+    if (fgets(line, sizeof(line), fp)==NULL || strncmp(line,"NIST_1A",7)!=0)
+	return(SP_GET_HFIELD_ERR);
+    if (fgets(line, sizeof(line), fp)==NULL || (hdr->header_size=atol(line))<=0)
+	return(SP_GET_HFIELD_ERR);
+
+    while (fgets(line, sizeof(line), fp)!=NULL) {
+	if (strncmp(line,"end_head",8)==0) {
+	    if (fseek(fp, hdr->header_size, SEEK_SET)!=0)
+		return(SP_GET_HFIELD_ERR);
+	    return(0);
+	}
+	if (sscanf(line,"%255s %15s",name,type)!=2 || type[0]!='-')
+	    continue;
+	val = strstr(line,type)+strlen(type);
+	if (*val==' ')
+	    val++;
+	if (type[1]=='i') {
+	    if (strcmp(name,"sample_count")==0) hdr->sample_count = atol(val);
+	    else if (strcmp(name,"sample_n_bytes")==0) hdr->sample_n_bytes = atol(val);
+	    else if (strcmp(name,"channel_count")==0) hdr->channel_count = atol(val);
+	    else if (strcmp(name,"sample_rate")==0) hdr->sample_rate = atol(val);
+	} else if (type[1]=='r') {
+	    if (strcmp(name,"sample_rate")==0) hdr->sample_rate = (long)atof(val);
+	} else if (type[1]=='s') {
+	    len = atoi(&type[2]);          /* -sN: string of N characters, may contain spaces */
+	    if (strcmp(name,"sample_coding")==0) {
+		if (len >= (int)sizeof(hdr->sample_coding)) len = sizeof(hdr->sample_coding)-1;
+		strncpy(hdr->sample_coding, val, len);
+		hdr->sample_coding[len] = '\0';
+	    } else if (strcmp(name,"sample_byte_format")==0) {
+		if (len >= (int)sizeof(hdr->sample_byte_format)) len = sizeof(hdr->sample_byte_format)-1;
+		strncpy(hdr->sample_byte_format, val, len);
+		hdr->sample_byte_format[len] = '\0';
+	    }
+	}
+    }
+    return(SP_GET_HFIELD_ERR);
+}
+
+
+/*******************************************************************
+   Map the sample_coding of a SPHERE header to one of the codings that
+   have a native decoder (SPH_PCM, SPH_ULAW, SPH_ALAW, SPH_SHORTEN).
+   Return 0 if the file has to be read by libsp.
+********************************************************************/   
+int sph_coding(SPH_HEADER *hdr)
+{
+    char *coding = hdr->sample_coding;
+
+    if (strstr(coding,"shorten")!=NULL)
+	return (strncmp(coding,"pcm",3)==0) ? SPH_SHORTEN : 0;
+    if (strchr(coding,',')!=NULL)          /* wavpack, shortpack etc. */
+	return 0;
+    if ((strcmp(coding,"pcm")==0 || coding[0]=='\0') && hdr->sample_n_bytes==2)
+	return SPH_PCM;
+    if ((strcmp(coding,"ulaw")==0 || strcmp(coding,"mu-law")==0) && hdr->sample_n_bytes==1)
+	return SPH_ULAW;
+    if (strcmp(coding,"alaw")==0 && hdr->sample_n_bytes==1)
+	return SPH_ALAW;
+    return 0;
+}
+
+
+/*******************************************************************
+   G.711 mu-law and A-law expansion to 16-bit linear PCM. The scalar
+   versions give the same values as libsp's SE-PCM-2 conversion and
+   are used to build the 256-entry lookup tables.
+********************************************************************/   
+static short ulaw2linear(unsigned char u)
+{
+    int t;
+    u = ~u;
+    t = ((u & 0x0F) << 3) + 0x84;
+    t <<= (u & 0x70) >> 4;
+    return (short)((u & 0x80) ? (0x84 - t) : (t - 0x84));
+}
+
+static short alaw2linear(unsigned char a)
+{
+    int t, seg;
+    a ^= 0x55;
+    t = (a & 0x0F) << 4;
+    seg = (a & 0x70) >> 4;
+    if (seg == 0)
+	t += 8;
+    else
+	t = (t + 0x108) << (seg - 1);
+    return (short)((a & 0x80) ? t : -t);
+}
+
+static short ulaw_table[256], alaw_table[256];
+static int g711_tables_ready = 0;
+
+static void init_g711_tables(void)
+{
+    int i;
+    if (g711_tables_ready)
+	return;
+    for (i=0; i<256; i++) {
+	ulaw_table[i] = ulaw2linear((unsigned char)i);
+	alaw_table[i] = alaw2linear((unsigned char)i);
+    }
+    g711_tables_ready = 1;
+}
+
+
+#ifdef SPH_X86
+/*******************************************************************
+   SSSE3 G.711 expansion of 16 samples at a time. The segment number
+   selects 1<<seg from a pshufb table, so that the variable shift of
+   the scalar code becomes a 16-bit multiply.
+********************************************************************/   
+__attribute__((target("ssse3")))
+static void decode_g711_ssse3(const unsigned char *in, short *out, unsigned long n,
+			      int num_channels, int chan, int coding)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i m0f = _mm_set1_epi8(0x0F), m07 = _mm_set1_epi8(0x07), m80 = _mm_set1_epi8((char)0x80);
+    const __m128i upow = _mm_setr_epi8(1,2,4,8,16,32,64,(char)128,1,2,4,8,16,32,64,(char)128);
+    const __m128i apow = _mm_setr_epi8(1,1,2,4,8,16,32,64,1,1,2,4,8,16,32,64);
+    const __m128i even = _mm_setr_epi8(0,2,4,6,8,10,12,14,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i odd  = _mm_setr_epi8(1,3,5,7,9,11,13,15,-1,-1,-1,-1,-1,-1,-1,-1);
+    __m128i v, e, m, s, p, t[2], sel;
+    unsigned long i;
+    int h;
+
+    sel = (chan == 0) ? even : odd;
+    for (i=0; i+16<=n; i+=16) {
+	if (num_channels == 1)
+	    v = _mm_loadu_si128((const __m128i *)&in[i]);
+	else
+	    v = _mm_unpacklo_epi64(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&in[2*i]), sel),
+				   _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&in[2*i+16]), sel));
+	if (coding == SPH_ULAW)
+	    v = _mm_xor_si128(v, _mm_set1_epi8((char)0xFF));
+	else
+	    v = _mm_xor_si128(v, _mm_set1_epi8(0x55));
+	e = _mm_and_si128(_mm_srli_epi16(v, 4), m07);
+	m = _mm_and_si128(v, m0f);
+	s = _mm_and_si128(v, m80);
+	p = _mm_shuffle_epi8((coding == SPH_ULAW) ? upow : apow, e);
+
+	for (h=0; h<2; h++) {
+	    __m128i m16 = h ? _mm_unpackhi_epi8(m, zero) : _mm_unpacklo_epi8(m, zero);
+	    __m128i p16 = h ? _mm_unpackhi_epi8(p, zero) : _mm_unpacklo_epi8(p, zero);
+	    __m128i s16 = h ? _mm_unpackhi_epi8(s, zero) : _mm_unpacklo_epi8(s, zero);
+	    __m128i neg;
+	    if (coding == SPH_ULAW) {
+		/* t = (((m<<3)+0x84)<<e) - 0x84, negative if the sign bit is set */
+		t[h] = _mm_add_epi16(_mm_slli_epi16(m16, 3), _mm_set1_epi16(0x84));
+		t[h] = _mm_sub_epi16(_mm_mullo_epi16(t[h], p16), _mm_set1_epi16(0x84));
+		neg = _mm_cmpeq_epi16(s16, _mm_set1_epi16(0x80));
+	    } else {
+		/* t = (m<<4)+8 if e==0, ((m<<4)+0x108)<<(e-1) otherwise, negative if the sign bit is clear */
+		__m128i e16 = h ? _mm_unpackhi_epi8(e, zero) : _mm_unpacklo_epi8(e, zero);
+		t[h] = _mm_add_epi16(_mm_slli_epi16(m16, 4), _mm_set1_epi16(8));
+		t[h] = _mm_add_epi16(t[h], _mm_andnot_si128(_mm_cmpeq_epi16(e16, zero), _mm_set1_epi16(0x100)));
+		t[h] = _mm_mullo_epi16(t[h], p16);
+		neg = _mm_cmpeq_epi16(s16, zero);
+	    }
+	    t[h] = _mm_sub_epi16(_mm_xor_si128(t[h], neg), neg);
+	}
+	_mm_storeu_si128((__m128i *)&out[i], t[0]);
+	_mm_storeu_si128((__m128i *)&out[i+8], t[1]);
+    }
+    for (; i<n; i++)
+	out[i] = (coding == SPH_ULAW) ? ulaw_table[in[i*num_channels+chan]] : alaw_table[in[i*num_channels+chan]];
+}
+#endif
+
+
+/*******************************************************************
+   Expand channel chan of num_samples interleaved G.711 samples in[]
+   into out[0..num_samples-1]. coding is SPH_ULAW or SPH_ALAW.
+   Mono and 2-channel data use the SSSE3 kernel if the CPU has it;
+   otherwise a table lookup is done per sample.
+********************************************************************/   
+void decode_g711(const unsigned char *in, short *out, unsigned long num_samples,
+		 int num_channels, int chan, int coding)
+{
+    const short *table;
+    unsigned long i;
+
+    init_g711_tables();
+#ifdef SPH_X86
+    if (num_channels <= 2 && __builtin_cpu_supports("ssse3")) {
+	decode_g711_ssse3(in, out, num_samples, num_channels, chan, coding);
+	return;
+    }
+#endif
+    table = (coding == SPH_ULAW) ? ulaw_table : alaw_table;
+    in += chan;
+    for (i=0; i<num_samples; i++, in+=num_channels)
+	out[i] = table[*in];
+}
+
+
+/*******************************************************************
+   Copy channel chan of num_samples interleaved 16-bit samples in[]
+   to out[0..num_samples-1]. big_endian gives the byte order of in[]
+   (sample_byte_format "10"); the samples are put together with
+   shifts, and a mono channel in the byte order of the host is copied
+   as it is.
+********************************************************************/   
+void decode_pcm16(const unsigned char *in, short *out, unsigned long num_samples,
+		  int num_channels, int chan, int big_endian)
+{
+    unsigned long i;
+    const unsigned char *p = in + 2*chan;
+    short one = 1;
+    int host_big_endian = (*(char *)&one != 1);
+
+    if (num_channels == 1 && big_endian == host_big_endian) {
+	memcpy(out, in, num_samples*sizeof(short));
+	return;
+    }
+    for (i=0; i<num_samples; i++, p+=2*num_channels) {
+	if (big_endian)
+	    out[i] = (short)((p[0] << 8) | p[1]);
+	else
+	    out[i] = (short)((p[1] << 8) | p[0]);
+    }
+}
+
+
+/*******************************************************************
+   Read total_samples samples of the uncompressed SPHERE data in fp,
+   chunk by chunk, expanding each kept channel straight into
+   waveform[c]. Return 0 on success, SP_FILE_IO_ERR otherwise.
+********************************************************************/   
+static int read_sph_uncompressed(FILE *fp, SPH_HEADER *hdr, int coding,
+				 short **waveform, unsigned long total_samples)
+{
+    unsigned char *buf;
+    unsigned long pos, n, frame_bytes;
+    int c, big_endian;
+
+    frame_bytes = hdr->channel_count*hdr->sample_n_bytes;
+    /* sample_byte_format "01" is little endian, "10" is big endian */
+    big_endian = (strcmp(hdr->sample_byte_format,"10")==0);
+    buf = (unsigned char *)malloc(SPH_CHUNK*frame_bytes);
+    for (pos=0; pos<total_samples; pos+=n) {
+	n = (total_samples-pos < SPH_CHUNK) ? total_samples-pos : SPH_CHUNK;
+	if (fread(buf,frame_bytes,n,fp)!=n) {
+	    free(buf);
+	    return(SP_FILE_IO_ERR);
+	}
+	for (c=0; c<hdr->channel_count; c++) {
+	    if (waveform[c]==NULL)
+		continue;
+	    if (coding == SPH_PCM)
+		decode_pcm16(buf,&waveform[c][pos],n,hdr->channel_count,c,big_endian);
+	    else
+		decode_g711(buf,&waveform[c][pos],n,hdr->channel_count,c,coding);
+	}
+    }
+    free(buf);
+    return(0);
+}
+
+
+/* Free the channels read so far and the array of them */
+static void free_channels(short **waveform, int num_channels)
+{
+    int c;
+
+    for (c=0; c<num_channels; c++) {
+	if (waveform[c]!=NULL)
+	    free_vector((char *)waveform[c],0,sizeof(short));
+    }
+    free(waveform);
+}
+
+
+/*******************************************************************
+   Read the channels of a SPHERE file without libsp. Uncompressed
+   pcm, ulaw and alaw files and shorten-compressed pcm files are
+   handled; for the other codings, NULL is returned with *err_code
+   set to 0 so that the caller can fall back to libsp.
    
    Input parameters:
-   char *wavefilename: name of the wave file to be read
-   char channel_id: 'A' (channel 1) or 'B' (channel 2)
+   char *wavfilename: name of the wave file to be read
+   int  chan: index of the channel to keep (0 for 'A'), or -1 to keep all
+   double start, end: time range in sec, see read_wav_range()
 
    Output parameters:
-   unsigned long *sample_read: number of sample read
-   int  *err_code: error code to be returned if NULL pointer is returned.
-   SP_INTEGER *byte_per_sample: number of byte per sample
-   SP_INTEGER *num_channels: number of channels in wave file
-   SP_INTEGER *sample_rate: sampling rate in Hz.
+   As read_wav_file(). The returned array has *num_channels entries;
+   the entries of channels that are not kept are NULL.
 ********************************************************************/   
-short *read_wav_file(char *wavfilename, unsigned long *tot_sample_read,
-		     SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
-		     SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
-		     char channel_id, int *err_code)
+static short **read_sph_native(char *wavfilename, int chan, double start, double end,
+			       unsigned long *tot_sample_read,
+			       SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+			       SP_INTEGER *sample_rate, SP_STRING *sample_coding, int *err_code)
+{
+    FILE *fp;
+    SPH_HEADER hdr;
+    SHN_DECODER *shn = (SHN_DECODER *)NULL;
+    short **waveform;
+    unsigned long total_samples, first, last;
+    long c, n;
+    int coding;
+
+    *err_code = 0;
+    if ((fp=fopen(wavfilename,"rb"))==NULL)
+	return((short **)NULL);            /* Let libsp report the error */
+    if (read_sph_header(fp,&hdr)!=0 || hdr.channel_count<1 || hdr.sample_count<1 ||
+	chan>=hdr.channel_count || (coding=sph_coding(&hdr))==0) {
+	fclose(fp);
+	return((short **)NULL);
+    }
+    if (coding==SPH_SHORTEN && ((shn=shn_open(fp))==NULL || shn->nchan!=hdr.channel_count)) {
+	shn_close(shn);
+	fclose(fp);
+	return((short **)NULL);
+    }
+
+    /* Same length as the libsp path, which reads whole blocks of SPH_BLKSIZE samples */
+    first = SEC2SMP(start,hdr.sample_rate);
+    last = (hdr.sample_count/SPH_BLKSIZE)*SPH_BLKSIZE;
+    if (end>0.0 && SEC2SMP(end,hdr.sample_rate)<last)
+	last = SEC2SMP(end,hdr.sample_rate);
+    if (first>=last) {
+	fprintf(stderr,"Error: No samples between %.2f and %.2f sec in %s\n",start,end,wavfilename);
+	shn_close(shn);
+	fclose(fp);
+	*err_code = SP_EOF_ERR;
+	return((short **)NULL);
+    }
+    total_samples = last-first;
+    waveform = (short **)calloc(hdr.channel_count,sizeof(short *));
+    for (c=0; c<hdr.channel_count; c++) {
+	if (chan<0 || c==chan)
+	    waveform[c] = (short *)vector(0,total_samples,sizeof(short));
+    }
+    if (coding==SPH_SHORTEN) {
+	n = shn_decode(shn, waveform, first, total_samples);
+	shn_close(shn);
+    } else if (fseek(fp,(long)(first*hdr.channel_count*hdr.sample_n_bytes),SEEK_CUR)!=0) {
+	n = -1;
+    } else {
+	n = (read_sph_uncompressed(fp,&hdr,coding,waveform,total_samples)==0) ? (long)total_samples : -1;
+    }
+    fclose(fp);
+    if (n<0 || (unsigned long)n<total_samples) {
+	fprintf(stderr,"Error: Corrupted or truncated sample data in %s\n",wavfilename);
+	free_channels(waveform,hdr.channel_count);
+	*err_code = SP_FILE_IO_ERR;
+	return((short **)NULL);
+    }
+
+    *tot_sample_read = total_samples;
+    *byte_per_sample = 2;                  /* Samples are returned as PCM-2 */
+    *num_channels = hdr.channel_count;
+    *sample_rate = hdr.sample_rate;
+    *sample_coding = strdup(hdr.sample_coding);
+    return(waveform);
+}
+
+
+/*******************************************************************
+   Read one channel of a SPHERE file through libsp, from sample
+   SEC2SMP(start) up to SEC2SMP(end) (end<=0 for the end of file).
+   Arguments and error codes as read_wav_file().
+********************************************************************/   
+static short *read_sph_libsp(char *wavfilename, char channel_id, double start, double end,
+			     unsigned long *tot_sample_read,
+			     SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+			     SP_INTEGER *sample_rate, SP_STRING *sample_coding, int *err_code)
 {
     SP_FILE *wavfile;
-    unsigned long total_samples, sample_read, k, i, blksize, num_blks;
+    unsigned long total_samples, sample_read, k, first, last, blksize;
     SP_INTEGER sample_count;
     short *waveform = (short *)NULL;
     int err=0;
  
     *err_code = 0;
+
     //************************************************ 
     //  Open SPHERE wave file
     //************************************************
@@ -118,13 +494,35 @@ short *read_wav_file(char *wavfilename, unsigned long *tot_sample_read,
         return((short *)NULL);
     }
 
+    //******************************************************************* 
+    // Only whole blocks of SPH_BLKSIZE samples are read from a file.
+    // Seek to the first sample of the requested time range.
+    //******************************************************************* 
+    first = SEC2SMP(start,*sample_rate);
+    last = (sample_count/SPH_BLKSIZE)*SPH_BLKSIZE;
+    if (end>0.0 && SEC2SMP(end,*sample_rate)<last)
+	last = SEC2SMP(end,*sample_rate);
+    if (first>=last) {
+	fprintf(stderr,"Error: No samples between %.2f and %.2f sec in %s\n",start,end,wavfilename);
+	*err_code = SP_EOF_ERR;
+	sp_close(wavfile);
+	return((short *)NULL);
+    }
+    if (first>0 && sp_seek(wavfile,(SP_INTEGER)first,0)!=0) {
+	fprintf(stderr,"Error: Unable to seek to sample %lu in %s\n",first,wavfilename);
+	sp_print_return_status(stderr);
+	*err_code = SP_FILE_IO_ERR;
+	sp_close(wavfile);
+	return((short *)NULL);
+    }
+
     //******************************************************************* 
     // Allocate sufficient data for storing samples
     // Note: only need to allocate data for one channel
     // Note: Need to read a block at a time and not to the end of file
     //       for nist02 .sph files
     //******************************************************************* 
-    total_samples = sample_count;
+    total_samples = last-first;
     if ((waveform = (short *)sp_data_alloc(wavfile,total_samples))==(short *)0) {
         fprintf(stderr, "Fetal Error: Unable to allocate memory for storing waveform in %s\n",wavfilename);
 	sp_print_return_status(stderr);
@@ -133,10 +531,8 @@ short *read_wav_file(char *wavfilename, unsigned long *tot_sample_read,
     }
 
     *tot_sample_read = 0;
-    blksize = 1024;
-    num_blks = sample_count/blksize;
-    for (i=0; i<num_blks; i++) {
-	k = i*blksize;
+    for (k=0; k<total_samples; k+=blksize) {
+	blksize = (total_samples-k < SPH_BLKSIZE) ? total_samples-k : SPH_BLKSIZE;
         sample_read = sp_read_data(&waveform[k], blksize, wavfile);
 	*tot_sample_read += sample_read;
     }
@@ -153,6 +549,127 @@ short *read_wav_file(char *wavfilename, unsigned long *tot_sample_read,
     return(waveform);
 }
 
+
+/*******************************************************************
+   Read the wave file in the PCM-2 or RAW format of the TIMIT database.
+   On success, it returns a short int array containing num_samples samples;
+   otherwise, it return a NULL pointer. It also return an error code if
+   an NULL pointer is returned
+   
+   Error code:
+       -1: if there is an EOF error.
+       -2: file error occured
+       -3: file cannot be opened.
+       -4: error on getting the header field.
+   
+   Input parameters:
+   char *wavefilename: name of the wave file to be read
+   char channel_id: 'A' (channel 1) or 'B' (channel 2)
+
+   Output parameters:
+   unsigned long *sample_read: number of sample read
+   int  *err_code: error code to be returned if NULL pointer is returned.
+   SP_INTEGER *byte_per_sample: number of byte per sample
+   SP_INTEGER *num_channels: number of channels in wave file
+   SP_INTEGER *sample_rate: sampling rate in Hz.
+********************************************************************/   
+short *read_wav_file(char *wavfilename, unsigned long *tot_sample_read,
+		     SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+		     SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+		     char channel_id, int *err_code)
+{
+    return(read_wav_file_range(wavfilename,0.0,0.0,tot_sample_read,byte_per_sample,
+			       num_channels,sample_rate,sample_coding,channel_id,err_code));
+}
+
+
+/*******************************************************************
+   As read_wav_file(), but only the samples between start and end sec
+   (end<=0 for the end of file), as read_wav_range(). Channel IDs other
+   than 'A' and 'B' are read through libsp, which seeks to the start.
+********************************************************************/   
+short *read_wav_file_range(char *wavfilename, double start, double end,
+			   unsigned long *tot_sample_read,
+			   SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+			   SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+			   char channel_id, int *err_code)
+{
+    short *waveform;
+    short **channels;
+
+    if (channel_id!='A' && channel_id!='B')
+	return(read_sph_libsp(wavfilename,channel_id,start,end,tot_sample_read,byte_per_sample,
+			      num_channels,sample_rate,sample_coding,err_code));
+
+    channels = read_wav_range(wavfilename,channel_id-'A',start,end,tot_sample_read,byte_per_sample,
+			      num_channels,sample_rate,sample_coding,err_code);
+    if (channels==NULL)
+	return((short *)NULL);
+    waveform = channels[channel_id-'A'];
+    free(channels);
+    return(waveform);
+}
+
+
+/*******************************************************************
+   Read the samples of a SPHERE file between start and end sec (end<=0
+   for the end of file) and return them as an array of *num_channels
+   short int arrays, each containing *sample_read samples. chan is the
+   channel to keep (0 for 'A'), or -1 to keep all; the entries of the
+   other channels are NULL. Files with a native decoder are read in a
+   single pass; the others are read channel by channel through libsp.
+   On failure, it returns a NULL pointer and an error code as
+   read_wav_file().
+********************************************************************/   
+short **read_wav_range(char *wavfilename, int chan, double start, double end,
+		       unsigned long *sample_read,
+		       SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+		       SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+		       int *err_code)
+{
+    short **waveform;
+    int c;
+
+    waveform = read_sph_native(wavfilename,chan,start,end,sample_read,byte_per_sample,
+			       num_channels,sample_rate,sample_coding,err_code);
+    if (waveform!=NULL || *err_code!=0)
+	return(waveform);
+
+    /* No native decoder: let libsp convert one channel at a time */
+    waveform = (short **)calloc(2,sizeof(short *));
+    for (c=0; c<2; c++) {
+	if (chan>=0 && c!=chan)
+	    continue;
+	if ((waveform[c]=read_sph_libsp(wavfilename,'A'+c,start,end,sample_read,byte_per_sample,
+					num_channels,sample_rate,sample_coding,err_code))==NULL) {
+	    free_channels(waveform,2);
+	    return((short **)NULL);
+	}
+    }
+    if (chan<0 && *num_channels!=2) {
+	fprintf(stderr,"Error: %s has %ld channels, only 2-channel files are supported by libsp\n",
+		wavfilename,(long)*num_channels);
+	*err_code = SP_GET_HFIELD_ERR;
+	free_channels(waveform,2);
+	return((short **)NULL);
+    }
+    return(waveform);
+}
+
+
+/*******************************************************************
+   Read all channels of a SPHERE file, see read_wav_range().
+********************************************************************/   
+short **read_wav_channels(char *wavfilename, unsigned long *sample_read,
+			  SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+			  SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+			  int *err_code)
+{
+    return(read_wav_range(wavfilename,-1,0.0,0.0,sample_read,byte_per_sample,
+			  num_channels,sample_rate,sample_coding,err_code));
+}
+
+
 /*******************************************************************
    Write the wave file in the PCM-2 format or in the ORIG format 
    of the TIMIT database.
@@ -179,60 +696,60 @@ long write_wav_file(char *wavfilename, void *sample, SP_INTEGER num_samples,
 
     if ((wavfile = sp_open(wavfilename,"w"))==(SP_FILE *)0){
         fprintf(stderr,"Error: Unable to open SPHERE file %s\n",wavfilename);
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); return(-1);
     }
     if (sp_h_set_field(wavfile,"sample_count",T_INTEGER,&num_samples)>0){
         fprintf(stderr,"Error: Unable to set sample count\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (sp_h_set_field(wavfile,"sample_n_bytes",T_INTEGER,&byte_per_sample)>0){
         fprintf(stderr,"Error: Unable to set sample_n_bytes\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (sp_h_set_field(wavfile,"sample_rate",T_INTEGER,&s_rate)>0){
         fprintf(stderr,"Error: Unable to set sample_rate\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (byte_per_sample==1) {
         if (sp_h_set_field(wavfile,"sample_byte_format",T_STRING,(void *)"1")>0){
             fprintf(stderr,"Error: Unable to set sample_byte_format to 1\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
 	}
         if (sp_h_set_field(wavfile,"sample_coding",T_STRING,(void *)"raw")>0){
 	    fprintf(stderr,"Error: Unable to set sample_coding to raw\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
 	}
     }
     if (byte_per_sample==2) {
         if (sp_h_set_field(wavfile,"sample_byte_format",T_STRING,(void *)"01")>0){
             fprintf(stderr,"Error: Unable to set sample_byte_format to 01\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
 	}
         if (sp_h_set_field(wavfile,"sample_coding",T_STRING,(void *)"pcm")>0){
 	    fprintf(stderr,"Error: Unable to set sample_coding to pcm\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
     }
     if (sp_h_set_field(wavfile,"channel_count",T_INTEGER,&c_count)>0){
         fprintf(stderr,"Error: Unable to set channel_count\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (byte_per_sample==1) {
         if (sp_set_data_mode(wavfile,"SE-ORIG")!=0) {
             fprintf(stderr,"Error: Unable to set data_mode to SE-ORIG\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
     }
     if (byte_per_sample==2) {
         if (sp_set_data_mode(wavfile,"SE-PCM-2")!=0) {
             fprintf(stderr,"Error: Unable to set data_mode to SE-PCM-2\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
     } 
     if (byte_per_sample!=1 && byte_per_sample!=2)
     {
 	fprintf(stderr,"Error: Byte per sample must be either 1 or 2\n");
-	exit(EXIT_FAILURE);
+	sp_close(wavfile); return(-1);
     }
 
     /* Write sample[] to wavfile */
@@ -243,14 +760,14 @@ long write_wav_file(char *wavfilename, void *sample, SP_INTEGER num_samples,
 	status=sp_error(wavfile);
 	sp_print_return_status(stderr);
 	sp_close(wavfile);
-	exit(EXIT_FAILURE);
+	return(-1);
     }
     
     /* Close wavfile */
     if (sp_close(wavfile)!=0) {
         fprintf(stderr,"Unable to close NIST waveform file: %s\n",wavfilename);
 	sp_print_return_status(stderr);
-	exit(EXIT_FAILURE);
+	return(-1);
     }
     return(num_samples);
 }
@@ -282,64 +799,64 @@ long write_2ch_wav_file(char *wavfilename, short **sample, SP_INTEGER num_sample
 
     if ((wavfile = sp_open(wavfilename,"w"))==(SP_FILE *)0){
         fprintf(stderr,"Error: Unable to open SPHERE file %s\n",wavfilename);
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); return(-1);
     }
     if (sp_h_set_field(wavfile,"sample_count",T_INTEGER,&num_samples)>0){
         fprintf(stderr,"Error: Unable to set sample count\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (sp_h_set_field(wavfile,"sample_n_bytes",T_INTEGER,&byte_per_sample)>0){
         fprintf(stderr,"Error: Unable to set sample_n_bytes\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (sp_h_set_field(wavfile,"sample_rate",T_INTEGER,&s_rate)>0){
         fprintf(stderr,"Error: Unable to set sample_rate\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (byte_per_sample==1) {
         if (sp_h_set_field(wavfile,"sample_byte_format",T_STRING,(void *)"1")>0){
             fprintf(stderr,"Error: Unable to set sample_byte_format to 1\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
 	}
         if (sp_h_set_field(wavfile,"sample_coding",T_STRING,(void *)"raw")>0){
 	    fprintf(stderr,"Error: Unable to set sample_coding to raw\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
 	}
     }
     if (byte_per_sample==2) {
         if (sp_h_set_field(wavfile,"sample_byte_format",T_STRING,(void *)"01")>0){
             fprintf(stderr,"Error: Unable to set sample_byte_format to 01\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
 	}
         if (sp_h_set_field(wavfile,"sample_coding",T_STRING,(void *)"pcm")>0){
 	    fprintf(stderr,"Error: Unable to set sample_coding to pcm\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
     }
     if (sp_h_set_field(wavfile,"channel_count",T_INTEGER,&c_count)>0){
         fprintf(stderr,"Error: Unable to set channel_count\n");
-	sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	sp_print_return_status(stderr); sp_close(wavfile); return(-1);
     }
     if (byte_per_sample==1) {
         if (sp_set_data_mode(wavfile,"SE-ORIG")!=0) {
             fprintf(stderr,"Error: Unable to set data_mode to SE-ORIG\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
     }
     if (byte_per_sample==2) {
         if (sp_set_data_mode(wavfile,"SE-PCM-2")!=0) {
             fprintf(stderr,"Error: Unable to set data_mode to SE-PCM-2\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
         if (sp_set_data_mode(wavfile,"DF-ARRAY")!=0) {
             fprintf(stderr,"Error: Unable to set data_mode to DF-ARRAY\n");
-	    sp_print_return_status(stderr); exit(EXIT_FAILURE);
+	    sp_print_return_status(stderr); sp_close(wavfile); return(-1);
         }
     } 
     if (byte_per_sample!=1 && byte_per_sample!=2)
     {
 	fprintf(stderr,"Error: Byte per sample must be either 1 or 2\n");
-	exit(EXIT_FAILURE);
+	sp_close(wavfile); return(-1);
     }
 
     /* Write sample[] to wavfile */
@@ -350,14 +867,14 @@ long write_2ch_wav_file(char *wavfilename, short **sample, SP_INTEGER num_sample
 	status=sp_error(wavfile);
 	sp_print_return_status(stderr);
 	sp_close(wavfile);
-	exit(EXIT_FAILURE);
+	return(-1);
     }
     
     /* Close wavfile */
     if (sp_close(wavfile)!=0) {
         fprintf(stderr,"Unable to close NIST waveform file: %s\n",wavfilename);
 	sp_print_return_status(stderr);
-	exit(EXIT_FAILURE);
+	return(-1);
     }
     return(num_samples);
 }
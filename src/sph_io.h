@@ -8,6 +8,7 @@
 #ifndef __WAVIO_INCLUDE__
 #define __WAVIO_INCLUDE__
 
+#include <stdio.h>
 #ifndef MTRF_ON
 #include <sp/sphere.h>
 #endif
@@ -19,12 +20,53 @@
 #define SP_FILE_OPEN_ERR -3
 #define SP_GET_HFIELD_ERR -4
 
+/* SPHERE header fields needed by the native readers (see read_sph_header) */
+typedef struct {
+	long	header_size;		/* Number of bytes in the header, normally 1024 */
+	long	sample_count;		/* Number of samples per channel */
+	long	sample_n_bytes;		/* Number of bytes per sample in the file */
+	long	channel_count;		/* Number of interleaved channels */
+	long	sample_rate;		/* Sampling rate in Hz */
+	char	sample_coding[64];	/* e.g. "pcm", "ulaw", "pcm,embedded-shorten-v2.00" */
+	char	sample_byte_format[16];	/* "01" (little endian), "10" (big endian) or "1" */
+} SPH_HEADER;
+
+/* Codings with a native decoder, as returned by sph_coding() */
+#define SPH_PCM     1
+#define SPH_ULAW    2
+#define SPH_ALAW    3
+#define SPH_SHORTEN 4
+
+int read_sph_header(FILE *fp, SPH_HEADER *hdr);
+int sph_coding(SPH_HEADER *hdr);
+void decode_g711(const unsigned char *in, short *out, unsigned long num_samples,
+		 int num_channels, int chan, int coding);
+void decode_pcm16(const unsigned char *in, short *out, unsigned long num_samples,
+		  int num_channels, int chan, int big_endian);
+
 
 short *read_wav_file(char *wavfilename, unsigned long *sample_read,
 		     SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
 		     SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
 		     char channel_id, int *err_code);
 
+short *read_wav_file_range(char *wavfilename, double start, double end,
+			   unsigned long *sample_read,
+			   SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+			   SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+			   char channel_id, int *err_code);
+
+short **read_wav_range(char *wavfilename, int chan, double start, double end,
+		       unsigned long *sample_read,
+		       SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+		       SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+		       int *err_code);
+
+short **read_wav_channels(char *wavfilename, unsigned long *sample_read,
+			  SP_INTEGER *byte_per_sample, SP_INTEGER *num_channels,
+			  SP_INTEGER *sample_rate, SP_STRING *sample_coding, 
+			  int *err_code);
+
 
 long write_wav_file(char *wavfilename, void *sample, SP_INTEGER num_samples,
 		    SP_INTEGER byte_per_sample, SP_INTEGER s_rate);
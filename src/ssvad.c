@@ -0,0 +1,389 @@
+/*
+   Filename	:ssvad.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Reentrant context API of SSVAD for embedding (libssvad).
+                 ssvad_process() follows sph2phn.c and ssvad_process_2ch()
+		 follows sph2phn_2ch.c, so that the segments are the same as
+		 those in the .phn files of the two programs. The input is only
+		 read. Because detect_silence() removes the DC offset in place,
+		 a channel that is not denoised is first copied into a scratch
+		 buffer owned by the context.
+		 The scratch memory of findnoise(), denoise(), detect_silence()
+		 and the crosstalk removal is taken from an arena of the context
+		 (see mem_arena_new()) that is reset after each call, so that a
+		 context reused for files of similar length does not call malloc().
+		 Note: the allocation routines of mmalloc.c called by findnoise(),
+		 denoise() and detect_silence() still exit when out of memory.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mmalloc.h"
+#include "segment.h"
+#include "veclib.h"
+#include "silence.h"
+#include "denoise.h"
+#include "findnoise.h"
+#include "rm_crosstalk.h"
+#include "ssvad.h"
+
+#define BKG_FRAC_1CH 0.05		/* BKG_FRAC of sph2phn.c */
+#define BKG_FRAC_2CH 0.1		/* BKG_FRAC of sph2phn_2ch.c */
+
+struct SSVAD {
+	SSVAD_PARAMS	par;
+	short		*work[2];	/* Copy of a channel that is not denoised */
+	unsigned long	work_len[2];	/* Number of samples allocated in work[] */
+	SSVAD_SEGMENT	*seg;		/* Result of the last call [0..num_segs-1] */
+	int		num_segs;
+	int		max_segs;	/* Number of entries allocated in seg[] */
+	unsigned long	num_out_smps;	/* Samples covered by seg[] */
+	MEM_ARENA	*arena;		/* Scratch memory of one call */
+};
+
+
+void ssvad_default_params(SSVAD_PARAMS *par)
+{
+	par->denoise = SSVAD_DENOISE_ON;
+	par->zcr_factor = -1000;
+	par->avm_factor = 0.99;
+	par->alpha_max = 4.0;
+	par->alpha_min = 0.5;
+	par->beta_max = 0.05;
+	par->beta_min = 0.01;
+	par->crosstalk = SSVAD_CROSSTALK_SRE12;
+	par->snr_threshold = SNR_THRESHOLD;
+}
+
+
+SSVAD *ssvad_new(const SSVAD_PARAMS *par)
+{
+	SSVAD *vad;
+
+	if ((vad = (SSVAD *)calloc(1, sizeof(SSVAD))) == NULL)
+	    return NULL;
+	if ((vad->arena = mem_arena_new(0)) == NULL) {
+	    free(vad);
+	    return NULL;
+	}
+	if (par != NULL)
+	    vad->par = *par;
+	else
+	    ssvad_default_params(&vad->par);
+	return vad;
+}
+
+
+/* Change the parameters, keeping the scratch buffers for the next call */
+void ssvad_set_params(SSVAD *vad, const SSVAD_PARAMS *par)
+{
+	if (vad != NULL && par != NULL)
+	    vad->par = *par;
+}
+
+
+void ssvad_free(SSVAD *vad)
+{
+	if (vad == NULL)
+	    return;
+	free(vad->work[0]);
+	free(vad->work[1]);
+	free(vad->seg);
+	mem_arena_free(vad->arena);
+	free(vad);
+}
+
+
+/* Make work[c] hold n samples */
+static int reserve_work(SSVAD *vad, int c, unsigned long n)
+{
+	short *p;
+
+	if (vad->work_len[c] >= n)
+	    return SSVAD_OK;
+	if ((p = (short *)realloc(vad->work[c], n*sizeof(short))) == NULL)
+	    return SSVAD_ERR_MEM;
+	vad->work[c] = p;
+	vad->work_len[c] = n;
+	return SSVAD_OK;
+}
+
+
+/* Copy the segments of detect_silence() or remove_crosstalk_*() to vad->seg[] */
+static int store_segments(SSVAD *vad, SEGMENT *seg, unsigned long num_out_smps)
+{
+	SSVAD_SEGMENT *p;
+	int s, num_segs = seg[0].num_segs;
+
+	if (num_segs > vad->max_segs) {
+	    if ((p = (SSVAD_SEGMENT *)realloc(vad->seg, num_segs*sizeof(SSVAD_SEGMENT))) == NULL)
+		return SSVAD_ERR_MEM;
+	    vad->seg = p;
+	    vad->max_segs = num_segs;
+	}
+	for (s=0; s<num_segs; s++) {
+	    vad->seg[s].begin = seg[s].begin;
+	    vad->seg[s].end = seg[s].end;
+	    vad->seg[s].speech = (strcmp(seg[s].phoneme,"S") == 0);
+	}
+	vad->num_segs = num_segs;
+	vad->num_out_smps = num_out_smps;
+	return SSVAD_OK;
+}
+
+
+static int check_args(SSVAD *vad, unsigned long num_samples, int sample_rate)
+{
+	if (vad == NULL || sample_rate < FRAME_RATE)
+	    return SSVAD_ERR_ARG;
+	if (num_samples < 4*SSVAD_FRAME_SIZE ||
+	    num_samples < (unsigned long)(BACKGROUND_PERIOD*sample_rate))
+	    return SSVAD_ERR_ARG;
+	return SSVAD_OK;
+}
+
+
+/*
+   Whether x[0..num_samples-1] with signal_summary() *sum is to be denoised, as in sph2phn.c:
+   never if it has no speech (zero_crossing() = 0), and with SSVAD_DENOISE_AUTO only if
+   its estimate_snr() is not above snr_threshold.
+*/
+static int want_denoise(const SSVAD_PARAMS *par, const short *x, unsigned long num_samples,
+			const SIGNAL_SUMMARY *sum)
+{
+	if (par->denoise == SSVAD_DENOISE_OFF || sum->num_sgnchg == 0)
+	    return 0;
+	if (par->denoise == SSVAD_DENOISE_AUTO)
+	    return (estimate_snr(x, num_samples, SSVAD_FRAME_SIZE) <= par->snr_threshold);
+	return 1;
+}
+
+
+/*
+   Spectral subtraction of x[0..num_samples-1] if dn is not 0, as in sph2phn.c.
+   On return, *y is either a buffer allocated by denoise() or, if x is not denoised, a copy
+   of x in work[c]. If noise_energy is not NULL, it receives the noise energy of the
+   denoised signal for crosstalk removal. *sum is the signal_summary() of x, which is
+   also that of *y if x is not denoised.
+*/
+static int denoise_channel(SSVAD *vad, const short *x, unsigned long num_samples, int c,
+			   int dn, vec_t bkg_frac, short **y, unsigned long *num_out_smps,
+			   vec_t *noise_energy, const SIGNAL_SUMMARY *sum)
+{
+	vec_t *noiseSpec;
+	SSVAD_PARAMS *par = &vad->par;
+	int err;
+
+	*y = NULL;
+	*num_out_smps = num_samples;
+	if (noise_energy != NULL)
+	    *noise_energy = 0.0;
+	if (!dn) {
+	    if ((err = reserve_work(vad, c, num_samples)) != SSVAD_OK)
+		return err;
+	    memcpy(vad->work[c], x, num_samples*sizeof(short));
+	    *y = vad->work[c];
+	    return SSVAD_OK;
+	}
+
+	if ((noiseSpec = findnoise_ex(x, num_samples, SSVAD_FRAME_SIZE, bkg_frac, 1)) == NULL)
+	    return SSVAD_ERR_FFT;
+	*y = denoise_ex(x, num_samples, SSVAD_FRAME_SIZE, SSVAD_FRAME_SIZE/4, num_out_smps, noiseSpec,
+			par->alpha_max, par->alpha_min, par->beta_max, par->beta_min, sum);
+	free_vector((char *)noiseSpec,0,sizeof(vec_t));
+	if (*y == NULL)
+	    return SSVAD_ERR_FFT;
+	if (noise_energy != NULL) {
+	    if ((noiseSpec = findnoise(*y, *num_out_smps, SSVAD_FRAME_SIZE, bkg_frac)) == NULL)
+		return SSVAD_ERR_FFT;
+	    *noise_energy = sqrt(VECL2normf(SSVAD_FRAME_SIZE, noiseSpec))/SSVAD_FRAME_SIZE;
+	    free_vector((char *)noiseSpec,0,sizeof(vec_t));
+	}
+	return SSVAD_OK;
+}
+
+
+/*
+   VAD of the mono signal x[0..num_samples-1] sampled at sample_rate Hz.
+   The segments are available from ssvad_segments() until the next call.
+*/
+int ssvad_process(SSVAD *vad, const short *x, unsigned long num_samples, int sample_rate)
+{
+	short *y;
+	unsigned long numOutSmps;
+	SIGNAL_SUMMARY sum;
+	SEGMENT *segment;
+	MEM_ARENA *prev;
+	int s, num_sph_segs, err;
+
+	if ((err = check_args(vad, num_samples, sample_rate)) != SSVAD_OK || x == NULL)
+	    return (err != SSVAD_OK) ? err : SSVAD_ERR_ARG;
+	vad->num_segs = 0;
+	prev = mem_arena_use(vad->arena);
+	/* signal_summary() only reads x */
+	signal_summary((short *)x, num_samples, &sum);
+	err = denoise_channel(vad, x, num_samples, 0, want_denoise(&vad->par, x, num_samples, &sum),
+			      BKG_FRAC_1CH, &y, &numOutSmps, NULL, &sum);
+	if (err != SSVAD_OK)
+	    goto done;
+
+	segment = detect_silence_ex(y, numOutSmps, sample_rate, vad->par.zcr_factor,
+				    vad->par.avm_factor, 1.0, 0, (y == vad->work[0]) ? &sum : NULL);
+
+	/* If there is no speech segment, artificially assign one speech segment and the
+	   following silence segment, as in sph2phn.c */
+	num_sph_segs = 0;
+	for (s=0; s<segment[0].num_segs; s++) {
+	    if (strcmp(segment[s].phoneme,"S") == 0)
+		num_sph_segs++;
+	}
+	if (num_sph_segs == 0) {
+	    segment[0].num_segs = 2;
+	    segment[0].begin = 0;
+	    segment[0].end = SSVAD_FRAME_SIZE;
+	    strcpy(segment[0].phoneme,"S");
+	    segment[1].num_segs = 2;
+	    segment[1].begin = segment[0].end;
+	    segment[1].end = numOutSmps-1;
+	    strcpy(segment[1].phoneme,"h#");
+	}
+	err = store_segments(vad, segment, numOutSmps);
+	free_vector((char *)segment,0,sizeof(SEGMENT));
+
+done:
+	if (y != NULL && y != vad->work[0])
+	    free_vector((char *)y,0,sizeof(short));
+	mem_arena_use(prev);
+	mem_arena_reset(vad->arena);
+	return err;
+}
+
+
+/*
+   VAD of channel ('A' or 'B') of a two-channel recording a[], b[] with crosstalk
+   removal given by the crosstalk parameter, as in sph2phn_2ch.c.
+*/
+int ssvad_process_2ch(SSVAD *vad, const short *a, const short *b, unsigned long num_samples,
+		      int sample_rate, char channel)
+{
+	short *y[2] = {NULL, NULL};
+	unsigned long numOutSmps[2], numOutSmps_min;
+	vec_t noise_energy[2];
+	SIGNAL_SUMMARY sum[2];
+	SEGMENT *seg1, *seg2, *seg3;
+	MEM_ARENA *prev;
+	int c, dn, err;
+
+	if ((err = check_args(vad, num_samples, sample_rate)) != SSVAD_OK)
+	    return err;
+	if (a == NULL || b == NULL || (channel != 'A' && channel != 'B'))
+	    return SSVAD_ERR_ARG;
+	vad->num_segs = 0;
+	prev = mem_arena_use(vad->arena);
+	/* Both channels with speech are denoised if one of them is to be, as in sph2phn_2ch.c */
+	signal_summary((short *)a, num_samples, &sum[0]);
+	signal_summary((short *)b, num_samples, &sum[1]);
+	dn = want_denoise(&vad->par, a, num_samples, &sum[0]) ||
+	     want_denoise(&vad->par, b, num_samples, &sum[1]);
+	for (c=0; c<2; c++) {
+	    err = denoise_channel(vad, (c == 0) ? a : b, num_samples, c, dn && sum[c].num_sgnchg > 0,
+				  BKG_FRAC_2CH, &y[c], &numOutSmps[c], &noise_energy[c], &sum[c]);
+	    if (err != SSVAD_OK)
+		goto done;
+	}
+	/* Spectral subtraction may truncate speech samples at the end of file */
+	numOutSmps_min = (numOutSmps[0] < numOutSmps[1]) ? numOutSmps[0] : numOutSmps[1];
+
+	/* detect_silence_ex() ignores a summary whose num_samples is not numOutSmps_min */
+	seg1 = detect_silence_ex(y[0], numOutSmps_min, sample_rate, vad->par.zcr_factor,
+				 vad->par.avm_factor, noise_energy[0], 0,
+				 (y[0] == vad->work[0]) ? &sum[0] : NULL);
+	seg2 = detect_silence_ex(y[1], numOutSmps_min, sample_rate, vad->par.zcr_factor,
+				 vad->par.avm_factor, noise_energy[1], 0,
+				 (y[1] == vad->work[1]) ? &sum[1] : NULL);
+	switch (vad->par.crosstalk) {
+	case SSVAD_CROSSTALK_SRE12:
+	    seg3 = remove_crosstalk_SRE12_ex(seg1, seg2, numOutSmps_min, channel, 0);
+	    break;
+	case SSVAD_CROSSTALK_SRE10:
+	    seg3 = remove_crosstalk_SRE10_ex(seg1, seg2, numOutSmps_min, channel, 0);
+	    break;
+	default:
+	    seg3 = (channel == 'A') ? seg1 : seg2;
+	    break;
+	}
+	err = store_segments(vad, seg3, numOutSmps_min);
+	if (seg3 != seg1 && seg3 != seg2)
+	    free_vector((char *)seg3,0,sizeof(SEGMENT));
+	free_vector((char *)seg1,0,sizeof(SEGMENT));
+	free_vector((char *)seg2,0,sizeof(SEGMENT));
+
+done:
+	for (c=0; c<2; c++) {
+	    if (y[c] != NULL && y[c] != vad->work[c])
+		free_vector((char *)y[c],0,sizeof(short));
+	}
+	mem_arena_use(prev);
+	mem_arena_reset(vad->arena);
+	return err;
+}
+
+
+int ssvad_num_segments(const SSVAD *vad)
+{
+	return (vad != NULL) ? vad->num_segs : 0;
+}
+
+
+const SSVAD_SEGMENT *ssvad_segments(const SSVAD *vad)
+{
+	return (vad != NULL) ? vad->seg : NULL;
+}
+
+
+/* Number of samples covered by the segments (denoising may drop the last few) */
+unsigned long ssvad_num_out_samples(const SSVAD *vad)
+{
+	return (vad != NULL) ? vad->num_out_smps : 0;
+}
+
+
+/*
+   Write the segments of the last call to a .phn file in the format of PhnFileWrite(),
+   with offset added to the sample positions (cf. -start of sph2phn)
+*/
+int ssvad_write_phn(const SSVAD *vad, const char *phnfile, long offset)
+{
+	FILE *fp;
+	int s, err = SSVAD_OK;
+
+	if (vad == NULL || phnfile == NULL || vad->num_segs == 0)
+	    return SSVAD_ERR_ARG;
+	if ((fp = fopen(phnfile, "w")) == NULL)
+	    return SSVAD_ERR_IO;
+	for (s=0; s<vad->num_segs; s++) {
+	    if (fprintf(fp, "%ld %ld %s\n", vad->seg[s].begin+offset, vad->seg[s].end+offset,
+			vad->seg[s].speech ? "S" : "h#") < 0)
+		err = SSVAD_ERR_IO;
+	}
+	if (fclose(fp) != 0)
+	    err = SSVAD_ERR_IO;
+	return err;
+}
+
+
+const char *ssvad_strerror(int err)
+{
+	switch (err) {
+	case SSVAD_OK:		return "Success";
+	case SSVAD_ERR_ARG:	return "Invalid argument";
+	case SSVAD_ERR_MEM:	return "Out of memory";
+	case SSVAD_ERR_FFT:	return "FFT failed";
+	case SSVAD_ERR_IO:	return "Unable to write file";
+	default:		return "Unknown error";
+	}
+}
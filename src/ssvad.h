@@ -0,0 +1,88 @@
+/*
+   Filename	:ssvad.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Embeddable interface of SSVAD (libssvad.a, libssvad.so).
+                 All state lives in an opaque SSVAD context created by ssvad_new().
+		 The functions return an SSVAD_ERR_* code instead of exiting and
+		 print nothing. Different contexts can be used by different
+		 threads at the same time; a single context must not be shared
+		 by threads without locking.
+
+		 Example:
+		   SSVAD_PARAMS par;
+		   SSVAD *vad;
+		   ssvad_default_params(&par);
+		   vad = ssvad_new(&par);
+		   if (ssvad_process(vad, samples, num_samples, 8000) == SSVAD_OK)
+		       for (i=0; i<ssvad_num_segments(vad); i++)
+		           ... ssvad_segments(vad)[i].begin, .end, .speech ...
+		   ssvad_free(vad);
+*/
+
+#ifndef __SSVAD_INCLUDE__
+#define __SSVAD_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Error codes */
+#define SSVAD_OK	 0
+#define SSVAD_ERR_ARG	-1		/* Invalid argument, e.g. signal too short */
+#define SSVAD_ERR_MEM	-2		/* Out of memory */
+#define SSVAD_ERR_FFT	-3		/* FFT failed in findnoise() or denoise() */
+#define SSVAD_ERR_IO	-4		/* Unable to write the .phn file */
+
+/* Crosstalk removal of ssvad_process_2ch(), see rm_crosstalk.c */
+#define SSVAD_CROSSTALK_NONE	0	/* Pre-SRE10, use the VAD of the channel alone */
+#define SSVAD_CROSSTALK_SRE10	1
+#define SSVAD_CROSSTALK_SRE12	2
+
+#define SSVAD_FRAME_SIZE 512		/* Frame size of spectral subtraction */
+
+/* SSVAD_PARAMS.denoise */
+#define SSVAD_DENOISE_OFF	0	/* sph2phn -dn N */
+#define SSVAD_DENOISE_ON	1	/* -dn Y */
+#define SSVAD_DENOISE_AUTO	2	/* -dn A, only if the estimated SNR is not above snr_threshold */
+
+typedef struct {
+	int	denoise;		/* Spectral subtraction before VAD, SSVAD_DENOISE_* (-dn) */
+	double	zcr_factor;		/* Zero-crossing threshold factor, <0 not used (-zf) */
+	double	avm_factor;		/* Average magnitude threshold factor (-af) */
+	double	alpha_max, alpha_min;	/* Spectral subtraction parameters (-amax, -amin) */
+	double	beta_max, beta_min;	/* (-bmax, -bmin) */
+	int	crosstalk;		/* SSVAD_CROSSTALK_*, for ssvad_process_2ch() (-c) */
+	double	snr_threshold;		/* SNR in dB of SSVAD_DENOISE_AUTO (-snr) */
+} SSVAD_PARAMS;
+
+typedef struct {
+	long	begin;			/* First sample of the segment */
+	long	end;			/* End sample, as written to the .phn file */
+	int	speech;			/* 1 for speech ("S"), 0 for non-speech ("h#") */
+} SSVAD_SEGMENT;
+
+typedef struct SSVAD SSVAD;
+
+void ssvad_default_params(SSVAD_PARAMS *par);
+SSVAD *ssvad_new(const SSVAD_PARAMS *par);
+void ssvad_free(SSVAD *vad);
+void ssvad_set_params(SSVAD *vad, const SSVAD_PARAMS *par);
+
+int ssvad_process(SSVAD *vad, const short *x, unsigned long num_samples, int sample_rate);
+int ssvad_process_2ch(SSVAD *vad, const short *a, const short *b, unsigned long num_samples,
+		      int sample_rate, char channel);
+
+int ssvad_num_segments(const SSVAD *vad);
+const SSVAD_SEGMENT *ssvad_segments(const SSVAD *vad);
+unsigned long ssvad_num_out_samples(const SSVAD *vad);
+int ssvad_write_phn(const SSVAD *vad, const char *phnfile, long offset);
+
+const char *ssvad_strerror(int err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
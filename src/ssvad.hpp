@@ -0,0 +1,179 @@
+/*
+   Filename	:ssvad.hpp
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:C++17 interface of libssvad (header only, link with libssvad).
+                 ssvad::Detector owns an SSVAD context and ssvad::Segments owns
+		 the result; both are move-only. Samples are passed as
+		 span<const int16_t> and are not copied by the interface.
+		 Errors are thrown as ssvad::error. The overloads taking a
+		 Segments& reuse its storage, so that a Detector processing
+		 files of similar length does not grow any buffer of its own.
+
+		 Example:
+		   ssvad::Detector vad;
+		   ssvad::Segments seg = vad.process(samples, 8000);
+		   for (const auto &s : seg)
+		       if (s.speech) ... s.begin, s.end ...
+*/
+
+#ifndef __SSVAD_HPP_INCLUDE__
+#define __SSVAD_HPP_INCLUDE__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define SSVAD_HAVE_STD_SPAN 1
+#endif
+#endif
+#include "ssvad.h"
+
+namespace ssvad {
+
+static_assert(sizeof(short) == sizeof(std::int16_t), "libssvad takes 16-bit short samples");
+
+#ifdef SSVAD_HAVE_STD_SPAN
+using std::span;
+#else
+/* Read-only view of contiguous samples, the subset of std::span (C++20) used here */
+template <class T>
+class span {
+public:
+	constexpr span() noexcept : data_(nullptr), size_(0) {}
+	constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+	template <class C, class = decltype(std::declval<C &>().data())>
+	constexpr span(C &c) noexcept : data_(c.data()), size_(c.size()) {}
+	template <std::size_t N>
+	constexpr span(T (&a)[N]) noexcept : data_(a), size_(N) {}
+	constexpr T *data() const noexcept { return data_; }
+	constexpr std::size_t size() const noexcept { return size_; }
+	constexpr bool empty() const noexcept { return size_ == 0; }
+	constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+	constexpr T *begin() const noexcept { return data_; }
+	constexpr T *end() const noexcept { return data_ + size_; }
+private:
+	T *data_;
+	std::size_t size_;
+};
+#endif
+
+using Params = SSVAD_PARAMS;
+using Segment = SSVAD_SEGMENT;
+
+class error : public std::runtime_error {
+public:
+	explicit error(int code) : std::runtime_error(ssvad_strerror(code)), code_(code) {}
+	int code() const noexcept { return code_; }
+private:
+	int code_;
+};
+
+/* Segments of one call, in the sample positions of the input */
+class Segments {
+public:
+	Segments() = default;
+	Segments(Segments &&) noexcept = default;
+	Segments &operator=(Segments &&) noexcept = default;
+	Segments(const Segments &) = delete;
+	Segments &operator=(const Segments &) = delete;
+
+	std::size_t size() const noexcept { return seg_.size(); }
+	bool empty() const noexcept { return seg_.empty(); }
+	const Segment &operator[](std::size_t i) const noexcept { return seg_[i]; }
+	const Segment *begin() const noexcept { return seg_.data(); }
+	const Segment *end() const noexcept { return seg_.data() + seg_.size(); }
+
+	/* Samples covered by the segments (denoising may drop the last few) */
+	unsigned long num_out_samples() const noexcept { return num_out_smps_; }
+
+private:
+	friend class Detector;
+	std::vector<Segment> seg_;
+	unsigned long num_out_smps_ = 0;
+};
+
+class Detector {
+public:
+	static Params default_params() noexcept
+	{
+		Params par;
+		ssvad_default_params(&par);
+		return par;
+	}
+
+	explicit Detector(const Params &par = default_params()) : vad_(ssvad_new(&par))
+	{
+		if (!vad_)
+			throw std::bad_alloc();
+	}
+
+	void set_params(const Params &par) noexcept { ssvad_set_params(vad_.get(), &par); }
+
+	/* VAD of a mono signal, as sph2phn */
+	void process(span<const std::int16_t> x, int sample_rate, Segments &out)
+	{
+		check(ssvad_process(vad_.get(), reinterpret_cast<const short *>(x.data()), x.size(),
+				    sample_rate));
+		fill(out);
+	}
+
+	Segments process(span<const std::int16_t> x, int sample_rate)
+	{
+		Segments out;
+		process(x, sample_rate, out);
+		return out;
+	}
+
+	/* VAD of channel 'A' or 'B' of a two-channel recording, as sph2phn_2ch */
+	void process_2ch(span<const std::int16_t> a, span<const std::int16_t> b, int sample_rate,
+			 char channel, Segments &out)
+	{
+		if (a.size() != b.size())
+			throw error(SSVAD_ERR_ARG);
+		check(ssvad_process_2ch(vad_.get(), reinterpret_cast<const short *>(a.data()),
+					reinterpret_cast<const short *>(b.data()), a.size(),
+					sample_rate, channel));
+		fill(out);
+	}
+
+	Segments process_2ch(span<const std::int16_t> a, span<const std::int16_t> b, int sample_rate,
+			     char channel)
+	{
+		Segments out;
+		process_2ch(a, b, sample_rate, channel, out);
+		return out;
+	}
+
+	SSVAD *get() const noexcept { return vad_.get(); }
+
+private:
+	struct Deleter {
+		void operator()(SSVAD *vad) const noexcept { ssvad_free(vad); }
+	};
+
+	static void check(int err)
+	{
+		if (err != SSVAD_OK)
+			throw error(err);
+	}
+
+	void fill(Segments &out) const
+	{
+		const Segment *seg = ssvad_segments(vad_.get());
+		out.seg_.assign(seg, seg + ssvad_num_segments(vad_.get()));
+		out.num_out_smps_ = ssvad_num_out_samples(vad_.get());
+	}
+
+	std::unique_ptr<SSVAD, Deleter> vad_;
+};
+
+} // namespace ssvad
+
+#endif
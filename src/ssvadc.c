@@ -0,0 +1,210 @@
+/* Filename	:ssvadc.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :Client of ssvadd. Takes the options of sph2phn (or of
+                 sph2phn_2ch with -2ch Y), sends the request to the daemon
+		 and writes the segments to the .phn file, so that scripts
+		 can replace sph2phn by ssvadc. SPHERE, WAVE and FLAC files
+		 are read by the daemon; a raw file (16-bit only, "-" for
+		 stdin) is sent as PCM samples. See ssvadd.c for the protocol.
+
+   Example      :ssvadd &
+		 ssvadc -sph ../examples/eslnc.sph -ch A -phn eslnc_A.phn
+		 ssvadc -sph ../examples/idcfvk_sre12.sph -ch B -2ch Y -phn idcfvk_B.phn
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "cmdline.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_Socket="/tmp/ssvad.sock",	/* Unix domain socket of ssvadd */
+     *CL_PhnFile="default.phn",		/* Output .phn file */
+     *CL_SphFile=(char *)NULL,		/* SPHERE file */
+     *CL_WavFile=(char *)NULL,		/* MS .wav file */
+     *CL_FlacFile=(char *)NULL,		/* FLAC file */
+     *CL_RawFile=(char *)NULL,		/* Headerless 16-bit PCM file, sent as samples */
+     *CL_RawFormat="8000,1,16",		/* Sampling rate, no. of channels and bits/sample of raw file */
+     *CL_ChannelID="A",
+     *CL_TwoChannel="N",		/* Y: crosstalk removal as sph2phn_2ch */
+     *CL_Denoise="Y",			/* Y, N or A (only if the estimated SNR is not above -snr), not S */
+     *CL_SnrThreshold="35",
+     *CL_Corpus="nist12",
+     *CL_AlphaMax="4.0",
+     *CL_AlphaMin="0.5",
+     *CL_BetaMax="0.05",
+     *CL_BetaMin="0.01",
+     *CL_ZcrFactor="-1000",
+     *CL_AvmFactor="0.99",
+     *CL_StartTime="0",
+     *CL_EndTime=(char *)NULL;
+
+CLINEPARA options[]=
+{
+    {"-Socket", "-socket", &CL_Socket},
+    {"-PhnFile", "-phn", &CL_PhnFile},
+    {"-SphFile", "-sph", &CL_SphFile},
+    {"-WavFile", "-wav", &CL_WavFile},
+    {"-FlacFile", "-flac", &CL_FlacFile},
+    {"-RawFile", "-raw", &CL_RawFile},
+    {"-RawFormat", "-rf", &CL_RawFormat},
+    {"-ChannelID", "-ch", &CL_ChannelID},
+    {"-TwoChannel", "-2ch", &CL_TwoChannel},
+    {"-Denoise", "-dn", &CL_Denoise},
+    {"-SnrThreshold", "-snr", &CL_SnrThreshold},
+    {"-Corpus", "-c", &CL_Corpus},
+    {"-AlphaMax","-amax", &CL_AlphaMax},
+    {"-AlphaMin","-amin", &CL_AlphaMin},
+    {"-BetaMax","-bmax", &CL_BetaMax},
+    {"-BetaMin","-bmin", &CL_BetaMin},
+    {"-ZeroCrossingFactor", "-zf", &CL_ZcrFactor},
+    {"-AverageAmplitudeFactor", "-af", &CL_AvmFactor},
+    {"-StartTime", "-start", &CL_StartTime},
+    {"-EndTime", "-end", &CL_EndTime}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define MAX_LINE 4096
+
+
+/* Read the whole raw file (or stdin) into memory */
+static unsigned char *read_raw(char *file, unsigned long *size)
+{
+    FILE *fp;
+    unsigned char *buf = NULL, *p;
+    unsigned long n = 0, cap = 0;
+    size_t k;
+
+    if ((fp = (strcmp(file,"-") == 0) ? stdin : fopen(file, "rb")) == NULL)
+	return NULL;
+    do {
+	if (n == cap) {
+	    cap = (cap == 0) ? 1 << 20 : 2*cap;
+	    if ((p = (unsigned char *)realloc(buf, cap)) == NULL) {
+		free(buf);
+		return NULL;
+	    }
+	    buf = p;
+	}
+	k = fread(buf+n, 1, cap-n, fp);
+	n += k;
+    } while (k > 0);
+    if (fp != stdin)
+	fclose(fp);
+    *size = n;
+    return buf;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_un addr;
+    FILE *in, *out, *phn;
+    char line[MAX_LINE], path[PATH_MAX], *file;
+    unsigned char *raw = NULL;
+    unsigned long raw_size = 0, frames = 0;
+    int fd, sr = 0, nch = 0, bits, num_segs, s;
+
+    if (argc==1)
+	usage(argv[0],num_options,options);
+    get_cmdline(argc, argv, num_options, options);
+    if (CL_Denoise[0] == 'S') {
+	fprintf(stderr,"%s: -dn S is only supported by sph2phn, use Y, N or A\n",argv[0]);
+	exit(EXIT_FAILURE);
+    }
+
+    file = CL_WavFile ? CL_WavFile : CL_FlacFile ? CL_FlacFile : CL_SphFile;
+    if (CL_RawFile != NULL) {
+	sr = (int)string_to_float(CL_RawFormat,1);
+	nch = (int)string_to_float(CL_RawFormat,2);
+	bits = (int)string_to_float(CL_RawFormat,3);
+	if (bits != 16 || nch < 1) {
+	    fprintf(stderr,"%s: only 16-bit raw files can be sent\n",argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+	if ((raw = read_raw(CL_RawFile, &raw_size)) == NULL) {
+	    fprintf(stderr,"%s: Error in reading %s\n",argv[0],CL_RawFile);
+	    exit(EXIT_FAILURE);
+	}
+	frames = raw_size/(2*nch);
+    } else if (file == NULL) {
+	fprintf(stderr,"%s: one of -sph, -wav, -flac and -raw is needed\n",argv[0]);
+	exit(EXIT_FAILURE);
+    } else if (realpath(file, path) == NULL || strchr(path, ' ') != NULL) {
+	fprintf(stderr,"%s: Error in reading %s\n",argv[0],file);
+	exit(EXIT_FAILURE);
+    }
+
+    /* Connect to ssvadd */
+    if (strlen(CL_Socket) >= sizeof(addr.sun_path) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	fprintf(stderr,"%s: bad socket %s\n",argv[0],CL_Socket);
+	exit(EXIT_FAILURE);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, CL_Socket);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+	fprintf(stderr,"%s: unable to connect to ssvadd at %s\n",argv[0],CL_Socket);
+	exit(EXIT_FAILURE);
+    }
+    in = fdopen(fd, "r");
+    out = fdopen(dup(fd), "w");
+
+    /* Send the request */
+    if (raw != NULL)
+	fprintf(out, "VAD pcm=%lu sr=%d nch=%d", frames, sr, nch);
+    else
+	fprintf(out, "VAD file=%s", path);
+    fprintf(out, " ch=%c 2ch=%c dn=%c snr=%s zf=%s af=%s c=%s amax=%s amin=%s bmax=%s bmin=%s"
+	    " start=%s", CL_ChannelID[0], CL_TwoChannel[0], CL_Denoise[0], CL_SnrThreshold,
+	    CL_ZcrFactor, CL_AvmFactor, CL_Corpus, CL_AlphaMax, CL_AlphaMin, CL_BetaMax, CL_BetaMin,
+	    CL_StartTime);
+    if (CL_EndTime != NULL)
+	fprintf(out, " end=%s", CL_EndTime);
+    fprintf(out, "\n");
+    if (raw != NULL) {
+	fwrite(raw, 2*nch, frames, out);
+	free(raw);
+    }
+    if (fflush(out) != 0) {
+	fprintf(stderr,"%s: lost connection to ssvadd\n",argv[0]);
+	exit(EXIT_FAILURE);
+    }
+
+    /* Copy the segments of the reply to the .phn file */
+    if (fgets(line, sizeof(line), in) == NULL) {
+	fprintf(stderr,"%s: no reply from ssvadd\n",argv[0]);
+	exit(EXIT_FAILURE);
+    }
+    if (sscanf(line, "OK %d", &num_segs) != 1) {
+	fprintf(stderr,"%s: %s",argv[0],line);
+	exit(EXIT_FAILURE);
+    }
+    if ((phn = fopen(CL_PhnFile, "w")) == NULL) {
+	fprintf(stderr,"Unable to open %s for write\n",CL_PhnFile);
+	exit(EXIT_FAILURE);
+    }
+    for (s=0; s<num_segs; s++) {
+	if (fgets(line, sizeof(line), in) == NULL) {
+	    fprintf(stderr,"%s: incomplete reply from ssvadd\n",argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+	fputs(line, phn);
+    }
+    if (fclose(phn) != 0) {
+	fprintf(stderr,"Error in writing %s\n",CL_PhnFile);
+	exit(EXIT_FAILURE);
+    }
+    fclose(out);
+    fclose(in);
+    return(0);
+}
@@ -0,0 +1,446 @@
+/* Filename	:ssvadd.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :VAD daemon. Listens on a Unix domain socket and runs SSVAD
+                 (libssvad) on the requests with -threads worker threads.
+		 Each worker keeps its SSVAD context, and hence its scratch
+		 buffers, for the lifetime of the daemon, so that short files
+		 do not pay for process start-up and allocation. ssvadc is the
+		 client.
+
+		 Protocol: a connection carries any number of requests, each
+		 a line of key=value pairs after the word VAD:
+		     VAD file=<path> ch=A
+		     VAD pcm=<frames> sr=8000 nch=1 ch=A
+		 With pcm=, <frames>*nch 16-bit little-endian interleaved
+		 samples follow the line. Other keys (defaults of sph2phn and
+		 sph2phn_2ch): 2ch=N dn=Y (or N, A; S is rejected) snr=35 zf=-1000 af=0.99
+		 c=nist12 amax=4.0 amin=0.5 bmax=0.05 bmin=0.01 start=0
+		 end=<end of file>. start= and end= apply to a payload as
+		 well; the segment times are sample positions in it.
+		 File paths must be absolute and contain no spaces. The format
+		 follows the extension (.wav, .flac, otherwise SPHERE).
+		 Reply:
+		     OK <num_segs>
+		     <begin> <end> <label>	(num_segs lines, as in .phn files)
+		 or
+		     ERR <message>
+
+   Example      :ssvadd -socket /tmp/ssvad.sock -threads 4 &
+		 ssvadc -socket /tmp/ssvad.sock -sph eslnc.sph -ch A -phn eslnc_A.phn
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sp/sphere.h>
+#include "mmalloc.h"
+#include "cmdline.h"
+#include "sph_io.h"
+#include "winwav.h"
+#include "flac.h"
+#include "ssvad.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_Socket="/tmp/ssvad.sock",	/* Unix domain socket to listen on */
+     *CL_NumThreads="0",		/* Number of worker threads, 0 for one per CPU */
+     *CL_Verbose="N";			/* Y: log every request to stderr */
+
+CLINEPARA options[]=
+{
+    {"-Socket", "-socket", &CL_Socket},
+    {"-NumThreads", "-threads", &CL_NumThreads},
+    {"-Verbose", "-v", &CL_Verbose}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define MAX_LINE    4096
+#define MAX_QUEUE   256			/* Connections waiting for a worker */
+#define MAX_CHANNEL 8
+#define MAX_PCM_SAMPLES (1UL<<30)	/* Payload samples (frames*nch), 2 GB */
+
+/* Connections accepted but not yet served */
+static struct {
+    int fd[MAX_QUEUE];
+    int head, count;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} queue = {{0}, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+/* The SPHERE, WAVE and FLAC readers are not known to be reentrant */
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile sig_atomic_t stop_flag = 0;
+static unsigned long num_requests = 0;	/* Updated atomically by the workers */
+
+/* Parameters of a request */
+typedef struct {
+    char  *file;			/* Audio file, NULL for a PCM payload */
+    unsigned long pcm_frames;		/* Number of frames of the payload */
+    int   sr, nch;			/* Format of the payload */
+    char  channel;
+    int   two_ch;
+    double start, end;
+    SSVAD_PARAMS par;
+} REQUEST;
+
+
+static void on_signal(int sig)
+{
+    stop_flag = 1;
+}
+
+
+/* Parse "VAD key=value ..." into req. Return NULL or an error message. */
+static const char *parse_request(char *line, REQUEST *req)
+{
+    char *tok, *val, *save;
+    char *corpus = "nist12";
+    unsigned long last;			/* End of the region of a payload */
+
+    memset(req, 0, sizeof(REQUEST));
+    ssvad_default_params(&req->par);
+    req->channel = 'A';
+    if ((tok = strtok_r(line, " \t\r\n", &save)) == NULL || strcmp(tok, "VAD") != 0)
+	return "expecting VAD";
+    while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+	if ((val = strchr(tok, '=')) == NULL)
+	    return "expecting key=value";
+	*val++ = '\0';
+	if (strcmp(tok, "file") == 0)		req->file = val;
+	else if (strcmp(tok, "pcm") == 0)	req->pcm_frames = strtoul(val, NULL, 10);
+	else if (strcmp(tok, "sr") == 0)	req->sr = atoi(val);
+	else if (strcmp(tok, "nch") == 0)	req->nch = atoi(val);
+	else if (strcmp(tok, "ch") == 0)	req->channel = val[0];
+	else if (strcmp(tok, "2ch") == 0)	req->two_ch = (val[0] == 'Y');
+	else if (strcmp(tok, "dn") == 0 && val[0] == 'S')
+	    return "dn=S is only supported by sph2phn";
+	else if (strcmp(tok, "dn") == 0)	req->par.denoise = (val[0] == 'Y') ? SSVAD_DENOISE_ON :
+						   (val[0] == 'A') ? SSVAD_DENOISE_AUTO : SSVAD_DENOISE_OFF;
+	else if (strcmp(tok, "snr") == 0)	req->par.snr_threshold = atof(val);
+	else if (strcmp(tok, "zf") == 0)	req->par.zcr_factor = atof(val);
+	else if (strcmp(tok, "af") == 0)	req->par.avm_factor = atof(val);
+	else if (strcmp(tok, "amax") == 0)	req->par.alpha_max = atof(val);
+	else if (strcmp(tok, "amin") == 0)	req->par.alpha_min = atof(val);
+	else if (strcmp(tok, "bmax") == 0)	req->par.beta_max = atof(val);
+	else if (strcmp(tok, "bmin") == 0)	req->par.beta_min = atof(val);
+	else if (strcmp(tok, "c") == 0)		corpus = val;
+	else if (strcmp(tok, "start") == 0)	req->start = string_to_time(val);
+	else if (strcmp(tok, "end") == 0)	req->end = string_to_time(val);
+	else
+	    return "unknown key";
+    }
+    /* Corpus names of sph2phn_2ch -c */
+    if (strncmp(corpus, "nist12", 6) == 0)
+	req->par.crosstalk = SSVAD_CROSSTALK_SRE12;
+    else if (strncmp(corpus, "nist10", 6) == 0)
+	req->par.crosstalk = SSVAD_CROSSTALK_SRE10;
+    else
+	req->par.crosstalk = SSVAD_CROSSTALK_NONE;
+    if (req->file == NULL && req->pcm_frames == 0)
+	return "expecting file= or pcm=";
+    if (req->file == NULL && (req->sr <= 0 || req->nch < 1 || req->nch > MAX_CHANNEL))
+	return "pcm= needs sr= and nch=";
+    if (req->file == NULL && (req->pcm_frames > MAX_PCM_SAMPLES/req->nch ||
+			      req->pcm_frames > ULONG_MAX/(2*(unsigned long)req->nch)))
+	return "pcm= too large";
+    if (req->file == NULL) {
+	last = (req->end > 0.0) ? SEC2SMP(req->end, req->sr) : req->pcm_frames;
+	if (SEC2SMP(req->start, req->sr) >= ((last < req->pcm_frames) ? last : req->pcm_frames))
+	    return "no samples between start= and end=";
+    }
+    if (req->channel < 'A' || req->channel >= 'A'+MAX_CHANNEL)
+	return "bad channel";
+    return NULL;
+}
+
+
+/* Read the channel(s) of a request from its file. Return the channels or NULL. */
+static short **read_channels(REQUEST *req, int chan, unsigned long *num_samples, int *sr,
+			     int *nch, const char **err)
+{
+    short **x = NULL;
+    WAV_INFO info;
+    SP_INTEGER bps, n_ch, s_rate;
+    char *smpcode, *ext;
+    int errcode = 0;
+
+    ext = strrchr(req->file, '.');
+    pthread_mutex_lock(&io_lock);
+    if (ext != NULL && strcmp(ext, ".wav") == 0) {
+	x = WavReadChannels(req->file, &info, chan, req->start, req->end, num_samples);
+	*sr = info.srate;
+	*nch = info.channel;
+    } else if (ext != NULL && strcmp(ext, ".flac") == 0) {
+	x = FlacReadChannels(req->file, &info, chan, req->start, req->end, num_samples);
+	*sr = info.srate;
+	*nch = info.channel;
+    } else if (chan <= 1) {		/* read_wav_range() keeps A and B only */
+	x = read_wav_range(req->file, chan, req->start, req->end, num_samples, &bps, &n_ch,
+			   &s_rate, &smpcode, &errcode);
+	*sr = s_rate;
+	*nch = n_ch;
+    }
+    pthread_mutex_unlock(&io_lock);
+    if (x == NULL)
+	*err = "unable to read file";
+    return x;
+}
+
+
+/* Read a PCM payload of req->pcm_frames frames from fp and deinterleave the frames
+   in [start,end) sec, as RawReadChannels(). parse_request() has checked the size and
+   that the region is not empty. */
+static short **read_payload(FILE *fp, REQUEST *req, unsigned long *num_samples, const char **err)
+{
+    unsigned char *buf;
+    short **x;
+    unsigned long n = req->pcm_frames, first, last, i;
+    int c;
+
+    if ((buf = (unsigned char *)malloc(n*req->nch*2)) == NULL) {
+	*err = "out of memory";
+	return NULL;
+    }
+    if (fread(buf, 2*req->nch, n, fp) != n) {
+	free(buf);
+	*err = "short payload";
+	return NULL;
+    }
+    first = SEC2SMP(req->start, req->sr);
+    last = (req->end > 0.0) ? SEC2SMP(req->end, req->sr) : n;
+    if (last > n)
+	last = n;
+    if ((x = (short **)calloc(req->nch, sizeof(short *))) == NULL) {
+	free(buf);
+	*err = "out of memory";
+	return NULL;
+    }
+    for (c=0; c<req->nch; c++) {
+	x[c] = (short *)vector(0, last-first-1, sizeof(short));
+	for (i=first; i<last; i++) {
+	    unsigned char *p = buf + 2*(i*req->nch+c);
+	    x[c][i-first] = (short)(p[0] | (p[1] << 8));
+	}
+    }
+    free(buf);
+    *num_samples = last-first;
+    return x;
+}
+
+
+/* Serve one request. Return 0, or -1 if the connection must be closed. */
+static int serve_request(SSVAD *vad, FILE *in, FILE *fp, char *line)
+{
+    REQUEST req;
+    const char *err;
+    short **x = NULL;
+    unsigned long num_samples = 0, offset;
+    int sr = 0, nch = 0, chan, c, last, s, status;
+    int has_payload = (strstr(line, "pcm=") != NULL);
+    const SSVAD_SEGMENT *seg;
+
+    if ((err = parse_request(line, &req)) != NULL) {
+	fprintf(fp, "ERR %s\n", err);
+	return has_payload ? -1 : 0;	/* Unable to skip the payload */
+    }
+    chan = req.channel-'A';
+    if (req.file != NULL) {
+	x = read_channels(&req, req.two_ch ? -1 : chan, &num_samples, &sr, &nch, &err);
+    } else {
+	x = read_payload(in, &req, &num_samples, &err);
+	sr = req.sr;
+	nch = req.nch;
+	if (x == NULL) {
+	    fprintf(fp, "ERR %s\n", err);
+	    return -1;			/* Lost track of the stream */
+	}
+    }
+    if (x == NULL) {
+	fprintf(fp, "ERR %s\n", err);
+	return 0;
+    }
+
+    if (req.two_ch && (nch < 2 || chan > 1))
+	status = SSVAD_ERR_ARG;
+    else if (chan >= nch)
+	status = SSVAD_ERR_ARG;
+    else {
+	ssvad_set_params(vad, &req.par);
+	if (req.two_ch)
+	    status = ssvad_process_2ch(vad, x[0], x[1], num_samples, sr, req.channel);
+	else
+	    status = ssvad_process(vad, x[chan], num_samples, sr);
+    }
+    /* Only the channels asked for are read from files; a payload has all nch */
+    last = (req.file == NULL) ? nch : req.two_ch ? 2 : chan+1;
+    for (c=0; c<last && c<nch; c++) {
+	if (x[c] != NULL)
+	    free_vector((char *)x[c], 0, sizeof(short));
+    }
+    free(x);
+
+    if (status != SSVAD_OK) {
+	fprintf(fp, "ERR %s\n", ssvad_strerror(status));
+	return 0;
+    }
+    /* Sample positions of the whole file or payload, as sph2phn -start */
+    offset = SEC2SMP(req.start, sr);
+    seg = ssvad_segments(vad);
+    fprintf(fp, "OK %d\n", ssvad_num_segments(vad));
+    for (s=0; s<ssvad_num_segments(vad); s++)
+	fprintf(fp, "%ld %ld %s\n", seg[s].begin+(long)offset, seg[s].end+(long)offset,
+		seg[s].speech ? "S" : "h#");
+    __atomic_add_fetch(&num_requests, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+static void serve_connection(SSVAD *vad, int fd)
+{
+    FILE *in, *out;
+    char line[MAX_LINE];
+    int fd2;
+
+    if ((fd2 = dup(fd)) < 0 || (in = fdopen(fd, "r")) == NULL) {
+	close(fd);
+	if (fd2 >= 0)
+	    close(fd2);
+	return;
+    }
+    if ((out = fdopen(fd2, "w")) == NULL) {
+	fclose(in);
+	close(fd2);
+	return;
+    }
+    while (fgets(line, sizeof(line), in) != NULL) {
+	if (CL_Verbose[0] == 'Y')
+	    fprintf(stderr, "ssvadd: %s", line);
+	if (serve_request(vad, in, out, line) != 0 || fflush(out) != 0)
+	    break;
+    }
+    fclose(out);
+    fclose(in);
+}
+
+
+static void *worker(void *arg)
+{
+    SSVAD *vad;
+    int fd;
+
+    if ((vad = ssvad_new(NULL)) == NULL) {
+	fprintf(stderr, "ssvadd: out of memory\n");
+	exit(EXIT_FAILURE);
+    }
+    for (;;) {
+	pthread_mutex_lock(&queue.lock);
+	while (queue.count == 0 && !queue.stop)
+	    pthread_cond_wait(&queue.ready, &queue.lock);
+	if (queue.count == 0) {
+	    pthread_mutex_unlock(&queue.lock);
+	    break;
+	}
+	fd = queue.fd[queue.head];
+	queue.head = (queue.head+1) % MAX_QUEUE;
+	queue.count--;
+	pthread_cond_broadcast(&queue.ready);
+	pthread_mutex_unlock(&queue.lock);
+	serve_connection(vad, fd);
+    }
+    ssvad_free(vad);
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    sigset_t set, old_set;
+    pthread_t *tid;
+    int lfd, fd, num_threads, i;
+
+    get_cmdline(argc, argv, num_options, options);
+    num_threads = atoi(CL_NumThreads);
+    if (num_threads <= 0)
+	num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+	num_threads = 1;
+
+    if (strlen(CL_Socket) >= sizeof(addr.sun_path)) {
+	fprintf(stderr, "%s: socket path too long\n", argv[0]);
+	exit(EXIT_FAILURE);
+    }
+    if ((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	perror("socket");
+	exit(EXIT_FAILURE);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, CL_Socket);
+    unlink(CL_Socket);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, MAX_QUEUE) < 0) {
+	fprintf(stderr, "%s: unable to listen on %s: %s\n", argv[0], CL_Socket, strerror(errno));
+	exit(EXIT_FAILURE);
+    }
+
+    /* SIGINT and SIGTERM interrupt accept(); broken clients must not kill the daemon */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* The workers block SIGINT and SIGTERM, so that they reach the main thread in accept() */
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set, &old_set);
+    tid = (pthread_t *)x_malloc(num_threads*sizeof(pthread_t));
+    for (i=0; i<num_threads; i++)
+	pthread_create(&tid[i], NULL, worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    fprintf(stderr, "%s: listening on %s with %d worker threads\n", argv[0], CL_Socket, num_threads);
+
+    while (!stop_flag) {
+	if ((fd = accept(lfd, NULL, NULL)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    perror("accept");
+	    break;
+	}
+	pthread_mutex_lock(&queue.lock);
+	while (queue.count == MAX_QUEUE)
+	    pthread_cond_wait(&queue.ready, &queue.lock);
+	queue.fd[(queue.head+queue.count) % MAX_QUEUE] = fd;
+	queue.count++;
+	pthread_cond_broadcast(&queue.ready);
+	pthread_mutex_unlock(&queue.lock);
+    }
+
+    /* Finish the queued connections, then stop the workers */
+    close(lfd);
+    unlink(CL_Socket);
+    pthread_mutex_lock(&queue.lock);
+    queue.stop = 1;
+    pthread_cond_broadcast(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+    for (i=0; i<num_threads; i++)
+	pthread_join(tid[i], NULL);
+    free(tid);
+    fprintf(stderr, "%s: served %lu requests\n", argv[0], num_requests);
+    return(0);
+}
@@ -0,0 +1,437 @@
+/* Filename	:vadbench.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :Microbenchmarks of the kernels of sph2phn and sph2phn_2ch: the
+                 frame features of silence.c, windowing, FFT, the veclib routines
+		 and the whole of findnoise(), denoise(), detect_silence() and
+		 remove_crosstalk_SRE12(). The input is a synthetic signal of
+		 alternating noise and voiced bursts. Each benchmark is repeated
+		 until it has run for -t sec, and its throughput is printed in
+		 samples or frames per second. The instruction set of the veclib
+		 kernels is printed (set SSVAD_SIMD to compare them, see
+		 veclib_simd.c). With -json, the results are also
+		 appended as JSON lines; with -base, they are compared with such
+		 a file from an earlier build.
+
+   Example      :vadbench -t 0.5 -json new.json -base old.json
+                 vadbench -k FFT
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mmalloc.h"
+#include "veclib.h"
+#include "cmdline.h"
+#include "silence.h"
+#include "window.h"
+#include "fft.h"
+#include "denoise.h"
+#include "findnoise.h"
+#include "segment.h"
+#include "rm_crosstalk.h"
+#include "profile.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_MinTime="0.2",			/* Minimum run time of each benchmark in sec */
+     *CL_SampleRate="8000",		/* Sampling rate of the synthetic signal */
+     *CL_Seconds="30",			/* Length of the synthetic signal in sec */
+     *CL_Filter="",			/* Only run the benchmarks whose name contains this */
+     *CL_JsonFile=(char *)NULL,		/* Append the results to this file as JSON lines */
+     *CL_BaseFile=(char *)NULL;		/* Compare with the results in this file */
+
+CLINEPARA options[]=
+{
+    {"-MinTime", "-t", &CL_MinTime},
+    {"-SampleRate", "-sr", &CL_SampleRate},
+    {"-Seconds", "-len", &CL_Seconds},
+    {"-Filter", "-k", &CL_Filter},
+    {"-JsonFile", "-json", &CL_JsonFile},
+    {"-BaseFile", "-base", &CL_BaseFile}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define FRM_SIZE 512			/* Frame size of findnoise() and denoise(), as in sph2phn */
+#define BKG_FRAC 0.1
+#define MAX_LINE 1024
+
+/* Input of the benchmarks */
+typedef struct {
+	short	*x, *x2;		/* Channels A and B [0..n-1] */
+	short	*work;			/* Copy of x[] for kernels that change their input */
+	unsigned long n;		/* Number of samples */
+	int	sr;			/* Sampling rate in Hz */
+	int	size;			/* Frame or vector size of the benchmark */
+	vec_t	*v, *v2, *V;		/* vec_t buffers of size n, n and 2*n */
+	vec_t	*noise;			/* Noise spectrum [0..FRM_SIZE-1] */
+	SEGMENT	*seg1, *seg2;		/* detect_silence() of x[] and x2[] */
+} BENCH_ARG;
+
+/* A benchmark runs its kernel once and returns the number of units processed */
+typedef struct {
+	char	*name;
+	char	*unit;			/* "samples" or "frames" */
+	double	(*run)(BENCH_ARG *arg);
+	int	sizes[4];		/* Values of arg->size, 0-terminated; {0} if not used */
+} BENCH;
+
+volatile vec_t sink;			/* Keeps the results of the kernels alive */
+
+
+/* Synthetic signal: noise with voiced bursts of 0.3-1.2 sec, channel B as crosstalk */
+static void make_signal(BENCH_ARG *arg)
+{
+     unsigned long t, next = 0;
+     unsigned int seed = 12345;
+     double f0 = 120.0, amp = 0.0, noise, s;
+     int voiced = 0, h;
+
+     for (t=0; t<arg->n; t++) {
+	 if (t == next) {
+	     voiced = !voiced;
+	     seed = seed*1103515245 + 12345;
+	     next = t + (unsigned long)((0.3 + 0.9*((seed>>16)&0x7fff)/32768.0)*arg->sr);
+	     f0 = 100.0 + ((seed>>8)&0x7f);
+	 }
+	 amp = 0.999*amp + 0.001*(voiced ? 6000.0 : 0.0);
+	 seed = seed*1103515245 + 12345;
+	 noise = 200.0*((double)((seed>>16)&0x7fff)/16384.0 - 1.0);
+	 for (s=0.0, h=1; h<=5; h++)
+	     s += sin(2.0*M_PI*h*f0*t/arg->sr)/h;
+	 arg->x[t] = (short)(amp*s/2.3 + noise);
+	 arg->x2[t] = (short)(0.2*arg->x[t] + ((voiced) ? 0.0 : 5.0*noise));
+     }
+}
+
+/* Run fn with stdout sent to /dev/null, as the pipeline functions print their progress */
+static void *quiet(void *(*fn)(BENCH_ARG *), BENCH_ARG *arg)
+{
+     int saved, null;
+     void *ret;
+
+     fflush(stdout);
+     saved = dup(STDOUT_FILENO);
+     null = open("/dev/null", O_WRONLY);
+     dup2(null, STDOUT_FILENO);
+     close(null);
+     ret = fn(arg);
+     fflush(stdout);
+     dup2(saved, STDOUT_FILENO);
+     close(saved);
+     return ret;
+}
+
+
+/**************************** Benchmarks ****************************/
+
+/* Whole-signal statistics of sph2phn, taken once per channel */
+static double bench_signal_summary(BENCH_ARG *arg)
+{
+     SIGNAL_SUMMARY sum;
+
+     signal_summary(arg->x, arg->n, &sum);
+     sink = (double)sum.sum + sum.num_sgnchg;
+     return (double)arg->n;
+}
+
+/* Frame features of detect_silence(): 10 ms frames at a 1 ms shift */
+static double bench_zero_crossing(BENCH_ARG *arg)
+{
+     int winsize = (int)(FRAME_WIDTH*arg->sr), wininc = arg->sr/FRAME_RATE;
+     unsigned long j, num_frms = NUM_FRAMES(arg->n, arg->sr);
+     vec_t sum = 0.0;
+
+     for (j=0; j<num_frms; j++)
+	 sum += zero_crossing(&arg->x[j*wininc], winsize);
+     sink = sum;
+     return (double)num_frms*winsize;
+}
+
+static double bench_average_magnitude(BENCH_ARG *arg)
+{
+     int winsize = (int)(FRAME_WIDTH*arg->sr), wininc = arg->sr/FRAME_RATE;
+     unsigned long j, num_frms = NUM_FRAMES(arg->n, arg->sr);
+     vec_t sum = 0.0;
+
+     for (j=0; j<num_frms; j++)
+	 sum += average_magnitude(&arg->x[j*wininc], winsize);
+     sink = sum;
+     return (double)num_frms*winsize;
+}
+
+static double bench_moving_average(BENCH_ARG *arg)
+{
+     unsigned long num_frms = NUM_FRAMES(arg->n, arg->sr);
+
+     moving_average(arg->v, num_frms, 40);
+     sink = arg->v[num_frms-1];
+     return (double)num_frms;
+}
+
+static double bench_windowing(BENCH_ARG *arg)
+{
+     unsigned long j;
+
+     for (j=0; j+arg->size<=arg->n; j+=arg->size)
+	 windowing(&arg->x[j], &arg->v[j], arg->size, 'H', 1, 0.0);
+     sink = arg->v[0];
+     return (double)j;
+}
+
+static double bench_dewindowing(BENCH_ARG *arg)
+{
+     unsigned long j;
+
+     for (j=0; j+arg->size<=arg->n; j+=arg->size)
+	 dewindowing(&arg->v[j], &arg->v2[j], arg->size, 'H', 1);
+     sink = arg->v2[0];
+     return (double)j;
+}
+
+static double bench_FFT(BENCH_ARG *arg)
+{
+     unsigned long j, num_frms = 0;
+
+     for (j=0; j+arg->size<=arg->n && num_frms<256; j+=arg->size, num_frms++)
+	 FFT(&arg->v[j], &arg->V[2*j], arg->size);
+     sink = arg->V[1];
+     return (double)num_frms;
+}
+
+static double bench_IFFT(BENCH_ARG *arg)
+{
+     unsigned long j, num_frms = 0;
+
+     for (j=0; j+arg->size<=arg->n && num_frms<256; j+=arg->size, num_frms++)
+	 IFFT(&arg->V[2*j], &arg->v2[j], arg->size);
+     sink = arg->v2[0];
+     return (double)num_frms;
+}
+
+static double bench_VECdotf(BENCH_ARG *arg)
+{
+     sink = VECdotf(arg->size, arg->v, arg->v2);
+     return (double)arg->size;
+}
+
+static double bench_VECL2normf(BENCH_ARG *arg)
+{
+     sink = VECL2normf(arg->size, arg->v);
+     return (double)arg->size;
+}
+
+static double bench_VECamaxf(BENCH_ARG *arg)
+{
+     sink = VECamaxf(arg->size, arg->v);
+     return (double)arg->size;
+}
+
+static double bench_VECminposf(BENCH_ARG *arg)
+{
+     int pos;
+
+     sink = VECminposf(arg->size, arg->v, &pos);
+     return (double)arg->size;
+}
+
+static double bench_VECstatf(BENCH_ARG *arg)
+{
+     vec_t mean, stddev;
+
+     VECstatf(arg->size, arg->v, &mean, &stddev);
+     sink = mean + stddev;
+     return (double)arg->size;
+}
+
+static void *run_findnoise(BENCH_ARG *arg)
+{
+     return findnoise(arg->x, arg->n, FRM_SIZE, BKG_FRAC);
+}
+
+static double bench_findnoise(BENCH_ARG *arg)
+{
+     vec_t *noise = (vec_t *)quiet(run_findnoise, arg);
+
+     sink = noise[1];
+     free_vector((char *)noise, 0, sizeof(vec_t));
+     return (double)(arg->n/FRM_SIZE);
+}
+
+static void *run_denoise(BENCH_ARG *arg)
+{
+     unsigned long n;
+
+     return denoise(arg->x, arg->n, FRM_SIZE, FRM_SIZE/4, &n, arg->noise, 4.0, 0.5, 0.05, 0.01);
+}
+
+static double bench_denoise(BENCH_ARG *arg)
+{
+     short *y = (short *)quiet(run_denoise, arg);
+
+     sink = y[0];
+     free_vector((char *)y, 0, sizeof(short));
+     return (double)(arg->n/(FRM_SIZE/4)-3);
+}
+
+static void *run_detect_silence(BENCH_ARG *arg)
+{
+     memcpy(arg->work, arg->x, arg->n*sizeof(short));     /* remove_offset() changes its input */
+     return detect_silence(arg->work, arg->n, arg->sr, -1000.0, 0.99, 1.0);
+}
+
+static void *run_detect_silence_B(BENCH_ARG *arg)
+{
+     memcpy(arg->work, arg->x2, arg->n*sizeof(short));
+     return detect_silence(arg->work, arg->n, arg->sr, -1000.0, 0.99, 1.0);
+}
+
+static double bench_detect_silence(BENCH_ARG *arg)
+{
+     SEGMENT *seg = (SEGMENT *)quiet(run_detect_silence, arg);
+
+     sink = seg[0].num_segs;
+     free_vector((char *)seg, 0, sizeof(SEGMENT));
+     return (double)NUM_FRAMES(arg->n, arg->sr);
+}
+
+static void *run_crosstalk(BENCH_ARG *arg)
+{
+     return remove_crosstalk_SRE12(arg->seg1, arg->seg2, arg->n, 'A');
+}
+
+static double bench_remove_crosstalk(BENCH_ARG *arg)
+{
+     SEGMENT *seg = (SEGMENT *)quiet(run_crosstalk, arg);
+
+     sink = seg[0].num_segs;
+     free_vector((char *)seg, 0, sizeof(SEGMENT));
+     return (double)arg->n;
+}
+
+static BENCH bench[] = {
+     {"signal_summary", "samples", bench_signal_summary, {0}},
+     {"zero_crossing", "samples", bench_zero_crossing, {0}},
+     {"average_magnitude", "samples", bench_average_magnitude, {0}},
+     {"moving_average", "frames", bench_moving_average, {0}},
+     {"windowing", "samples", bench_windowing, {256, 512, 1024, 0}},
+     {"dewindowing", "samples", bench_dewindowing, {256, 512, 1024, 0}},
+     {"FFT", "frames", bench_FFT, {256, 512, 1024, 2048}},
+     {"IFFT", "frames", bench_IFFT, {256, 512, 1024, 2048}},
+     {"VECdotf", "samples", bench_VECdotf, {512, 65536, 0}},
+     {"VECL2normf", "samples", bench_VECL2normf, {512, 65536, 0}},
+     {"VECamaxf", "samples", bench_VECamaxf, {512, 65536, 0}},
+     {"VECminposf", "samples", bench_VECminposf, {512, 65536, 0}},
+     {"VECstatf", "samples", bench_VECstatf, {512, 65536, 0}},
+     {"findnoise", "frames", bench_findnoise, {0}},
+     {"denoise", "frames", bench_denoise, {0}},
+     {"detect_silence", "frames", bench_detect_silence, {0}},
+     {"remove_crosstalk_SRE12", "samples", bench_remove_crosstalk, {0}}
+};
+
+static int num_bench = sizeof(bench)/sizeof(BENCH);
+
+
+/* Rate of name/size in the JSON lines of basefile, 0 if absent */
+static double base_rate(char *basefile, char *name, int size)
+{
+     FILE *fp;
+     char line[MAX_LINE], key[MAX_LINE], *p;
+     double rate = 0.0;
+
+     if (basefile == NULL || (fp=fopen(basefile, "r")) == NULL)
+	 return 0.0;
+     sprintf(key, "{\"bench\":\"%s\",\"size\":%d,", name, size);
+     while (fgets(line, MAX_LINE, fp) != NULL)
+	 if (strncmp(line, key, strlen(key)) == 0 && (p=strstr(line, "\"rate\":")) != NULL)
+	     rate = atof(p+strlen("\"rate\":"));     /* The last run in the file */
+     fclose(fp);
+     return rate;
+}
+
+
+int main(int argc, char *argv[])
+{
+     BENCH_ARG arg;
+     FILE *json = NULL;
+     double min_time, t0, elapsed, units, rate, base;
+     long iter, k;
+     int b, s, size;
+
+     if (argc>1)
+	 get_cmdline(argc, argv, num_options, options);
+     min_time = atof(CL_MinTime);
+     arg.sr = atoi(CL_SampleRate);
+     arg.n = (unsigned long)(atof(CL_Seconds)*arg.sr);
+     if (arg.sr < FRAME_RATE || arg.n < (unsigned long)arg.sr) {
+	 fprintf(stderr,"%s: -sr must be at least %d and -len at least 1 sec\n",argv[0],FRAME_RATE);
+	 exit(EXIT_FAILURE);
+     }
+     if (CL_JsonFile != NULL && (json=fopen(CL_JsonFile, "a")) == NULL) {
+	 fprintf(stderr,"Unable to open %s for write\n",CL_JsonFile);
+	 exit(EXIT_FAILURE);
+     }
+
+     /* Synthetic input and its noise spectrum and segments */
+     arg.x = (short *)vector(0, arg.n-1, sizeof(short));
+     arg.x2 = (short *)vector(0, arg.n-1, sizeof(short));
+     arg.work = (short *)vector(0, arg.n-1, sizeof(short));
+     arg.v = (vec_t *)vector(0, arg.n-1, sizeof(vec_t));
+     arg.v2 = (vec_t *)vector(0, arg.n-1, sizeof(vec_t));
+     arg.V = (vec_t *)vector(0, 2*arg.n-1, sizeof(vec_t));
+     make_signal(&arg);
+     for (k=0; k<(long)arg.n; k++) {
+	 arg.v[k] = (vec_t)arg.x[k];
+	 arg.v2[k] = (vec_t)arg.x2[k];
+     }
+     arg.noise = (vec_t *)quiet(run_findnoise, &arg);
+     arg.seg1 = (SEGMENT *)quiet(run_detect_silence, &arg);
+     arg.seg2 = (SEGMENT *)quiet(run_detect_silence_B, &arg);
+
+     printf("%d Hz, %s sec, at least %s sec per benchmark, veclib %s\n", arg.sr, CL_Seconds,
+	    CL_MinTime, VECsimd_name());
+     printf("%-24s %6s %10s %12s %14s%s\n", "benchmark", "size", "calls", "ns/call", "rate",
+	    (CL_BaseFile != NULL) ? "   speedup" : "");
+     for (b=0; b<num_bench; b++) {
+	 if (strstr(bench[b].name, CL_Filter) == NULL)
+	     continue;
+	 for (s=0; s==0 || (s<4 && bench[b].sizes[s]>0); s++) {
+	     size = arg.size = bench[b].sizes[s];
+
+	     /* Double the number of calls until the run takes min_time */
+	     bench[b].run(&arg);                /* Warm up */
+	     for (iter=1; ; iter*=2) {
+		 units = 0.0;
+		 t0 = prof_wall_time();
+		 for (k=0; k<iter; k++)
+		     units += bench[b].run(&arg);
+		 elapsed = prof_wall_time() - t0;
+		 if (elapsed >= min_time)
+		     break;
+	     }
+	     rate = units/elapsed;
+	     if (size > 0)
+		 printf("%-24s %6d", bench[b].name, size);
+	     else
+		 printf("%-24s %6s", bench[b].name, "-");
+	     printf(" %10ld %12.1f %9.3g %s/s", iter, 1e9*elapsed/iter, rate, bench[b].unit);
+	     if ((base=base_rate(CL_BaseFile, bench[b].name, size)) > 0.0)
+		 printf(" %8.2fx", rate/base);
+	     printf("\n");
+	     fflush(stdout);
+	     if (json != NULL)
+		 fprintf(json, "{\"bench\":\"%s\",\"size\":%d,\"unit\":\"%s\",\"calls\":%ld,"
+			 "\"ns_per_call\":%.1f,\"rate\":%.6g,\"sr\":%d,\"seconds\":%s,\"simd\":\"%s\"}\n",
+			 bench[b].name, size, bench[b].unit, iter, 1e9*elapsed/iter, rate,
+			 arg.sr, CL_Seconds, VECsimd_name());
+	 }
+     }
+     if (json != NULL)
+	 fclose(json);
+     return(0);
+}
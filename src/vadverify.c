@@ -0,0 +1,443 @@
+/* Filename	:vadverify.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak
+   Purpose      :Check that the optimised code paths give the same results as
+                 the reference ones (see refimpl.h). The pipeline of sph2phn,
+		 or of sph2phn_2ch with SRE12 crosstalk removal if -2ch is Y,
+		 is run twice on the same input: once with the functions of
+		 this build and once with their reference versions. For each
+		 stage, the first frame, sample or segment where the two differ
+		 is reported, with the maximum difference:
+
+		 windowing	 Hamming windowed frames of denoise()
+		 summary	 signal_summary() of the input, which is given
+				 to denoise_ex(), and to detect_silence_ex() if
+				 the channel is not denoised, as in sph2phn
+		 findnoise	 Noise spectrum
+		 denoise	 Denoised samples
+		 features	 Zero crossing rate and average magnitude of the
+				 frames of detect_silence()
+		 detect_silence	 Segment boundaries
+		 crosstalk	 Segment boundaries after crosstalk removal (-2ch Y)
+		 phn		 Whether the .phn files would be identical
+
+		 The exit status is 0 if everything is bit-exact, 1 otherwise.
+
+   Example      :vadverify -sph ../examples/eslnc.sph -ch A -af 0.95
+                 vadverify -sph ../examples/idcfvk_sre12.sph -ch B -2ch Y -af 0.95
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mmalloc.h"
+#include "veclib.h"
+#include "cmdline.h"
+#include "sph_io.h"
+#include "winwav.h"
+#include "flac.h"
+#include "window.h"
+#include "segment.h"
+#include "silence.h"
+#include "denoise.h"
+#include "findnoise.h"
+#include "rm_crosstalk.h"
+#include "refimpl.h"
+
+/* Declare global variables here */
+/* Default command line input parameters */
+char *CL_SphFile=(char *)NULL,
+     *CL_WavFile=(char *)NULL,
+     *CL_FlacFile=(char *)NULL,
+     *CL_ChannelID="A",
+     *CL_TwoChannel="N",		/* Y: pipeline of sph2phn_2ch with SRE12 crosstalk removal */
+     *CL_Denoise="Y",
+     *CL_StartTime="0",
+     *CL_EndTime=(char *)NULL,
+     *CL_ZcrFactor="-1000",
+     *CL_AvmFactor="0.99";
+
+CLINEPARA options[]=
+{
+    {"-SphFile", "-sph", &CL_SphFile},
+    {"-WavFile", "-wav", &CL_WavFile},
+    {"-FlacFile", "-flac", &CL_FlacFile},
+    {"-ChannelID", "-ch", &CL_ChannelID},
+    {"-TwoChannel", "-2ch", &CL_TwoChannel},
+    {"-Denoise", "-dn", &CL_Denoise},
+    {"-StartTime", "-start", &CL_StartTime},
+    {"-EndTime", "-end", &CL_EndTime},
+    {"-ZeroCrossingFactor", "-zf", &CL_ZcrFactor},
+    {"-AverageAmplitudeFactor", "-af", &CL_AvmFactor}
+};
+
+int num_options=sizeof(options)/sizeof(CLINEPARA);
+
+#define BKG_FRAC_1CH 0.05		/* BKG_FRAC of sph2phn.c */
+#define BKG_FRAC_2CH 0.1		/* BKG_FRAC of sph2phn_2ch.c */
+#define FRM_SIZE 512
+#define OPT 0
+#define REF 1
+
+/* The functions of one implementation */
+typedef struct {
+	char	*name;
+	void	(*signal_summary)(short *, unsigned long, SIGNAL_SUMMARY *);
+	void	(*windowing)(short *, vec_t *, int, int, int, vec_t);
+	vec_t	*(*findnoise)(const short *, unsigned long, const unsigned long, const vec_t, const int);
+	short	*(*denoise)(const short *, const unsigned long, const unsigned long, const unsigned long,
+			    unsigned long *, const double *, const double, const double,
+			    const double, const double, const SIGNAL_SUMMARY *);
+	vec_t	(*zero_crossing)(short *, unsigned long);
+	vec_t	(*average_magnitude)(short *, unsigned long);
+	void	(*remove_offset)(short *, unsigned long);
+	SEGMENT	*(*detect_silence)(short *, unsigned long, int, vec_t, vec_t, vec_t, int,
+				   const SIGNAL_SUMMARY *);
+	SEGMENT	*(*remove_crosstalk_SRE12)(SEGMENT *, SEGMENT *, unsigned long, char);
+	vec_t	(*L2norm)(int, vec_t *);
+} IMPL;
+
+static IMPL impl[2] = {
+     {"optimised", signal_summary, windowing, findnoise_ex, denoise_ex, zero_crossing,
+      average_magnitude, remove_offset, detect_silence_ex, remove_crosstalk_SRE12, VECL2normf},
+     {"reference", ref_signal_summary, ref_windowing, ref_findnoise_ex, ref_denoise_ex,
+      ref_zero_crossing, ref_average_magnitude, ref_remove_offset, ref_detect_silence_ex,
+      ref_remove_crosstalk_SRE12, ref_VECL2normf}
+};
+
+/* Output of the pipeline for one channel */
+typedef struct {
+	int	has_speech;
+	SIGNAL_SUMMARY sum;		/* signal_summary() of the input */
+	vec_t	*noise;			/* findnoise() of the input, [0..FRM_SIZE-1] */
+	short	*dn;			/* Denoised samples */
+	unsigned long num_dn;
+	vec_t	noise_energy;		/* For detect_silence() */
+	SEGMENT	*seg;
+} RESULT;
+
+static int saved_stdout = -1;
+static int num_diffs = 0;
+
+
+/* detect_silence() and rm_crosstalk print their statistics, which are not wanted here */
+static void quiet(int on)
+{
+     int null;
+
+     fflush(stdout);
+     if (on) {
+	 saved_stdout = dup(STDOUT_FILENO);
+	 null = open("/dev/null", O_WRONLY);
+	 dup2(null, STDOUT_FILENO);
+	 close(null);
+     } else if (saved_stdout >= 0) {
+	 dup2(saved_stdout, STDOUT_FILENO);
+	 close(saved_stdout);
+	 saved_stdout = -1;
+     }
+}
+
+static void report(char *stage, char *fmt, double first, double maxdiff)
+{
+     printf("%-16s ", stage);
+     if (first < 0) {
+	 printf("identical\n");
+	 return;
+     }
+     printf(fmt, first, maxdiff);
+     printf("\n");
+     num_diffs++;
+}
+
+
+/* Summarise and denoise one channel as sph2phn(_2ch) does; the noise of the output is needed
+   for crosstalk removal */
+static void denoise_channel(IMPL *f, short *x, unsigned long n, int two_ch, RESULT *r)
+{
+     vec_t *dnspec;
+     vec_t bkg_frac = two_ch ? BKG_FRAC_2CH : BKG_FRAC_1CH;
+
+     memset(r, 0, sizeof(RESULT));
+     f->signal_summary(x, n, &r->sum);
+     r->has_speech = (CL_Denoise[0] == 'Y' && r->sum.num_sgnchg > 0);
+     r->noise_energy = 1.0;
+     if (r->has_speech) {
+	 r->noise = f->findnoise(x, n, FRM_SIZE, bkg_frac, 1);
+	 r->dn = f->denoise(x, n, FRM_SIZE, FRM_SIZE/4, &r->num_dn, r->noise, 4.0, 0.5, 0.05, 0.01,
+			  &r->sum);
+	 if (two_ch) {
+	     dnspec = f->findnoise(r->dn, r->num_dn, FRM_SIZE, bkg_frac, 0);
+	     r->noise_energy = sqrt(f->L2norm(FRM_SIZE, dnspec))/FRM_SIZE;
+	     free_vector((char *)dnspec, 0, sizeof(vec_t));
+	 }
+     } else {
+	 r->num_dn = n;
+	 r->dn = (short *)vector(0, n-1, sizeof(short));
+	 memcpy(r->dn, x, n*sizeof(short));
+	 if (two_ch)
+	     r->noise_energy = 0.0;
+     }
+}
+
+/* Compare the signal summaries of the input */
+static void check_summary(RESULT *r, char ch)
+{
+     char stage[32];
+     SIGNAL_SUMMARY *s1 = &r[OPT].sum, *s2 = &r[REF].sum;
+
+     sprintf(stage, "summary %c", ch);
+     if (s1->sum == s2->sum && s1->asum == s2->asum && s1->peak == s2->peak &&
+	 s1->num_sgnchg == s2->num_sgnchg && s1->all_zero == s2->all_zero) {
+	 printf("%-16s identical\n", stage);
+	 return;
+     }
+     printf("%-16s sum %lld, |sum| %llu, peak %d, %lu sign changes instead of"
+	    " %lld, %llu, %d, %lu\n", stage, s1->sum, s1->asum, s1->peak, s1->num_sgnchg,
+	    s2->sum, s2->asum, s2->peak, s2->num_sgnchg);
+     num_diffs++;
+}
+
+/* Compare the Hamming windowed frames of x[] */
+static void check_windowing(short *x, unsigned long n, char ch)
+{
+     char stage[32];
+     vec_t *y[2];
+     unsigned long frame, num_frames = (n >= FRM_SIZE) ? (n-FRM_SIZE)/(FRM_SIZE/4)+1 : 0;
+     long first = -1;
+     double maxdiff = 0.0, d;
+     int k;
+
+     y[OPT] = (vec_t *)vector(0, FRM_SIZE-1, sizeof(vec_t));
+     y[REF] = (vec_t *)vector(0, FRM_SIZE-1, sizeof(vec_t));
+     for (frame=0; frame<num_frames; frame++) {
+	 impl[OPT].windowing(x+frame*(FRM_SIZE/4), y[OPT], FRM_SIZE, 'H', 1.0, 0.0);
+	 impl[REF].windowing(x+frame*(FRM_SIZE/4), y[REF], FRM_SIZE, 'H', 1.0, 0.0);
+	 for (k=0; k<FRM_SIZE; k++)
+	     if (y[OPT][k] != y[REF][k]) {
+		 if (first < 0)
+		     first = frame;
+		 if ((d=fabs(y[OPT][k]-y[REF][k])) > maxdiff)
+		     maxdiff = d;
+	     }
+     }
+     sprintf(stage, "windowing %c", ch);
+     report(stage, "first diverging frame %.0f, max difference %g", first, maxdiff);
+     free_vector((char *)y[OPT], 0, sizeof(vec_t));
+     free_vector((char *)y[REF], 0, sizeof(vec_t));
+}
+
+static void check_denoise(RESULT *r, char ch)
+{
+     char stage[32];
+     unsigned long t, n;
+     long first = -1;
+     double maxdiff = 0.0, d;
+
+     sprintf(stage, "findnoise %c", ch);
+     if (r[OPT].noise != NULL && r[REF].noise != NULL) {
+	 for (t=0; t<FRM_SIZE; t++)
+	     if (r[OPT].noise[t] != r[REF].noise[t]) {
+		 if (first < 0)
+		     first = t;
+		 if ((d=fabs(r[OPT].noise[t]-r[REF].noise[t])) > maxdiff)
+		     maxdiff = d;
+	     }
+	 report(stage, "first diverging bin %.0f, max difference %g", first, maxdiff);
+     } else if (r[OPT].has_speech != r[REF].has_speech) {
+	 printf("%-16s denoising is on in one implementation only\n", stage);
+	 num_diffs++;
+     }
+
+     sprintf(stage, "denoise %c", ch);
+     if (r[OPT].num_dn != r[REF].num_dn) {
+	 printf("%-16s %lu samples instead of %lu\n", stage, r[OPT].num_dn, r[REF].num_dn);
+	 num_diffs++;
+     }
+     n = (r[OPT].num_dn < r[REF].num_dn) ? r[OPT].num_dn : r[REF].num_dn;
+     for (first=-1, maxdiff=0.0, t=0; t<n; t++)
+	 if (r[OPT].dn[t] != r[REF].dn[t]) {
+	     if (first < 0)
+		 first = t;
+	     if ((d=abs(r[OPT].dn[t]-r[REF].dn[t])) > maxdiff)
+		 maxdiff = d;
+	 }
+     report(stage, "first diverging sample %.0f, max sample difference %g", first, maxdiff);
+}
+
+/* Compare the frame features of detect_silence(), after the removal of the DC offset */
+static void check_features(RESULT *r, unsigned long n, int sr, char ch)
+{
+     char stage[32];
+     short *x[2];
+     unsigned long i, winsize = FRAME_WIDTH*sr, wininc = sr/FRAME_RATE;
+     unsigned long num_frms = (n >= winsize) ? (n-winsize)/wininc+1 : 0;
+     long first = -1;
+     double maxdiff = 0.0, d;
+     int k;
+
+     for (k=OPT; k<=REF; k++) {
+	 x[k] = (short *)vector(0, n-1, sizeof(short));
+	 memcpy(x[k], r[k].dn, n*sizeof(short));
+	 impl[k].remove_offset(x[k], n);
+     }
+     for (i=0; i<num_frms; i++) {
+	 d = fabs(impl[OPT].zero_crossing(x[OPT]+i*wininc, winsize) -
+		  impl[REF].zero_crossing(x[REF]+i*wininc, winsize)) +
+	     fabs(impl[OPT].average_magnitude(x[OPT]+i*wininc, winsize) -
+		  impl[REF].average_magnitude(x[REF]+i*wininc, winsize));
+	 if (d != 0.0 && first < 0)
+	     first = i;
+	 if (d > maxdiff)
+	     maxdiff = d;
+     }
+     sprintf(stage, "features %c", ch);
+     report(stage, "first diverging frame %.0f, max zcr+avm difference %g", first, maxdiff);
+     free_vector((char *)x[OPT], 0, sizeof(short));
+     free_vector((char *)x[REF], 0, sizeof(short));
+}
+
+/* Index of the first segment that differs, the number of segments if none */
+static int first_diff_segment(SEGMENT *s1, SEGMENT *s2)
+{
+     int s, n = (s1[0].num_segs < s2[0].num_segs) ? s1[0].num_segs : s2[0].num_segs;
+
+     for (s=0; s<n; s++)
+	 if (s1[s].begin != s2[s].begin || s1[s].end != s2[s].end ||
+	     strcmp(s1[s].phoneme, s2[s].phoneme) != 0)
+	     break;
+     return s;
+}
+
+/* Compare two segmentations; return 1 if they differ */
+static int check_segments(char *stage, SEGMENT *s1, SEGMENT *s2)
+{
+     int s = first_diff_segment(s1, s2);
+     int n = (s1[0].num_segs < s2[0].num_segs) ? s1[0].num_segs : s2[0].num_segs;
+
+     if (s == n && s1[0].num_segs == s2[0].num_segs) {
+	 printf("%-16s identical (%d segments)\n", stage, n);
+	 return 0;
+     }
+     printf("%-16s %d and %d segments", stage, s1[0].num_segs, s2[0].num_segs);
+     if (s < n)
+	 printf(", first diverging segment %d: %d %d %s instead of %d %d %s", s,
+		s1[s].begin, s1[s].end, s1[s].phoneme, s2[s].begin, s2[s].end, s2[s].phoneme);
+     printf("\n");
+     num_diffs++;
+     return 1;
+}
+
+/* Segments of detect_silence() for channel c of both implementations. The summary of a
+   channel that is not denoised is passed as sph2phn(_2ch) does, so that the zeros of
+   the signal as read are labelled as there; it is only taken if num_out is the whole
+   channel. */
+static void detect(RESULT *r, unsigned long n, int sr, vec_t zcr_factor, vec_t avm_factor)
+{
+     short *x;
+     int k;
+
+     for (k=OPT; k<=REF; k++) {
+	 x = (short *)vector(0, n-1, sizeof(short));
+	 memcpy(x, r[k].dn, n*sizeof(short));
+	 quiet(1);
+	 r[k].seg = impl[k].detect_silence(x, n, sr, zcr_factor, avm_factor, r[k].noise_energy, 1,
+					   r[k].has_speech ? NULL : &r[k].sum);
+	 quiet(0);
+	 free_vector((char *)x, 0, sizeof(short));
+     }
+}
+
+
+int main(int argc, char *argv[])
+{
+     short **spbuf;
+     WAV_INFO wavinfo;
+     SP_INTEGER bps, n_ch, sr;
+     char *smpcode, stage[32];
+     int errcode, two_ch, c, k, num_ch, chan;
+     unsigned long num_samples, num_out;
+     double start_time, end_time;
+     vec_t zcr_factor, avm_factor;
+     RESULT res[2][2];			/* [channel][implementation] */
+     SEGMENT *seg[2];
+
+     if (argc==1)
+	 usage(argv[0],num_options,options);
+     get_cmdline(argc, argv, num_options, options);
+     two_ch = (CL_TwoChannel[0] == 'Y');
+     chan = CL_ChannelID[0]-'A';
+     zcr_factor = atof(CL_ZcrFactor);
+     avm_factor = atof(CL_AvmFactor);
+     start_time = string_to_time(CL_StartTime);
+     end_time = (CL_EndTime!=NULL) ? string_to_time(CL_EndTime) : 0.0;
+
+     /* Read the channel, or channels A and B for crosstalk removal */
+     if (CL_WavFile!=NULL || CL_FlacFile!=NULL) {
+	 if (CL_WavFile!=NULL)
+	     spbuf = WavReadChannels(CL_WavFile,&wavinfo,two_ch ? -1 : chan,start_time,end_time,&num_samples);
+	 else
+	     spbuf = FlacReadChannels(CL_FlacFile,&wavinfo,two_ch ? -1 : chan,start_time,end_time,&num_samples);
+	 sr = wavinfo.srate;
+	 n_ch = wavinfo.channel;
+     } else if (CL_SphFile!=NULL) {
+	 spbuf = read_wav_range(CL_SphFile,two_ch ? -1 : chan,start_time,end_time,&num_samples,
+				&bps,&n_ch,&sr,&smpcode,&errcode);
+     } else {
+	 fprintf(stderr,"%s: No input file, use -sph, -wav or -flac\n",argv[0]);
+	 exit(EXIT_FAILURE);
+     }
+     if (spbuf==NULL || (two_ch && n_ch < 2) || chan < 0 || chan >= n_ch) {
+	 fprintf(stderr,"%s: Error in reading channel %s%s\n",argv[0],
+		 two_ch ? "A and B" : CL_ChannelID, two_ch ? "" : " of the input");
+	 exit(EXIT_FAILURE);
+     }
+     printf("%lu samples at %ld Hz, channel %c%s\n", num_samples, (long)sr, CL_ChannelID[0],
+	    two_ch ? ", SRE12 crosstalk removal" : "");
+
+     /* Both implementations, on channel A and B or on the channel only */
+     num_ch = two_ch ? 2 : 1;
+     num_out = num_samples;
+     for (c=0; c<num_ch; c++) {
+	 short *x = spbuf[two_ch ? c : chan];
+	 char ch = two_ch ? 'A'+c : CL_ChannelID[0];
+
+	 check_windowing(x, num_samples, ch);
+	 for (k=OPT; k<=REF; k++)
+	     denoise_channel(&impl[k], x, num_samples, two_ch, &res[c][k]);
+	 check_summary(res[c], ch);
+	 check_denoise(res[c], ch);
+	 for (k=OPT; k<=REF; k++)
+	     if (res[c][k].num_dn < num_out)
+		 num_out = res[c][k].num_dn;
+     }
+     for (c=0; c<num_ch; c++) {
+	 char ch = two_ch ? 'A'+c : CL_ChannelID[0];
+
+	 check_features(res[c], num_out, sr, ch);
+	 detect(res[c], num_out, sr, zcr_factor, avm_factor);
+	 sprintf(stage, "detect_silence %c", ch);
+	 check_segments(stage, res[c][OPT].seg, res[c][REF].seg);
+     }
+     if (two_ch) {
+	 for (k=OPT; k<=REF; k++) {
+	     quiet(1);
+	     seg[k] = impl[k].remove_crosstalk_SRE12(res[0][k].seg, res[1][k].seg, num_out, CL_ChannelID[0]);
+	     quiet(0);
+	 }
+	 check_segments("crosstalk", seg[OPT], seg[REF]);
+     } else {
+	 seg[OPT] = res[0][OPT].seg;
+	 seg[REF] = res[0][REF].seg;
+     }
+
+     /* The .phn files are the final segments, shifted by the same offset */
+     printf("%-16s %s\n", "phn", (seg[OPT][0].num_segs == seg[REF][0].num_segs &&
+	    first_diff_segment(seg[OPT], seg[REF]) == seg[OPT][0].num_segs) ? "identical" : "differ");
+     printf("%s\n", (num_diffs == 0) ? "Bit-exact" : "NOT bit-exact");
+     return (num_diffs == 0) ? 0 : 1;
+}
@@ -7,6 +7,12 @@
          module.  As MSDOS have no vector library, this module implements
          the actual computation
  Note: All index start from zero
+ Modified(Oct 26): The functions used by the pipeline call the SSE2/AVX2/
+                   AVX-512 kernels of veclib_simd.c (chosen at run time);
+		   the plain loops are kept for REFERENCE_IMPL. The sums are
+		   taken in a different order, see veclib_simd.h. VECasums(),
+		   VECsgnchgs(), VECsummarys() and VECnzposs() added for
+		   silence.c, findnoise.c and denoise.c.
 **************************************************************************/
 #include <math.h>
 #include <stdio.h>
@@ -14,6 +20,9 @@
 #include <time.h>
 #include "mmalloc.h"
 #include "veclib.h"
+#ifndef REFERENCE_IMPL
+#include "veclib_simd.h"		/* vecsimd, NULL if vec_t is not double; vecsimd_s */
+#endif
 #ifdef _BORLANDC_
    #include <alloc.h>
 #endif
@@ -24,6 +33,12 @@
 void VECznorm(int N, vec_t *vec, vec_t mean, vec_t stddev)
 {
     if (N <=0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->znorm(N, vec, mean, stddev);
+	return;
+    }
+#endif
     int i;
     for (i=0; i<N; i++)
 	vec[i] = (vec[i]-mean)/stddev;
@@ -36,6 +51,12 @@ void VECznorm(int N, vec_t *vec, vec_t mean, vec_t stddev)
 void VECsubf(int length, vec_t *vec1, vec_t *vec2, vec_t *vec3)
 {
      if (length <= 0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->sub(length, vec1, vec2, vec3);
+	return;
+    }
+#endif
      while (length--) {
         *vec3 = *vec1++ - *vec2++;
         vec3++;
@@ -49,6 +70,11 @@ vec_t VECdotf(int length, vec_t *vec1, vec_t *vec2)
 {
       vec_t sum=0.0;
       if (length <= 0) return(0.0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->dot(length, vec1, vec2));
+    }
+#endif
       while (length--)
          sum += *vec1++ * *vec2++;
       return(sum);
@@ -60,6 +86,12 @@ vec_t VECdotf(int length, vec_t *vec1, vec_t *vec2)
 void VECcopyf(int length, vec_t *x, vec_t *y)
 {
      if (length <= 0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL && (x+length <= y || y+length <= x)) {
+	vecsimd->copy(length, x, y);
+	return;
+    }
+#endif
      while (length--)
          *x++ = *y++;
 }
@@ -71,6 +103,11 @@ vec_t VECmaxf(int length, vec_t *vec)
 {
      vec_t max = -1e38;
      if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->max(length, vec, max, (int *)NULL));
+    }
+#endif
      while (length--) {
         if (*vec > max)
            max = *vec;
@@ -87,6 +124,11 @@ vec_t VECmaxposf(int length, vec_t *vec, int *pos)
      vec_t max = -1e38;
      int   j=0;          /* current position to vec[] */
      if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->max(length, vec, max, pos));
+    }
+#endif
      while (length--) {
         if (*vec > max) {
            max = *vec;
@@ -106,6 +148,11 @@ vec_t VECamaxposf(int length, vec_t *vec, int *pos)
      vec_t max = -1e38;
      int   j=0;          /* current position to vec[] */
      if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->amax(length, vec, max, pos));
+    }
+#endif
      while (length--) {
         if (fabs(*vec) > max) {
            max = fabs(*vec);
@@ -126,6 +173,11 @@ vec_t VECminposf(int length, vec_t *vec, int *pos)
      vec_t min = 1e38;
      int   j=0;          /* current position to vec[] */
      if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->min(length, vec, min, pos));
+    }
+#endif
      while (length--) {
         if (*vec < min) {
            min = *vec;
@@ -145,6 +197,11 @@ vec_t VECminf(int length, vec_t *vec)
 {
      vec_t min = 1e38;
      if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->min(length, vec, min, (int *)NULL));
+    }
+#endif
      while (length--) {
 	if (*vec<min)
 	   min = *vec;
@@ -162,6 +219,11 @@ vec_t VECamaxf(int length, vec_t *vec)
      vec_t max = 0.0;
      vec_t temp;
      if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->amax(length, vec, max, (int *)NULL));
+    }
+#endif
      while (length--) {
         if ((temp=fabs(*vec++)) > max)
            max = temp;
@@ -175,6 +237,12 @@ vec_t VECamaxf(int length, vec_t *vec)
 void VECmulalphaf(int length, vec_t a, vec_t *vec)
 {
     if (length <= 0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->scale(length, a, vec);
+	return;
+    }
+#endif
     while (length--) {
        *vec *= a;
        vec++;
@@ -189,6 +257,11 @@ vec_t VECmetricf(int length, vec_t *x, vec_t *y)
 {
     vec_t sum=0.0;
     if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->adist(length, x, y));
+    }
+#endif
     while (length--)
        sum += fabs(*x++ - *y++);
     return(sum);
@@ -203,6 +276,11 @@ vec_t VECedistf(int length, vec_t *x, vec_t *y)
     vec_t sum=0.0;
     vec_t temp;
     if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(sqrt(vecsimd->sqdist(length, x, y)));
+    }
+#endif
     while (length--) {
        temp = (*x++ - *y++);
        sum += temp*temp;
@@ -220,6 +298,11 @@ vec_t VECsqedistf(int length, vec_t *x, vec_t *y)
     vec_t sum=0.0;
     vec_t temp;
     if (length <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->sqdist(length, x, y));
+    }
+#endif
     while (length--) {
        temp = (*x++ - *y++);
        sum += temp*temp;
@@ -347,6 +430,12 @@ vec_t VECmattracef(int M, vec_t **A)
 void VECmuladdf(int length, vec_t a, vec_t *x, vec_t *y)
 {
     if (length <= 0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->axpy(length, a, y, x);
+	return;
+    }
+#endif
     while (length--) {
        *x += a * *y++;
        x++;
@@ -416,6 +505,12 @@ void VECmvmulf(int numrows, int numcols, vec_t *v, vec_t *A, vec_t *u)
 void VECaddalphaf(int length, vec_t a, vec_t *x)
 {
      if (length <= 0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->shift(length, a, x);
+	return;
+    }
+#endif
      while (length--) {
         *x += a;
         x++;
@@ -429,6 +524,12 @@ void VECaddalphaf(int length, vec_t a, vec_t *x)
 void VECaddf(int length, vec_t *x, vec_t *y)
 {
      if (length <= 0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->add(length, x, y);
+	return;
+    }
+#endif
      while (length--) {
         *x += *y++;
         x++;
@@ -441,6 +542,12 @@ void VECaddf(int length, vec_t *x, vec_t *y)
 void VECfillf(int n, vec_t a, vec_t *x)
 {
      if (n<=0) return;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	vecsimd->fill(n, a, x);
+	return;
+    }
+#endif
      while (n--)
 	*x++ = a;
 }
@@ -473,6 +580,11 @@ vec_t VECmeanf(int n, vec_t *x)
      int i;
      vec_t sum;
      if (n<=0) return 0.0;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->sum(n, x)/n);
+    }
+#endif
      for (sum=0.0,i=0; i<n; i++)
          sum += x[i];
      return(sum/n);
@@ -487,6 +599,11 @@ vec_t VECstddevf(int n, vec_t *x)
       vec_t mean,sum,temp;
       if (n<=0) return 0.0;
       mean = VECmeanf(n,x);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(sqrt(vecsimd->sqdev(n, x, mean)/n));
+    }
+#endif
       for (sum=0.0,i=0; i<n; i++) {
 	  temp = x[i] - mean;
 	  sum += temp*temp;
@@ -503,6 +620,12 @@ void  VECstatf(int n, vec_t *x, vec_t *mean, vec_t *stddev)
       vec_t sum,temp;
       if (n<=0) return;
       *mean = VECmeanf(n,x);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	*stddev = sqrt(vecsimd->sqdev(n, x, *mean)/n);
+	return;
+    }
+#endif
       for (sum=0.0,i=0; i<n; i++) {
 	  temp = x[i] - *mean;
 	  sum += temp*temp;
@@ -539,6 +662,11 @@ vec_t VECL2normf(int n, vec_t *x)
     vec_t sum=0.0;
     int   i;   
     if (n <= 0) return(0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->dot(n, x, x));
+    }
+#endif
     for (i=0; i<n; i++)
         sum += x[i]*x[i];
     return(sum);
@@ -1018,6 +1146,11 @@ vec_t VECsumf(int length, const vec_t *x)
 {
     vec_t sum=0.0;
     if (length <= 0) return 0;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->sum(length, x));
+    }
+#endif
     while (length--) {
         sum += *x;
         x++;
@@ -1032,6 +1165,11 @@ vec_t VECasumf(int length, const vec_t *x)
 {
     vec_t sum=0.0;
     if (length <= 0) return 0;
+#ifndef REFERENCE_IMPL
+    if (vecsimd != NULL) {
+	return(vecsimd->asum(length, x));
+    }
+#endif
     while (length--) {
         sum += fabs(*x);
         x++;
@@ -1051,12 +1189,99 @@ vec_t VECL2norms(int n, short *x)
     vec_t sum=0.0;
     int   i;   
     if (n <= 0) return(0.0);
+#ifndef REFERENCE_IMPL
+    if (vecsimd_s != NULL)
+	return((vec_t)vecsimd_s->sqsums(n, x));
+#endif
     for (i=0; i<n; i++)
         sum += (vec_t)x[i]*(vec_t)x[i];
     return(sum);
 }
 
 
+/****************************************************************************/
+/*  VECasums: return the sum of |xi| of vector x                            */
+/****************************************************************************/
+vec_t VECasums(unsigned long n, short *x)
+{
+    unsigned long long sum=0;
+    unsigned long i;
+#ifndef REFERENCE_IMPL
+    if (vecsimd_s != NULL)
+	return((vec_t)vecsimd_s->asums(n, x));
+#endif
+    for (i=0; i<n; i++)
+        sum += abs(x[i]);
+    return((vec_t)sum);
+}
+
+
+/****************************************************************************/
+/*  VECsgnchgs: return the number of i in [1,n) with (xi>0) != (x(i-1)>0),  */
+/*              i.e. the sign changes of x, 0 counting as negative          */
+/****************************************************************************/
+unsigned long VECsgnchgs(unsigned long n, short *x)
+{
+    unsigned long sum=0;
+    unsigned long i;
+#ifndef REFERENCE_IMPL
+    if (vecsimd_s != NULL)
+	return(vecsimd_s->sgnchg(n, x));
+#endif
+    for (i=1; i<n; i++)
+        sum += ((x[i] > 0) != (x[i-1] > 0));
+    return(sum);
+}
+
+
+/****************************************************************************/
+/*  VECnzposs: return the position of the first non-zero element of x,      */
+/*             n if all elements are zero                                   */
+/****************************************************************************/
+unsigned long VECnzposs(unsigned long n, short *x)
+{
+    unsigned long i;
+#ifndef REFERENCE_IMPL
+    if (vecsimd_s != NULL)
+	return(vecsimd_s->nzpos(n, x));
+#endif
+    for (i=0; i<n; i++) {
+	if (x[i] != 0)
+	    return(i);
+    }
+    return(n);
+}
+
+
+/****************************************************************************/
+/*  VECsummarys: sum of xi, sum of |xi|, max |xi| and VECsgnchgs() of       */
+/*               vector x in one pass                                       */
+/****************************************************************************/
+void VECsummarys(unsigned long n, short *x, long long *sum, unsigned long long *asum,
+		 int *amax, unsigned long *sgnchg)
+{
+    unsigned long i;
+#ifndef REFERENCE_IMPL
+    if (vecsimd_s != NULL) {
+	vecsimd_s->summarys(n, x, sum, asum, amax, sgnchg);
+	return;
+    }
+#endif
+    *sum = 0;
+    *asum = 0;
+    *amax = 0;
+    *sgnchg = 0;
+    for (i=0; i<n; i++) {
+	*sum += x[i];
+	*asum += abs(x[i]);
+	if (abs(x[i]) > *amax)
+	    *amax = abs(x[i]);
+	if (i > 0)
+	    *sgnchg += ((x[i] > 0) != (x[i-1] > 0));
+    }
+}
+
+
 
 /*
 main()
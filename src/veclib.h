@@ -56,6 +56,7 @@ void VECpermutef(int N, vec_t *s);
 void VECswapf(int N, vec_t *s);
 vec_t VECsumf(int length, const vec_t *x);
 vec_t VECasumf(int length, const vec_t *x);
+const char *VECsimd_name(void);
 
 
 /* Function Prototype for huge floating point version */
@@ -95,6 +96,11 @@ int  VECamaxiHuge(int length, int huge *vec);
 /* Function prototypes for short int version */
 short VECamaxShortHuge(int length, short huge *vec);
 vec_t VECL2norms(int n, short *x);
+vec_t VECasums(unsigned long n, short *x);
+unsigned long VECsgnchgs(unsigned long n, short *x);
+unsigned long VECnzposs(unsigned long n, short *x);
+void VECsummarys(unsigned long n, short *x, long long *sum, unsigned long long *asum,
+		 int *amax, unsigned long *sgnchg);
 
 
 #endif    /* end of veclib.h */
@@ -0,0 +1,379 @@
+/*
+   Filename	:veclib_kern.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Kernels of veclib_simd.c. This file is included once per
+                 instruction set with KERN(f) giving the function names,
+		 TARGET the target attribute, SIMD_NAME the name of the
+		 table, VD (VL) the vector type of W doubles (long longs) of
+		 the instruction set and NV = 8/W. A block of 8 doubles is
+		 held in NV registers (4 for SSE2, 2 for AVX2, 1 for AVX-512),
+		 so that element i is always added to partial sum i%8 and the
+		 summation order is the same for all instruction sets (see
+		 veclib_simd.h).
+*/
+
+#define W (8/NV)
+#define NS (int)(sizeof(VS)/sizeof(short))
+
+/* Sum of the 8 partial sums in a[0..NV-1], in the order of veclib_simd.h */
+#define REDUCE(a, s) do {						\
+	double p_[8];							\
+	memcpy(p_, (a), sizeof(p_));					\
+	(s) = REDUCE8(p_);						\
+} while (0)
+
+/* acc[r] += EXPR(v[r],w[r]) over the blocks of 8, then the sum of the tail */
+#define REDUCTION(EXPR, Y, TAIL)					\
+	VD acc[NV], v, w;						\
+	double s;							\
+	int i, r;							\
+									\
+	for (r=0; r<NV; r++)						\
+	    acc[r] = (VD){0};						\
+	for (i=0; i+8<=n; i+=8) {					\
+	    for (r=0; r<NV; r++) {					\
+		LOADV(v, x+i+r*W);					\
+		LOADV(w, (Y)+i+r*W);					\
+		acc[r] += EXPR;						\
+	    }								\
+	}								\
+	REDUCE(acc, s);							\
+	for (; i<n; i++)						\
+	    s += TAIL;							\
+	return s;
+
+static TARGET double KERN(sum)(int n, const double *x)
+{
+	REDUCTION(v, x, x[i])
+}
+
+static TARGET double KERN(asum)(int n, const double *x)
+{
+	REDUCTION(ABSV(v), x, fabs(x[i]))
+}
+
+static TARGET double KERN(dot)(int n, const double *x, const double *y)
+{
+	REDUCTION(v*w, y, x[i]*y[i])
+}
+
+static TARGET double KERN(sqdist)(int n, const double *x, const double *y)
+{
+	REDUCTION((v-w)*(v-w), y, (x[i]-y[i])*(x[i]-y[i]))
+}
+
+static TARGET double KERN(adist)(int n, const double *x, const double *y)
+{
+	REDUCTION(ABSV(v-w), y, fabs(x[i]-y[i]))
+}
+
+static TARGET double KERN(sqdev)(int n, const double *x, double mean)
+{
+	REDUCTION((v-mean)*(v-mean), x, (x[i]-mean)*(x[i]-mean))
+}
+
+#undef REDUCTION
+
+/* Each lane keeps its extremum and where it was first found (-1: not beyond init),
+   then the lanes are merged, taking the first position of equal values */
+#define EXTREMUM(CMP, ABSV_, ABS_)						\
+	VD best[NV], v;							\
+	VL at[NV], idx[NV], m;						\
+	double ext = init;						\
+	int i, k, r, p = -1;						\
+									\
+	for (r=0; r<NV; r++) {						\
+	    best[r] = (VD){0} + init;					\
+	    at[r] = (VL){0} - 1;					\
+	    for (k=0; k<W; k++)						\
+		idx[r][k] = r*W+k;					\
+	}								\
+	for (i=0; i+8<=n; i+=8) {					\
+	    for (r=0; r<NV; r++) {					\
+		LOADV(v, x+i+r*W);					\
+		v = ABSV_(v);						\
+		m = (v CMP best[r]);					\
+		best[r] = SELECTV(m, v, best[r]);			\
+		at[r] = (m & idx[r]) | (~m & at[r]);			\
+		idx[r] += 8;						\
+	    }								\
+	}								\
+	for (r=0; r<NV; r++) {						\
+	    for (k=0; k<W; k++) {					\
+		if (at[r][k] >= 0 &&					\
+		    (best[r][k] CMP ext || (best[r][k] == ext && at[r][k] < p))) { \
+		    ext = best[r][k];					\
+		    p = (int)at[r][k];					\
+		}							\
+	    }								\
+	}								\
+	for (; i<n; i++) {						\
+	    if (ABS_(x[i]) CMP ext) {					\
+		ext = ABS_(x[i]);					\
+		p = i;							\
+	    }								\
+	}								\
+	if (pos != NULL && p >= 0)					\
+	    *pos = p;							\
+	return ext;
+
+static TARGET double KERN(max)(int n, const double *x, double init, int *pos)
+{
+	EXTREMUM(>, , )
+}
+
+static TARGET double KERN(min)(int n, const double *x, double init, int *pos)
+{
+	EXTREMUM(<, , )
+}
+
+static TARGET double KERN(amax)(int n, const double *x, double init, int *pos)
+{
+	EXTREMUM(>, ABSV, fabs)
+}
+
+#undef EXTREMUM
+
+/* z[i] = EXPR(v,w) with v = x[i], w = y[i] */
+#define ELEMENTWISE(Y, Z, EXPR)						\
+	VD v, w;							\
+	int i;								\
+									\
+	for (i=0; i+W<=n; i+=W) {					\
+	    LOADV(v, x+i);						\
+	    LOADV(w, (Y)+i);						\
+	    v = EXPR;							\
+	    STOREV((Z)+i, v);						\
+	}								\
+	for (; i<n; i++) {						\
+	    double v = x[i], w = (Y)[i];				\
+	    (void)w;							\
+	    (Z)[i] = EXPR;						\
+	}
+
+static TARGET void KERN(scale)(int n, double a, double *x)
+{
+	ELEMENTWISE(x, x, v*a)
+}
+
+static TARGET void KERN(shift)(int n, double a, double *x)
+{
+	ELEMENTWISE(x, x, v+a)
+}
+
+static TARGET void KERN(add)(int n, double *x, const double *y)
+{
+	ELEMENTWISE(y, x, v+w)
+}
+
+static TARGET void KERN(sub)(int n, const double *x, const double *y, double *z)
+{
+	ELEMENTWISE(y, z, v-w)
+}
+
+static TARGET void KERN(axpy)(int n, double a, const double *x, double *y)
+{
+	ELEMENTWISE(y, y, w+a*v)
+}
+
+static TARGET void KERN(copy)(int n, double *y, const double *x)
+{
+	ELEMENTWISE(x, y, v)
+}
+
+static TARGET void KERN(znorm)(int n, double *x, double mean, double stddev)
+{
+	ELEMENTWISE(x, x, (v-mean)/stddev)
+}
+
+#undef ELEMENTWISE
+
+static TARGET void KERN(fill)(int n, double a, double *x)
+{
+	VD v = (VD){0} + a;
+	int i;
+
+	for (i=0; i+W<=n; i+=W)
+	    STOREV(x+i, v);
+	for (; i<n; i++)
+	    x[i] = a;
+}
+
+/* Number of i in [1,n) where x[i]>0 differs from x[i-1]>0. The 16-bit
+   counters of the lanes are added up before they can overflow */
+static TARGET unsigned long KERN(sgnchg)(unsigned long n, const short *x)
+{
+	VS v, u, c;
+	unsigned long i, cnt = 0;
+	int b, k;
+
+	for (i=1; i+NS<=n; ) {
+	    c = (VS){0};
+	    for (b=0; b<32767 && i+NS<=n; b++, i+=NS) {
+		LOADS(v, x+i);
+		LOADS(u, x+i-1);
+		c -= (v > 0) ^ (u > 0);				/* -1 where sgn() changes */
+	    }
+	    for (k=0; k<NS; k++)
+		cnt += (unsigned long)c[k];
+	}
+	for (; i<n; i++)
+	    cnt += ((x[i] > 0) != (x[i-1] > 0));
+	return cnt;
+}
+
+/* |x| is taken in 16 unsigned bits (|-32768| = 32768) and added as its low
+   and high bytes, whose 16-bit sums cannot overflow in 256 blocks */
+static TARGET unsigned long long KERN(asums)(unsigned long n, const short *x)
+{
+	VS v;
+	VUS a, m, lo, hi;
+	unsigned long long s = 0;
+	unsigned long i;
+	int b, k;
+
+	for (i=0; i+NS<=n; ) {
+	    lo = hi = (VUS){0};
+	    for (b=0; b<256 && i+NS<=n; b++, i+=NS) {
+		LOADS(v, x+i);
+		m = (VUS)(v >> 15);
+		a = ((VUS)v ^ m) - m;
+		lo += a & 0xff;
+		hi += a >> 8;
+	    }
+	    for (k=0; k<NS; k++)
+		s += lo[k] + 256ULL*hi[k];
+	}
+	for (; i<n; i++)
+	    s += abs(x[i]);
+	return s;
+}
+
+/* x^2 <= 2^30 is taken in 32 bits and added as its low and high 16 bits,
+   whose 32-bit sums cannot overflow in 65535 blocks */
+static TARGET unsigned long long KERN(sqsums)(unsigned long n, const short *x)
+{
+	VS v;
+	VUI q, lo, hi;
+	unsigned long long s = 0;
+	unsigned long i;
+	int b, k;
+
+	for (i=0; i+NS<=n; ) {
+	    lo = hi = (VUI){0};
+	    for (b=0; b<65535 && i+NS<=n; b++, i+=NS) {
+		LOADS(v, x+i);
+		q = (VUI)__builtin_convertvector(v, VI);
+		q *= q;
+		lo += q & 0xffff;
+		hi += q >> 16;
+	    }
+	    for (k=0; k<NS; k++)
+		s += lo[k] + 65536ULL*hi[k];
+	}
+	for (; i<n; i++)
+	    s += (unsigned long long)(x[i]*x[i]);
+	return s;
+}
+
+/* sum, asum, amax and sgnchg of x[] in one pass. x+32768 is summed in the
+   same way as |x|, and the bias is subtracted from the sum of each block */
+static TARGET void KERN(summarys)(unsigned long n, const short *x, long long *sum,
+				  unsigned long long *asum, int *amax, unsigned long *sgnchg)
+{
+	VS v, u, c;
+	VUS a, m, lo, hi, blo, bhi, mx = (VUS){0};
+	long long s = 0;
+	unsigned long long as = 0;
+	unsigned long i, cnt = 0;
+	int b, k, peak = 0;
+
+	if (n > 0) {
+	    s = x[0];
+	    as = peak = abs(x[0]);
+	}
+	for (i=1; i+NS<=n; ) {
+	    c = (VS){0};
+	    lo = hi = blo = bhi = (VUS){0};
+	    for (b=0; b<256 && i+NS<=n; b++, i+=NS) {
+		LOADS(v, x+i);
+		LOADS(u, x+i-1);
+		c -= (v > 0) ^ (u > 0);
+		m = (VUS)(v >> 15);
+		a = ((VUS)v ^ m) - m;
+		lo += a & 0xff;
+		hi += a >> 8;
+		m = (VUS)(a > mx);
+		mx = (m & a) | (~m & mx);
+		a = (VUS)v ^ 0x8000;
+		blo += a & 0xff;
+		bhi += a >> 8;
+	    }
+	    for (k=0; k<NS; k++) {
+		cnt += (unsigned long)c[k];
+		as += lo[k] + 256ULL*hi[k];
+		s += (long long)(blo[k] + 256ULL*bhi[k]);
+	    }
+	    s -= 32768LL*NS*b;
+	}
+	for (k=0; k<NS; k++) {
+	    if (mx[k] > peak)
+		peak = mx[k];
+	}
+	for (; i<n; i++) {
+	    s += x[i];
+	    as += abs(x[i]);
+	    if (abs(x[i]) > peak)
+		peak = abs(x[i]);
+	    cnt += ((x[i] > 0) != (x[i-1] > 0));
+	}
+	*sum = s;
+	*asum = as;
+	*amax = peak;
+	*sgnchg = cnt;
+}
+
+/* Blocks of 4 vectors are OR-ed together and tested as 64-bit words, so that
+   runs of zeros are passed at full speed; the first non-zero block is searched
+   element by element */
+static TARGET unsigned long KERN(nzpos)(unsigned long n, const short *x)
+{
+	VS v, w;
+	unsigned long long q[sizeof(VS)/8], any;
+	unsigned long i;
+	int r, k;
+
+	for (i=0; i+4*NS<=n; i+=4*NS) {
+	    LOADS(v, x+i);
+	    for (r=1; r<4; r++) {
+		LOADS(w, x+i+r*NS);
+		v |= w;
+	    }
+	    memcpy(q, &v, sizeof(q));
+	    for (any=0, k=0; k<(int)(sizeof(q)/8); k++)
+		any |= q[k];
+	    if (any)
+		break;
+	}
+	for (; i<n; i++) {
+	    if (x[i] != 0)
+		return i;
+	}
+	return n;
+}
+
+static const VECSIMD KERN(table) = {
+	SIMD_NAME,
+	KERN(sum), KERN(asum), KERN(dot), KERN(sqdist), KERN(adist), KERN(sqdev),
+	KERN(max), KERN(min), KERN(amax),
+	KERN(scale), KERN(shift), KERN(add), KERN(sub), KERN(axpy), KERN(fill), KERN(copy),
+	KERN(znorm),
+	KERN(sgnchg), KERN(asums), KERN(sqsums), KERN(summarys),
+	KERN(nzpos)
+};
+
+#undef W
+#undef NS
+#undef REDUCE
@@ -0,0 +1,196 @@
+/*
+   Filename	:veclib_simd.c
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:SIMD kernels of veclib.c with run-time CPU dispatch.
+                 The kernels of veclib_kern.h are compiled for the default
+		 target and, on x86, for SSE2, AVX2 and AVX-512F. When the
+		 program (or libssvad.so) is loaded, vecsimd is set to the
+		 table of the best instruction set of the CPU, so that one
+		 binary runs on all x86-64 machines. The environment variable
+		 SSVAD_SIMD (avx512, avx2, sse2 or generic) limits the choice,
+		 e.g. to compare the instruction sets or to avoid AVX-512
+		 clock throttling. The results do not depend on the choice;
+		 see veclib_simd.h for the summation order.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "veclib.h"
+#include "veclib_simd.h"
+
+/* Do not contract a*b+c to a fused multiply-add, whose rounding differs */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+typedef double v2d __attribute__((vector_size(16)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef double v8d __attribute__((vector_size(64)));
+typedef long long v2l __attribute__((vector_size(16)));
+typedef long long v4l __attribute__((vector_size(32)));
+typedef long long v8l __attribute__((vector_size(64)));
+typedef short v8s __attribute__((vector_size(16)));
+typedef short v16s __attribute__((vector_size(32)));
+typedef unsigned short v8us __attribute__((vector_size(16)));
+typedef unsigned short v16us __attribute__((vector_size(32)));
+typedef int v8i __attribute__((vector_size(32)));
+typedef int v16i __attribute__((vector_size(64)));
+typedef unsigned int v8ui __attribute__((vector_size(32)));
+typedef unsigned int v16ui __attribute__((vector_size(64)));
+
+#define LOADV(v,p)	memcpy(&(v), (p), sizeof(VD))
+#define STOREV(p,v)	memcpy((p), &(v), sizeof(VD))
+#define LOADS(v,p)	memcpy(&(v), (p), sizeof(VS))
+#define ABSV(v)		((VD)((VL)(v) & 0x7fffffffffffffffLL))	/* Clear the sign bits */
+#define SELECTV(m,a,b)	((VD)(((m) & (VL)(a)) | (~(m) & (VL)(b))))
+#define REDUCE8(s)	((((s)[0]+(s)[4])+((s)[2]+(s)[6]))+(((s)[1]+(s)[5])+((s)[3]+(s)[7])))
+
+const VECSIMD *vecsimd;
+const VECSIMD *vecsimd_s;
+
+#define KERN(f)		f##_generic
+#define TARGET
+#define SIMD_NAME	"generic"
+#define VD		v2d
+#define VL		v2l
+#define NV		4
+#define VS		v8s
+#define VUS		v8us
+#define VI		v8i
+#define VUI		v8ui
+#include "veclib_kern.h"
+#undef KERN
+#undef TARGET
+#undef SIMD_NAME
+#undef VD
+#undef VL
+#undef NV
+#undef VS
+#undef VUS
+#undef VI
+#undef VUI
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERN(f)		f##_sse2
+#define TARGET		__attribute__((target("sse2")))
+#define SIMD_NAME	"sse2"
+#define VD		v2d
+#define VL		v2l
+#define NV		4
+#define VS		v8s
+#define VUS		v8us
+#define VI		v8i
+#define VUI		v8ui
+#include "veclib_kern.h"
+#undef KERN
+#undef TARGET
+#undef SIMD_NAME
+#undef VD
+#undef VL
+#undef NV
+#undef VS
+#undef VUS
+#undef VI
+#undef VUI
+
+#define KERN(f)		f##_avx2
+#define TARGET		__attribute__((target("avx2")))
+#define SIMD_NAME	"avx2"
+#define VD		v4d
+#define VL		v4l
+#define NV		2
+#define VS		v16s
+#define VUS		v16us
+#define VI		v16i
+#define VUI		v16ui
+#include "veclib_kern.h"
+#undef KERN
+#undef TARGET
+#undef SIMD_NAME
+#undef VD
+#undef VL
+#undef NV
+#undef VS
+#undef VUS
+#undef VI
+#undef VUI
+
+#define KERN(f)		f##_avx512
+#define TARGET		__attribute__((target("avx512f")))
+#define SIMD_NAME	"avx512"
+#define VD		v8d
+#define VL		v8l
+#define NV		1
+#define VS		v16s		/* 16-bit lanes need AVX-512BW; use the AVX2 width */
+#define VUS		v16us
+#define VI		v16i
+#define VUI		v16ui
+#include "veclib_kern.h"
+#undef KERN
+#undef TARGET
+#undef SIMD_NAME
+#undef VD
+#undef VL
+#undef NV
+#undef VS
+#undef VUS
+#undef VI
+#undef VUI
+
+/* From the best to the worst */
+static const VECSIMD *tables[] = {&table_avx512, &table_avx2, &table_sse2, &table_generic};
+#else
+static const VECSIMD *tables[] = {&table_generic};
+#endif
+
+#define NUM_TABLES (int)(sizeof(tables)/sizeof(tables[0]))
+
+
+/* Whether the CPU (and OS) support the instruction set of table t */
+static int cpu_supports(const VECSIMD *t)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (t == &table_avx512)
+	    return __builtin_cpu_supports("avx512f");
+	if (t == &table_avx2)
+	    return __builtin_cpu_supports("avx2");
+	if (t == &table_sse2)
+	    return __builtin_cpu_supports("sse2");
+#endif
+	return 1;
+}
+
+
+__attribute__((constructor)) static void vecsimd_init(void)
+{
+	const char *limit = getenv("SSVAD_SIMD");
+	int i, first = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+#endif
+	for (i=0; limit != NULL && i<NUM_TABLES; i++) {
+	    if (strcmp(limit, tables[i]->name) == 0)
+		first = i;
+	}
+	for (i=first; i<NUM_TABLES; i++) {
+	    if (cpu_supports(tables[i])) {
+		vecsimd_s = tables[i];
+		break;
+	    }
+	}
+	if (sizeof(vec_t) == sizeof(double))
+	    vecsimd = vecsimd_s;	/* else veclib.c uses its plain loops */
+}
+
+
+/* Instruction set of the veclib.c kernels, "none" if the plain loops are used */
+const char *VECsimd_name(void)
+{
+	return (vecsimd != NULL) ? vecsimd->name : "none";
+}
@@ -0,0 +1,60 @@
+/*
+   Filename	:veclib_simd.h
+   Version	:1.0
+   Date		:Oct 26
+   Author	:M.W. Mak (enmwmak@polyu.edu.hk)
+   Description	:Kernels of veclib.c for vec_t = double, one table per
+                 instruction set (veclib_simd.c). vecsimd points to the
+		 table chosen for the CPU when the program starts, and is
+		 NULL if vec_t is not double, in which case veclib.c uses
+		 its plain loops.
+
+		 Summation order: the reductions (sum, asum, dot, sqdist,
+		 adist, sqdev) add element i to partial sum i%8 for the
+		 elements of the first 8*floor(n/8), combine the 8 partial
+		 sums as ((s0+s4)+(s2+s6))+((s1+s5)+(s3+s7)), and then add
+		 the remaining elements in order. This order is the same for
+		 every table (no FMA is used), so that the results do not
+		 depend on the CPU, but it differs from the sequential sum
+		 of the plain loops kept under REFERENCE_IMPL by rounding
+		 (relative difference of the order of n*DBL_EPSILON).
+		 max, min, amax and the element-wise kernels give exactly
+		 the results of the plain loops; max, min and amax return
+		 init if no element is larger (smaller), and pos is the
+		 first position of the extremum, as VECmaxposf().
+*/
+
+#ifndef __VECLIB_SIMD_INCLUDED__
+#define __VECLIB_SIMD_INCLUDED__
+
+typedef struct {
+	const char *name;
+	double (*sum)(int n, const double *x);
+	double (*asum)(int n, const double *x);
+	double (*dot)(int n, const double *x, const double *y);
+	double (*sqdist)(int n, const double *x, const double *y);	/* sum (x-y)^2 */
+	double (*adist)(int n, const double *x, const double *y);	/* sum |x-y| */
+	double (*sqdev)(int n, const double *x, double mean);		/* sum (x-mean)^2 */
+	double (*max)(int n, const double *x, double init, int *pos);	/* pos may be NULL */
+	double (*min)(int n, const double *x, double init, int *pos);
+	double (*amax)(int n, const double *x, double init, int *pos);
+	void (*scale)(int n, double a, double *x);			/* x = a*x */
+	void (*shift)(int n, double a, double *x);			/* x = x+a */
+	void (*add)(int n, double *x, const double *y);			/* x = x+y */
+	void (*sub)(int n, const double *x, const double *y, double *z);	/* z = x-y */
+	void (*axpy)(int n, double a, const double *x, double *y);	/* y = y+a*x */
+	void (*fill)(int n, double a, double *x);
+	void (*copy)(int n, double *x, const double *y);		/* x = y, no overlap */
+	void (*znorm)(int n, double *x, double mean, double stddev);
+	unsigned long (*sgnchg)(unsigned long n, const short *x);	/* #i with (x[i]>0) != (x[i-1]>0) */
+	unsigned long long (*asums)(unsigned long n, const short *x);	/* sum |x| */
+	unsigned long long (*sqsums)(unsigned long n, const short *x);	/* sum x^2 */
+	void (*summarys)(unsigned long n, const short *x, long long *sum,	/* all in one pass */
+			 unsigned long long *asum, int *amax, unsigned long *sgnchg);
+	unsigned long (*nzpos)(unsigned long n, const short *x);	/* first i with x[i] != 0, n if none */
+} VECSIMD;
+
+extern const VECSIMD *vecsimd;
+extern const VECSIMD *vecsimd_s;
+
+#endif
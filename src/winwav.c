@@ -3,82 +3,371 @@
 /*  Author: M.W. Mak                                                        */
 /*  DESCRIPTION :                                                           */
 /*     This file reads and writes MS windows .wav file to and from memory   */
+/*  Modified (Oct 26): .wav and headerless PCM files are mapped in memory   */
+/*     and de-interleaved in one pass (WavReadChannels, RawReadChannels).   */
+/*     WavRead() used to fread one sample at a time and read sequential     */
+/*     samples of multichannel files as if they belonged to one channel.    */
+/*  Modified (Oct 26): Only the region [start,end) (in sec) is converted. */
+/*  Modified (Oct 26): WavRead() returns 8-bit data as -128..127 again.    */
 /* ------------------------------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "mmalloc.h"
 #include "winwav.h"
 
-INT16 *WavRead(char *WavFileName, WAV_HDR *WavHdr, unsigned long *num_smps)
+/* Little-endian field access, independent of the host byte order */
+#define LE16(p) ((unsigned)(p)[0] | ((unsigned)(p)[1] << 8))
+#define LE32(p) ((unsigned long)(p)[0] | ((unsigned long)(p)[1] << 8) | \
+                 ((unsigned long)(p)[2] << 16) | ((unsigned long)(p)[3] << 24))
+
+
+/* ------------------------------------------------------------------------ */
+/* map_file(): Map the whole file in memory. If mmap() is not possible,   */
+/*             e.g. for a pipe, the file is read with a single fread().   */
+/* ------------------------------------------------------------------------ */
+static unsigned char *map_file(char *FileName, unsigned long *size, int *mapped)
 {
-    FILE    *wavfile;
-    INT16   *sample;
-    INT32   num_samples,i;
+    int fd;
+    struct stat st;
+    unsigned char *p;
+    FILE *fp;
 
-    if ((wavfile=fopen(WavFileName,"rb"))==NULL) {
-        fprintf(stderr,"%s not found\n",WavFileName);
-        return ((INT16 *)NULL);
+    *mapped = 0;
+    if ((fd=open(FileName,O_RDONLY))<0 || fstat(fd,&st)!=0) {
+        if (fd>=0) close(fd);
+        fprintf(stderr,"%s not found\n",FileName);
+        return((unsigned char *)NULL);
+    }
+    *size = (unsigned long)st.st_size;
+    if (S_ISREG(st.st_mode) && st.st_size>0) {
+        p = (unsigned char *)mmap(NULL,*size,PROT_READ,MAP_PRIVATE,fd,0);
+        close(fd);
+        if (p!=(unsigned char *)MAP_FAILED) {
+            madvise(p,*size,MADV_SEQUENTIAL);
+            *mapped = 1;
+            return(p);
+        }
+    } else {
+        close(fd);
     }
 
-    if (fread(WavHdr,sizeof(WAV_HDR),1,wavfile)!=1) {
-        fprintf(stderr,"Error in reading %s file header\n",WavFileName);
-        return((INT16 *)NULL);
+    if ((fp=fopen(FileName,"rb"))==NULL || *size==0) {
+        if (fp) fclose(fp);
+        fprintf(stderr,"Error in reading %s\n",FileName);
+        return((unsigned char *)NULL);
+    }
+    p = (unsigned char *)malloc(*size);
+    if (p==NULL || fread(p,1,*size,fp)!=*size) {
+        fprintf(stderr,"Error in reading %s\n",FileName);
+        free(p);
+        fclose(fp);
+        return((unsigned char *)NULL);
     }
+    fclose(fp);
+    return(p);
+}
 
-    num_samples = WavHdr->dsize/(WavHdr->channel*WavHdr->bps/8);
-    *num_smps = num_samples;
-    sample=(INT16 *)malloc(num_samples*sizeof(INT16));
+static void unmap_file(unsigned char *p, unsigned long size, int mapped)
+{
+    if (mapped)
+        munmap(p,size);
+    else
+        free(p);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* parse_wav_header(): Walk the RIFF chunks to find "fmt " and "data".     */
+/*                     Return 0 on success, -1 on error.                   */
+/* ------------------------------------------------------------------------ */
+static int parse_wav_header(char *WavFileName, const unsigned char *p, unsigned long size,
+                            WAV_INFO *info)
+{
+    unsigned long pos, cksize, data_size = 0;
+    int have_fmt = 0;
 
-    if (!sample) {
-        fprintf(stderr,"Insufficient memory to allocate sample[]\n");
-	exit(EXIT_FAILURE);
+    if (size<12 || memcmp(p,"RIFF",4)!=0 || memcmp(p+8,"WAVE",4)!=0) {
+        fprintf(stderr,"%s is not a RIFF/WAVE file\n",WavFileName);
+        return(-1);
+    }
+    for (pos=12; pos+8<=size; pos+=8+cksize+(cksize&1)) {
+        cksize = LE32(p+pos+4);
+        if (memcmp(p+pos,"fmt ",4)==0 && cksize>=16 && pos+8+cksize<=size) {
+            info->fmtag = LE16(p+pos+8);
+            info->channel = LE16(p+pos+10);
+            info->srate = (INT32)LE32(p+pos+12);
+            info->align = LE16(p+pos+20);
+            info->bps = LE16(p+pos+22);
+            if (info->fmtag==WAVE_FORMAT_EXTENSIBLE && cksize>=40)
+                info->fmtag = LE16(p+pos+32);    /* First two bytes of the SubFormat GUID */
+            have_fmt = 1;
+        } else if (memcmp(p+pos,"data",4)==0) {
+            info->data_offset = pos+8;
+            data_size = cksize;
+            /* Streamed files may leave the size at 0 or 0xFFFFFFFF */
+            if (data_size==0 || data_size>size-info->data_offset)
+                data_size = size-info->data_offset;
+            break;
+        }
+    }
+    if (!have_fmt || info->data_offset==0) {
+        fprintf(stderr,"Error in reading %s file header\n",WavFileName);
+        return(-1);
     }
+    if (info->channel<1 || info->align<info->channel*info->bps/8 ||
+        !((info->fmtag==WAVE_FORMAT_PCM && (info->bps==8 || info->bps==16 || info->bps==24 || info->bps==32)) ||
+          (info->fmtag==WAVE_FORMAT_IEEE_FLOAT && info->bps==32))) {
+        fprintf(stderr,"%s: unsupported WAVE format (tag %d, %d channels, %d bits)\n",
+                WavFileName,info->fmtag,info->channel,info->bps);
+        return(-1);
+    }
+    info->num_frames = data_size/info->align;
+    return(0);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* WavDeinterleave(): Convert channel chan of num_frames sample frames in[] */
+/*                    to 16-bit PCM in out[]. 8-bit data is unsigned; 24-  */
+/*                    and 32-bit data keep their 16 most significant bits; */
+/*                    float data is scaled by 32768 and clipped.           */
+/* ------------------------------------------------------------------------ */
+void WavDeinterleave(const unsigned char *in, INT16 *out, unsigned long num_frames,
+                     WAV_INFO *info, int chan)
+{
+    unsigned long i = 0;
+    const unsigned char *p;
+    int step = info->align;
+    uint32_t u;
+    float f, x;
 
-    if (WavHdr->bps==8) {           /* 8 bits per sample*/
-        for (i=0;i<num_samples;i+=WavHdr->channel)
-        {
-            if (fread((unsigned char *)&sample[i],1,1,wavfile)!=1) {
-                fprintf(stderr,"\nError in reading %s data",WavFileName);
-                return((INT16 *)NULL);
+    if (info->fmtag==WAVE_FORMAT_PCM && info->bps==16) {
+#ifdef __SSE2__
+        /* x86 is little endian, so 16-bit samples can be moved as they are */
+        if (info->channel==1 && step==2) {
+            memcpy(out,in,num_frames*sizeof(INT16));
+            return;
+        }
+        if (info->channel==2 && step==4) {
+            for (; i+8<=num_frames; i+=8) {
+                __m128i v0 = _mm_loadu_si128((const __m128i *)&in[4*i]);
+                __m128i v1 = _mm_loadu_si128((const __m128i *)&in[4*i+16]);
+                if (chan==0) {
+                    v0 = _mm_srai_epi32(_mm_slli_epi32(v0,16),16);
+                    v1 = _mm_srai_epi32(_mm_slli_epi32(v1,16),16);
+                } else {
+                    v0 = _mm_srai_epi32(v0,16);
+                    v1 = _mm_srai_epi32(v1,16);
+                }
+                _mm_storeu_si128((__m128i *)&out[i],_mm_packs_epi32(v0,v1));
             }
-            sample[i]-=128;
         }
+#endif
+        for (p=in+i*step+2*chan; i<num_frames; i++, p+=step)
+            out[i] = (INT16)LE16(p);
+        return;
     }
 
-    if (WavHdr->bps==16) {          /* 16 bits per sample*/
-        for (i=0; i<num_samples; i+=WavHdr->channel)
-	{
-            if (fread(&sample[i],sizeof(INT16),1,wavfile)!=1) {
-                fprintf(stderr,"Error in reading %s data\n",WavFileName);
-                return((INT16 *)NULL);
-	    }
+    switch (info->bps) {
+    case 8:
+        for (p=in+chan; i<num_frames; i++, p+=step)
+            out[i] = (INT16)(((int)p[0]-128) << 8);
+        break;
+    case 24:
+        for (p=in+3*chan; i<num_frames; i++, p+=step)
+            out[i] = (INT16)LE16(p+1);
+        break;
+    case 32:
+        if (info->fmtag==WAVE_FORMAT_IEEE_FLOAT) {
+            for (p=in+4*chan; i<num_frames; i++, p+=step) {
+                u = (uint32_t)LE32(p);
+                memcpy(&f,&u,sizeof(f));      /* IEEE bits of the host float */
+                x = f*32768.0f;
+                out[i] = (x>=32767.0f) ? 32767 : (x<=-32768.0f) ? -32768 : (INT16)lrintf(x);
+            }
+        } else {
+            for (p=in+4*chan; i<num_frames; i++, p+=step)
+                out[i] = (INT16)LE16(p+2);
         }
+        break;
+    }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* read_channels(): De-interleave the kept channels of the sample frames   */
+/*                  in [start,end) sec. chan is the channel to keep, or -1 */
+/*                  to keep all. end<=0 means the end of the data. Only    */
+/*                  the pages of the region are touched in a mapped file.  */
+/* ------------------------------------------------------------------------ */
+static INT16 **read_channels(char *FileName, const unsigned char *data, WAV_INFO *info, int chan,
+                             double start, double end, unsigned long *num_smps)
+{
+    INT16 **sample;
+    unsigned long first, last;
+    int c;
+
+    first = SEC2SMP(start,info->srate);
+    last = (end>0.0) ? SEC2SMP(end,info->srate) : info->num_frames;
+    if (last>info->num_frames)
+        last = info->num_frames;
+    if (first>=last) {
+        fprintf(stderr,"%s: no samples between %.2f and %.2f sec\n",FileName,start,end);
+        return((INT16 **)NULL);
+    }
+
+    sample = (INT16 **)calloc(info->channel,sizeof(INT16 *));
+    for (c=0; c<info->channel; c++) {
+        if (chan>=0 && c!=chan)
+            continue;
+        sample[c] = (INT16 *)vector(0,last-first,sizeof(INT16));
+        WavDeinterleave(data+first*info->align,sample[c],last-first,info,c);
+    }
+    *num_smps = last-first;
+    return(sample);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* WavReadChannels(): Read a RIFF/WAVE file, including WAVE_FORMAT_         */
+/*     EXTENSIBLE, with 8/16/24/32-bit PCM or 32-bit float samples.         */
+/*     The file is mapped in memory and the channel chan (or all channels  */
+/*     if chan<0) is converted to 16-bit PCM in one pass. Only the samples */
+/*     in [start,end) sec are returned; end<=0 means the end of the file.  */
+/*     Return an array of info->channel sample arrays, NULL for channels   */
+/*     that are not kept, or NULL on error.                                */
+/* ------------------------------------------------------------------------ */
+INT16 **WavReadChannels(char *WavFileName, WAV_INFO *info, int chan, double start, double end,
+                        unsigned long *num_smps)
+{
+    unsigned char *p;
+    unsigned long size;
+    int mapped;
+    INT16 **sample;
+
+    memset(info,0,sizeof(WAV_INFO));
+    if ((p=map_file(WavFileName,&size,&mapped))==NULL)
+        return((INT16 **)NULL);
+    if (parse_wav_header(WavFileName,p,size,info)!=0) {
+        unmap_file(p,size,mapped);
+        return((INT16 **)NULL);
+    }
+    if (chan>=info->channel) {
+        fprintf(stderr,"%s has only %d channel(s)\n",WavFileName,info->channel);
+        unmap_file(p,size,mapped);
+        return((INT16 **)NULL);
+    }
+    sample = read_channels(WavFileName,p+info->data_offset,info,chan,start,end,num_smps);
+    unmap_file(p,size,mapped);
+    return(sample);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* RawReadChannels(): Read headerless little-endian PCM. info->channel,    */
+/*     info->bps (8, 16, 24 or 32) and info->srate must be set by caller.  */
+/*     Other fields are filled in. Return as WavReadChannels().            */
+/* ------------------------------------------------------------------------ */
+INT16 **RawReadChannels(char *RawFileName, WAV_INFO *info, int chan, double start, double end,
+                        unsigned long *num_smps)
+{
+    unsigned char *p;
+    unsigned long size;
+    int mapped;
+    INT16 **sample;
+
+    if (info->channel<1 || chan>=info->channel ||
+        (info->bps!=8 && info->bps!=16 && info->bps!=24 && info->bps!=32)) {
+        fprintf(stderr,"Unsupported raw format for %s: %d channel(s), %d bits\n",
+                RawFileName,info->channel,info->bps);
+        return((INT16 **)NULL);
+    }
+    if ((p=map_file(RawFileName,&size,&mapped))==NULL)
+        return((INT16 **)NULL);
+    info->fmtag = WAVE_FORMAT_PCM;
+    info->align = info->channel*info->bps/8;
+    info->data_offset = 0;
+    info->num_frames = size/info->align;
+    sample = read_channels(RawFileName,p,info,chan,start,end,num_smps);
+    unmap_file(p,size,mapped);
+    return(sample);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* WavRead(): Read the header and the first channel of a .wav file.        */
+/*            WavHdr receives the first 44 bytes of the file. 8-bit data   */
+/*            is returned as -128..127, as before WavDeinterleave().       */
+/* ------------------------------------------------------------------------ */
+INT16 *WavRead(char *WavFileName, WAV_HDR *WavHdr, unsigned long *num_smps)
+{
+    FILE    *wavfile;
+    WAV_INFO info;
+    INT16   **channels;
+    INT16   *sample;
+    unsigned long i;
+
+    if ((wavfile=fopen(WavFileName,"rb"))==NULL) {
+        fprintf(stderr,"%s not found\n",WavFileName);
+        return ((INT16 *)NULL);
+    }
+    if (fread(WavHdr,sizeof(WAV_HDR),1,wavfile)!=1) {
+        fprintf(stderr,"Error in reading %s file header\n",WavFileName);
+        fclose(wavfile);
+        return((INT16 *)NULL);
     }
     fclose(wavfile);
-    return((INT16 *)sample);
+
+    if ((channels=WavReadChannels(WavFileName,&info,0,0.0,0.0,num_smps))==NULL)
+        return((INT16 *)NULL);
+    sample = channels[0];
+    free(channels);
+    if (info.bps==8) {
+        for (i=0; i<*num_smps; i++)
+            sample[i] /= 256;
+    }
+    return(sample);
 }
 
-void WavWrite(char *WavFileName, WAV_HDR *WavHdr, void *sample)
+/* ------------------------------------------------------------------------ */
+/* WavWrite(): Write a .wav file. Return 0 on success, -1 on error.         */
+/* ------------------------------------------------------------------------ */
+int WavWrite(char *WavFileName, WAV_HDR *WavHdr, void *sample)
 {
      FILE *wavfile;
      INT32 num_samples;
+     size_t n;
 
      num_samples = WavHdr->dsize/(WavHdr->channel*WavHdr->bps/8);
      if ((wavfile=fopen(WavFileName,"wb"))==NULL) {
         fprintf(stderr,"Error in opening %s\n",WavFileName);
-	exit(EXIT_FAILURE);
+	return(-1);
      }
      fwrite((WAV_HDR *)WavHdr,sizeof(WAV_HDR),1,wavfile);
      if (WavHdr->bps==16)
-        fwrite((INT16 *)sample,2,num_samples,wavfile);
+        n = fwrite((INT16 *)sample,2,num_samples,wavfile);
      else
-        fwrite((unsigned char *)sample,1,num_samples,wavfile);
-     fclose(wavfile);
+        n = fwrite((unsigned char *)sample,1,num_samples,wavfile);
+     if (fclose(wavfile)!=0 || n!=(size_t)num_samples) {
+        fprintf(stderr,"Error in writing %s\n",WavFileName);
+	return(-1);
+     }
+     return(0);
 }
 
 
-/* Same format as Matlab wavwrite */
-void wavwrite(short *sample, unsigned long num_samples, unsigned long sr, 
+/* Same format as Matlab wavwrite. Return 0 on success, -1 on error. */
+int wavwrite(short *sample, unsigned long num_samples, unsigned long sr, 
 	      unsigned long bps, char *wavfilename)
 {
     WAV_HDR wh;
@@ -95,7 +384,7 @@ void wavwrite(short *sample, unsigned long num_samples, unsigned long sr,
     strncpy(wh.data,"data",4);
     wh.dsize = num_samples*bps;
     wh.filesize = wh.dsize + sizeof(WAV_HDR);
-    WavWrite(wavfilename, &wh, sample);
+    return(WavWrite(wavfilename, &wh, sample));
 }
 
 /* End of file */
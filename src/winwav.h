@@ -42,11 +42,36 @@ typedef struct {
 	dsize = num_samples*bps/8
 */
 
+/* Format tags of the fmt chunk */
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+/* Layout of the sample data, as found in the fmt chunk or given for raw files */
+typedef struct {
+        int     fmtag;               /* WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT (EXTENSIBLE resolved) */
+        int     channel;             /* number of channels */
+        INT32   srate;               /* sampling freq */
+        int     bps;                 /* bits per sample: 8, 16, 24 or 32 */
+        int     align;               /* bytes per sample frame */
+        unsigned long data_offset;   /* file offset of the first sample */
+        unsigned long num_frames;    /* number of sample frames */
+} WAV_INFO;
+
+/* Index of the sample at time t (in sec) for sampling rate sr */
+#define SEC2SMP(t,sr) ((unsigned long)((t)*(double)(sr)+0.5))
+
 /* Function to read and write winwav (.wwv) file */
 INT16 *WavRead(char *WavFileName, WAV_HDR *WavHdr,unsigned long *num_smps);
-void WavWrite(char *WavFileName, WAV_HDR *WavHdr, void *samples);
-void wavwrite(short *sample, unsigned long num_samples, unsigned long sr, 
-	      unsigned long bps, char *wavfilename);
+INT16 **WavReadChannels(char *WavFileName, WAV_INFO *info, int chan, double start, double end,
+			unsigned long *num_smps);
+INT16 **RawReadChannels(char *RawFileName, WAV_INFO *info, int chan, double start, double end,
+			unsigned long *num_smps);
+void WavDeinterleave(const unsigned char *in, INT16 *out, unsigned long num_frames,
+		     WAV_INFO *info, int chan);
+int WavWrite(char *WavFileName, WAV_HDR *WavHdr, void *samples);
+int wavwrite(short *sample, unsigned long num_samples, unsigned long sr, 
+	     unsigned long bps, char *wavfilename);
 
 #endif
 